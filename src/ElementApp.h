@@ -57,6 +57,7 @@ namespace Tags
     const Identifier nodes              = "nodes";
     const Identifier notes              = "notes";
     const Identifier oversamplingFactor = "oversamplingFactor";
+    const Identifier oversamplingFilter = "oversamplingFilter";
     const Identifier persistent         = "persistent";
     const Identifier placeholder        = "placeholder";
     const Identifier port               = "port";
@@ -116,6 +117,8 @@ namespace Tags
     const Identifier workspace          = "workspace";
 
     const Identifier externalSync       = "externalSync";
+    const Identifier tempoMap           = "tempoMap";
+    const Identifier beat               = "beat";
 
     const Identifier updater            = "updater";
 }
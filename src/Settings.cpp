@@ -40,6 +40,11 @@ const char* Settings::workspaceKey              = "workspace";
 const char* Settings::midiEngineKey             = "midiEngine";
 const char* Settings::oscHostPortKey            = "oscHostPortKey";
 const char* Settings::oscHostEnabledKey         = "oscHostEnabledKey";
+const char* Settings::renderThreadsKey          = "renderThreads";
+const char* Settings::autosaveIntervalKey       = "autosaveInterval";
+const char* Settings::sessionCompressionLevelKey = "sessionCompressionLevel";
+const char* Settings::binarySessionsKey         = "binarySessions";
+const char* Settings::pluginScannersKey         = "pluginScanners";
 
 enum OptionsMenuItemId
 {
@@ -351,6 +356,75 @@ void Settings::setOscHostPort (int port)
         p->setValue (oscHostPortKey, port);
 }
 
+int Settings::getNumRenderThreads() const
+{
+    const int maxThreads = jmax (0, SystemStats::getNumCpus() - 1);
+    if (auto* p = getProps())
+        return jlimit (0, maxThreads, p->getIntValue (renderThreadsKey, 0));
+    return 0;
+}
+
+void Settings::setNumRenderThreads (int numThreads)
+{
+    if (getNumRenderThreads() == numThreads)
+        return;
+    if (auto* p = getProps())
+        p->setValue (renderThreadsKey, numThreads);
+}
+
+int Settings::getAutosaveInterval() const
+{
+    if (auto* p = getProps())
+        return jmax (0, p->getIntValue (autosaveIntervalKey, 5));
+    return 0;
+}
+
+void Settings::setAutosaveInterval (int minutes)
+{
+    if (auto* p = getProps())
+        p->setValue (autosaveIntervalKey, jmax (0, minutes));
+}
+
+int Settings::getSessionCompressionLevel() const
+{
+    if (auto* p = getProps())
+        return jlimit (0, 9, p->getIntValue (sessionCompressionLevelKey, 6));
+    return 6;
+}
+
+void Settings::setSessionCompressionLevel (int level)
+{
+    if (auto* p = getProps())
+        p->setValue (sessionCompressionLevelKey, jlimit (0, 9, level));
+}
+
+bool Settings::saveBinarySessions() const
+{
+    if (auto* p = getProps())
+        return p->getBoolValue (binarySessionsKey, false);
+    return false;
+}
+
+void Settings::setSaveBinarySessions (bool binary)
+{
+    if (auto* p = getProps())
+        p->setValue (binarySessionsKey, binary);
+}
+
+int Settings::getNumPluginScanners() const
+{
+    int num = 0;
+    if (auto* p = getProps())
+        num = p->getIntValue (pluginScannersKey, 0);
+    return jlimit (1, 8, num > 0 ? num : SystemStats::getNumCpus());
+}
+
+void Settings::setNumPluginScanners (int num)
+{
+    if (auto* p = getProps())
+        p->setValue (pluginScannersKey, jlimit (0, 8, num));
+}
+
 void Settings::addItemsToMenu (Globals& world, PopupMenu& menu)
 {
     auto& devices (world.getDeviceManager());
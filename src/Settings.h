@@ -49,6 +49,11 @@ public:
     static const char* midiEngineKey;
     static const char* oscHostPortKey;
     static const char* oscHostEnabledKey;
+    static const char* renderThreadsKey;
+    static const char* autosaveIntervalKey;
+    static const char* sessionCompressionLevelKey;
+    static const char* binarySessionsKey;
+    static const char* pluginScannersKey;
 
     std::unique_ptr<XmlElement> getLastGraph() const;
     void setLastGraph (const ValueTree& data);
@@ -111,6 +116,29 @@ public:
     int getOscHostPort() const;
     void setOscHostPort (int);
 
+    /** Number of extra threads used to render graphs. Zero renders
+        everything on the audio thread */
+    int getNumRenderThreads() const;
+    void setNumRenderThreads (int);
+
+    /** Minutes between autosaves of a changed session. Zero disables it */
+    int getAutosaveInterval() const;
+    void setAutosaveInterval (int);
+
+    /** Compression level, 0 to 9, used for binary sessions and autosaves */
+    int getSessionCompressionLevel() const;
+    void setSessionCompressionLevel (int);
+
+    /** True if sessions should be saved as binary containers instead of XML.
+        Older versions of Element can't open these */
+    bool saveBinarySessions() const;
+    void setSaveBinarySessions (bool);
+
+    /** Number of processes used to scan plugins. Zero picks one per core,
+        up to eight */
+    int getNumPluginScanners() const;
+    void setNumPluginScanners (int);
+
 private:
     PropertiesFile* getProps() const;
 };
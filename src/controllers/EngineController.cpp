@@ -84,8 +84,9 @@ struct RootGraphHolder
             {
                 controller = new RootGraphManager (*root, plugins);
                 model.setProperty (Tags::object, node.get());
-                controller->setNodeModel (model);
-                resetIONodePorts();
+                controller->loadNodeModel (model, [this]() {
+                    resetIONodePorts();
+                });
             }
         }
         
@@ -728,10 +729,10 @@ void EngineController::setRootNode (const Node& newRootNode)
     
     if (auto* const r = holder->getController())
     {
-        if (! r->isLoaded())
+        if (! r->isLoaded() && ! r->isLoading())
         {
             r->getRootGraph().setPlayConfigFor (devices);
-            r->setNodeModel (newRootNode);
+            r->loadNodeModel (newRootNode);
         }
         
         engine->setCurrentGraph (index);
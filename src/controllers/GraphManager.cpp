@@ -25,6 +25,7 @@
 #include "engine/nodes/PlaceholderProcessor.h"
 #include "engine/nodes/SubGraphProcessor.h"
 
+#include "session/PluginInstantiator.h"
 #include "session/PluginManager.h"
 #include "Globals.h"
 #include "Utils.h"
@@ -198,6 +199,7 @@ GraphManager::~GraphManager()
     // If you get warnings by juce's leak detector about graph related
     // objects, then there's probably "object" properties lingering that
     // are referenced in the model;
+    abandonLoading();
     Node::sanitizeRuntimeProperties (graph, true);
     graph = arcs = nodes = ValueTree();
 }
@@ -239,17 +241,7 @@ GraphNode* GraphManager::createFilter (const PluginDescription* desc, double x,
     GraphNode* node = nullptr;
     
     if (instance != nullptr)
-    {
-        if (auto* sub = dynamic_cast<SubGraphProcessor*> (instance))
-            sub->initController (pluginManager);
-        instance->enableAllBuses();
-        node = processor.addNode (instance, nodeId);
-    }
-    
-    if (node != nullptr)
-    {
-        // noop
-    }
+        node = addPlugin (instance, nodeId);
 
     if (errorMessage.isNotEmpty())
     {
@@ -259,6 +251,14 @@ GraphNode* GraphManager::createFilter (const PluginDescription* desc, double x,
     return node;
 }
 
+GraphNode* GraphManager::addPlugin (AudioPluginInstance* instance, uint32 nodeId)
+{
+    if (auto* sub = dynamic_cast<SubGraphProcessor*> (instance))
+        sub->initController (pluginManager);
+    instance->enableAllBuses();
+    return processor.addNode (instance, nodeId);
+}
+
 GraphNode* GraphManager::createPlaceholder (const Node& node)
 {
     PluginDescription desc; node.getPluginDescription (desc);
@@ -500,8 +500,9 @@ void GraphManager::removeConnection (uint32 sourceNode, uint32 sourcePort,
         processorArcsChanged();
 }
 
-void GraphManager::setNodeModel (const Node& node)
+PluginInstantiator* GraphManager::prepareLoad (const Node& node)
 {
+    abandonLoading();
     loaded = false;
 
     processor.clear();
@@ -509,14 +510,105 @@ void GraphManager::setNodeModel (const Node& node)
     arcs    = node.getArcsValueTree();
     nodes   = node.getNodesValueTree();
     
+    // create every plugin before touching the graph. State is restored in
+    // the background where possible while the rest are being created
+    auto* const instantiator = new PluginInstantiator (pluginManager);
+    for (int i = 0; i < nodes.getNumChildren(); ++i)
+    {
+        const Node node (nodes.getChild (i), false);
+        const ValueTree data (node.getValueTree());
+        auto& item = instantiator->add (pluginManager.findDescriptionFor (node));
+        item.nodeId  = node.getNodeId();
+        item.program = data.getProperty (Tags::program, -1);
+        Node::readStateProperty (data, Tags::state, item.state);
+        Node::readStateProperty (data, Tags::programState, item.programState);
+
+        PortArray ins, outs;
+        node.getPorts (ins, outs, PortType::Audio);
+        item.numInputs  = ins.size();
+        item.numOutputs = outs.size();
+    }
+
+    instantiator->onProgress = [this](int numLoaded, int numNodes) {
+        loadProgress (numLoaded, numNodes);
+    };
+
+    return instantiator;
+}
+
+void GraphManager::setNodeModel (const Node& node)
+{
+    std::unique_ptr<PluginInstantiator> instantiator (prepareLoad (node));
+    instantiator->runNow();
+    addLoadedNodes (*instantiator);
+}
+
+void GraphManager::loadNodeModel (const Node& node, std::function<void()> onLoaded)
+{
+    auto* const instantiator = prepareLoad (node);
+
+    {
+        ScopedLock sl (loadingLock);
+        loading.reset (instantiator);
+    }
+
+    instantiator->start ([this, onLoaded]()
+    {
+        std::unique_ptr<PluginInstantiator> finished;
+        {
+            ScopedLock sl (loadingLock);
+            finished.swap (loading);
+        }
+
+        addLoadedNodes (*finished);
+        if (onLoaded)
+            onLoaded();
+    });
+}
+
+void GraphManager::abandonLoading()
+{
+    std::unique_ptr<PluginInstantiator> abandoned;
+    {
+        ScopedLock sl (loadingLock);
+        abandoned.swap (loading);
+    }
+
+    // waits for restore jobs already running, onLoaded is never called
+    abandoned = nullptr;
+}
+
+bool GraphManager::isLoading() const
+{
+    ScopedLock sl (loadingLock);
+    return loading != nullptr;
+}
+
+void GraphManager::addLoadedNodes (PluginInstantiator& instantiator)
+{
+    // the model can change while plugins load in the background, so items
+    // are matched up by node id. Nodes added meanwhile already have their
+    // processor and have no item, items for removed nodes are dropped
     Array<ValueTree> failed;
     for (int i = 0; i < nodes.getNumChildren(); ++i)
     {
         Node node (nodes.getChild (i), false);
-        const PluginDescription desc (pluginManager.findDescriptionFor (node));
-        if (GraphNodePtr obj = createFilter (&desc, 0.0, 0.0, node.getNodeId()))
+        auto* const item = instantiator.findItem (node.getNodeId());
+        if (item == nullptr || processor.getNodeForId (node.getNodeId()) != nullptr)
+            continue;
+
+        GraphNodePtr obj;
+
+        if (item->node != nullptr)
+            obj = processor.addNode (item->node.get(), node.getNodeId());
+        else if (item->instance != nullptr)
+            obj = addPlugin (item->instance.release(), node.getNodeId());
+        else if (item->errorMessage.isNotEmpty())
+            DBG("[EL] error creating audio plugin: " << item->errorMessage);
+
+        if (obj != nullptr)
         {
-            setupNode (node.getValueTree(), obj);
+            setupNode (node.getValueTree(), obj, ! item->stateRestored);
             obj->setEnabled (node.isEnabled());
             node.setProperty (Tags::enabled, obj->isEnabled());
         }
@@ -548,8 +640,12 @@ void GraphManager::setNodeModel (const Node& node)
         ValueTree arc (arcs.getChild (i));
         const auto sourceNode = (uint32)(int) arc.getProperty (Tags::sourceNode);
         const auto destNode = (uint32)(int) arc.getProperty (Tags::destNode);
-        bool worked = processor.addConnection (sourceNode, (uint32)(int) arc.getProperty (Tags::sourcePort),
-                                               destNode, (uint32)(int) arc.getProperty (Tags::destPort));
+        const auto sourcePort = (uint32)(int) arc.getProperty (Tags::sourcePort);
+        const auto destPort = (uint32)(int) arc.getProperty (Tags::destPort);
+
+        // connections made while loading are already in the processor
+        bool worked = processor.getConnectionBetween (sourceNode, sourcePort, destNode, destPort) != nullptr
+                   || processor.addConnection (sourceNode, sourcePort, destNode, destPort);
         if (worked)
         {
             arc.removeProperty (Tags::missing, 0);
@@ -587,6 +683,13 @@ void GraphManager::setNodeModel (const Node& node)
     processorArcsChanged();
 }
 
+void GraphManager::cancelLoading()
+{
+    ScopedLock sl (loadingLock);
+    if (loading != nullptr)
+        loading->cancel();
+}
+
 void GraphManager::savePluginStates()
 {
     for (int i = 0; i < nodes.getNumChildren(); ++i)
@@ -598,6 +701,7 @@ void GraphManager::savePluginStates()
 
 void GraphManager::clear()
 {
+    abandonLoading();
     loaded = false;
 
     if (graph.isValid())
@@ -647,7 +751,7 @@ void GraphManager::processorArcsChanged()
     changed();
 }
 
-void GraphManager::setupNode (const ValueTree& data, GraphNodePtr obj)
+void GraphManager::setupNode (const ValueTree& data, GraphNodePtr obj, bool restoreState)
 {
     jassert (obj && data.hasType (Tags::node));
     Node node (data, false);
@@ -691,7 +795,8 @@ void GraphManager::setupNode (const ValueTree& data, GraphNodePtr obj)
         node.resetPorts();
     
     jassert (node.getNumPorts() == static_cast<int> (obj->getNumPorts()));
-    node.restorePluginState();
+    if (restoreState)
+        node.restorePluginState();
 }
 
 // MARK: Root Graph Controller
@@ -23,11 +23,13 @@
 #include "engine/AudioEngine.h"
 #include "engine/GraphProcessor.h"
 #include "session/Node.h"
+#include "Signals.h"
 
 namespace Element {
 
 class FilterInGraph;
 class GraphManager;
+class PluginInstantiator;
 class PluginManager;
 
 class GraphManager : public ChangeBroadcaster,
@@ -86,8 +88,30 @@ public:
 
     void clear();
 
+    /** Loads a graph model. Plugins are created and restored as a batch,
+        then connected once every node exists. This doesn't return until
+        everything is loaded, see loadNodeModel */
     void setNodeModel (const Node& node);
+
+    /** Loads a graph model like setNodeModel, but returns straight away and
+        creates plugins from the message loop. onLoaded is called on the
+        message thread once the nodes are connected. Loading another model,
+        clearing, or deleting the manager first abandons the load and
+        onLoaded isn't called. Sub-graphs in the model are still loaded
+        synchronously when their node is added */
+    void loadNodeModel (const Node& node, std::function<void()> onLoaded = nullptr);
+
     inline Node getGraphModel() const { return Node (graph, false); }
+
+    /** Stops a loadNodeModel in progress. Nodes which weren't created yet
+        are loaded as placeholders */
+    void cancelLoading();
+
+    /** True while loadNodeModel is creating plugins */
+    bool isLoading() const;
+
+    /** Emitted on the message thread while nodes are created */
+    Signal<void(int numLoaded, int numNodes)> loadProgress;
     
     void savePluginStates();
     
@@ -105,14 +129,21 @@ private:
     GraphProcessor& processor;
     ValueTree graph, arcs, nodes;
     bool loaded = false;
+    CriticalSection loadingLock;
+    std::unique_ptr<PluginInstantiator> loading;
     
     uint32 lastUID;
     uint32 getNextUID() noexcept;
     inline void changed() { sendChangeMessage(); }
     GraphNode* createFilter (const PluginDescription* desc, double x = 0.0f, double y = 0.0f,
                              uint32 nodeId = 0);
+    GraphNode* addPlugin (AudioPluginInstance* instance, uint32 nodeId);
     GraphNode* createPlaceholder (const Node& node);
-    void setupNode (const ValueTree& data, GraphNodePtr object);
+    void setupNode (const ValueTree& data, GraphNodePtr object, bool restoreState = true);
+
+    PluginInstantiator* prepareLoad (const Node& node);
+    void addLoadedNodes (PluginInstantiator&);
+    void abandonLoading();
     
     void processorArcsChanged();
 
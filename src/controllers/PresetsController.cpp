@@ -57,7 +57,7 @@ void PresetsController::deactivate()
 
 void PresetsController::refresh()
 {
-    getWorld().getPresetCollection().refresh();
+    getWorld().getPresetCollection().refreshInBackground();
 }
 
 void PresetsController::add (const Node& node, const String& presetName)
@@ -70,7 +70,7 @@ void PresetsController::add (const Node& node, const String& presetName)
     }
     else
     {
-        getWorld().getPresetCollection().refresh();
+        getWorld().getPresetCollection().refreshInBackground();
     }
 
     if (auto* gui = findSibling<GuiController>())
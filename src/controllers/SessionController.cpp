@@ -37,12 +37,22 @@ void SessionController::activate()
 {
     auto* app = dynamic_cast<AppController*> (getRoot());
     currentSession = app->getWorld().getSession();
-    document = new SessionDocument (currentSession);
+    document = new SessionDocument (currentSession, &writer);
     document->setLastDocumentOpened (DataPath::defaultSessionDir().getChildFile ("Untitled.els"));
+
+    auto& settings = app->getWorld().getSettings();
+    document->setSaveBinary (settings.saveBinarySessions(), settings.getSessionCompressionLevel());
+
+    const int interval = settings.getAutosaveInterval();
+    if (interval > 0)
+        startTimer (interval * 60 * 1000);
 }
 
 void SessionController::deactivate()
 {
+    stopTimer();
+    writer.waitUntilFinished();
+
     auto& world = getWorld();
     auto& settings (world.getSettings());
     auto* props = settings.getUserSettings();
@@ -141,6 +151,32 @@ void SessionController::importGraph (const File& file)
     openFile (file);
 }
 
+File SessionController::getAutosaveFile()
+{
+    return DataPath::applicationDataDir().getChildFile ("Autosave.els");
+}
+
+void SessionController::timerCallback()
+{
+    auto& settings = getWorld().getSettings();
+    const int interval = settings.getAutosaveInterval();
+    if (interval <= 0)
+    {
+        stopTimer();
+        return;
+    }
+
+    if (getTimerInterval() != interval * 60 * 1000)
+        startTimer (interval * 60 * 1000);
+
+    // skip a round rather than queue behind a slow disk
+    if (document == nullptr || ! document->hasChangedSinceSaved() || writer.isWriting())
+        return;
+
+    writer.write (SessionWriter::createSnapshot (*currentSession), getAutosaveFile(),
+                  SessionWriter::containerFormat, settings.getSessionCompressionLevel());
+}
+
 void SessionController::closeSession()
 {
     DBG("[SC] close session");
@@ -22,10 +22,12 @@
 #include "controllers/AppController.h"
 #include "documents/SessionDocument.h"
 #include "session/Session.h"
+#include "session/SessionWriter.h"
 #include "Signals.h"
 
 namespace Element {
-class SessionController : public AppController::Child
+class SessionController : public AppController::Child,
+                          private Timer
 {
 public:
     SessionController() { }
@@ -46,13 +48,18 @@ public:
     
     void exportGraph (const Node& node, const File& targetFile);
     void importGraph (const File& file);
+
+    /** The file periodic autosaves are written to */
+    static File getAutosaveFile();
     
     Signal<void()> sessionLoaded;
 private:
     SessionPtr currentSession;
+    SessionWriter writer;
     ScopedPointer<SessionDocument> document;
     void loadNewSessionData();
     void refreshOtherControllers();
+    void timerCallback() override;
 };
 
 }
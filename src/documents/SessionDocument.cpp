@@ -18,6 +18,8 @@
 */
 
 #include "session/Session.h"
+#include "session/SessionContainer.h"
+#include "session/SessionWriter.h"
 #include "documents/SessionDocument.h"
 
 namespace Element {
@@ -36,9 +38,9 @@ namespace Element {
         }
     }
 
-    SessionDocument::SessionDocument (SessionPtr s)
+    SessionDocument::SessionDocument (SessionPtr s, SessionWriter* w)
         : FileBasedDocument (".els", "*.els", "Open Session", "Save Session"),
-          session (s)
+          session (s), writer (w)
     {
         if (session)
             session->addChangeListener (this);
@@ -60,19 +62,23 @@ namespace Element {
         if (nullptr == session)
             return Result::fail ("No session data target");
 
+        // the file could still be getting written
+        if (writer != nullptr)
+            writer->waitUntilFinished();
+
         String error;
-        if (auto e = XmlDocument::parse (file))
-        {
-            ValueTree newData (ValueTree::fromXml (*e));
-            if (! newData.isValid() && newData.hasType ("session"))
-                error = "Not a valid session file";
-            if (error.isEmpty() && !session->loadData (newData))
-                error = "Could not load session data";
-        }
+        ValueTree newData;
+        if (SessionContainer::isContainer (file))
+            newData = SessionContainer::read (file);
+        else if (auto e = XmlDocument::parse (file))
+            newData = ValueTree::fromXml (*e);
         else
-        {
+            newData = Session::readFromFile (file);
+
+        if (! newData.isValid() || ! newData.hasType (Tags::session))
             error = "Not a valid session file";
-        }
+        if (error.isEmpty() && !session->loadData (newData))
+            error = "Could not load session data";
 
         if (error.isEmpty())
         {
@@ -87,15 +93,30 @@ namespace Element {
         if (! session)
             return Result::fail ("Nil session");
         
-        session->saveGraphState();
-        if (auto e = session->createXml())
-        {
-            Result res (e->writeToFile (file, String())
-                    ? Result::ok() : Result::fail ("Error writing session file"));
-            return res;
-        }
+        const auto snapshot = SessionWriter::createSnapshot (*session);
+        const auto format = saveBinary ? SessionWriter::containerFormat : SessionWriter::xmlFormat;
+        if (writer == nullptr)
+            return SessionWriter::writeSnapshot (snapshot, file, format, compressionLevel);
+
+        WeakReference<SessionDocument> ref (this);
+        writer->write (snapshot, file, format, compressionLevel,
+            [ref] (const File& f, const Result& result)
+            {
+                if (result.wasOk())
+                    return;
+                if (auto* doc = ref.get())
+                    doc->setChangedFlag (true);
+                AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon, "Save Session",
+                    String ("Could not save ") + f.getFileName() + "\n\n" + result.getErrorMessage());
+            });
+
+        return Result::ok();
+    }
 
-        return Result::fail ("Could not create session data");
+    void SessionDocument::setSaveBinary (bool binary, int level)
+    {
+        saveBinary = binary;
+        compressionLevel = level;
     }
 
     File SessionDocument::getLastDocumentOpened() { return lastSession; }
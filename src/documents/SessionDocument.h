@@ -23,11 +23,15 @@
 #include "session/Session.h"
 
 namespace Element {
+    class SessionWriter;
+
     class SessionDocument :  public FileBasedDocument,
                              public ChangeListener
     {
     public:
-        SessionDocument (SessionPtr);
+        /** If a writer is given, saves return as soon as the session has been
+            snapshotted and the file is written in the background */
+        SessionDocument (SessionPtr, SessionWriter* writer = nullptr);
         ~SessionDocument();
 
         String getDocumentTitle() override;
@@ -38,10 +42,18 @@ namespace Element {
         
         void changeListenerCallback (ChangeBroadcaster*) override;
 
+        /** Saves binary session containers instead of XML. They are smaller
+            and load faster when plugins have a lot of state */
+        void setSaveBinary (bool binary, int compressionLevel = 6);
+
     private:
         SessionPtr session;
+        SessionWriter* writer;
+        bool saveBinary = false;
+        int compressionLevel = 6;
         File lastSession;
         friend class Session;
         void onSessionChanged();
+        JUCE_DECLARE_WEAK_REFERENCEABLE (SessionDocument)
     };
 }
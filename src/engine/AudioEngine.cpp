@@ -20,6 +20,7 @@
 #include "engine/AudioEngine.h"
 #include "engine/GraphProcessor.h"
 #include "engine/InternalFormat.h"
+#include "engine/MappingEngine.h"
 #include "engine/MidiClock.h"
 #include "engine/MidiChannelMap.h"
 #include "engine/MidiEngine.h"
@@ -131,23 +132,32 @@ struct RootGraphRender : public AsyncUpdater
     {
         numInputChans   = numIns;
         numOutputChans  = numOuts;
-        audioTemp.setSize (jmax (numIns, numOuts), numSamples);
-        audioOut.setSize (audioTemp.getNumChannels(), audioTemp.getNumSamples());
+        audioOut.setSize (jmax (numIns, numOuts), numSamples);
+        for (auto* slot : slots)
+            slot->prepare (audioOut.getNumChannels(), audioOut.getNumSamples());
     }
 
     void releaseBuffers()
     {
         numInputChans = numOutputChans = 0;
         midiOut.clear();
-        midiTemp.clear();
-        audioTemp.setSize (1, 1);
         audioOut.setSize (1, 1);
+        for (auto* slot : slots)
+            slot->release();
     }
+
     void dumpGraphs() {
         
     }
 
-    void renderGraphs (AudioSampleBuffer& buffer, MidiBuffer& midi)
+    /** Set the pool used to render graphs concurrently. Not owned */
+    void setRenderThreadPool (RenderThreadPool* newPool)     { pool = newPool; }
+
+    /** Renders and mixes the graphs. If a transport is given, graphs render
+        up to each of its tempo changes in turn, and it is advanced past each
+        piece while playing. The graph switch, fades and mixdown always work
+        on the whole block */
+    void renderGraphs (AudioSampleBuffer& buffer, MidiBuffer& midi, Transport* transport = nullptr)
     {
        #if defined (EL_PRO)
         if (program.wasRequested())
@@ -176,6 +186,8 @@ struct RootGraphRender : public AsyncUpdater
         {
             buffer.clear();
             midi.clear();
+            if (transport != nullptr && transport->isPlaying())
+                transport->advance (buffer.getNumSamples());
             return;
         }
 
@@ -190,25 +202,22 @@ struct RootGraphRender : public AsyncUpdater
         {
 			audioOut.setSize (buffer.getNumChannels(), buffer.getNumSamples(),
 							  false, false, true);
-			audioTemp.setSize (buffer.getNumChannels(), buffer.getNumSamples(),
-							  false, false, true);
 
             // clear the mixing area
             for (int i = numChans; --i >= 0;)
                 audioOut.clear (i, 0, numSamples);
             midiOut.clear();
             
-            for (auto* const graph : graphs)
+            // decide what each graph receives and how it gets mixed. this
+            // stays on the audio thread since it reads the shared MIDI input
+            for (int index = 0; index < graphs.size(); ++index)
             {
-                // copy inputs, clear outs if more than input count
-                for (int i = 0; i < numInputChans; ++i)
-                    audioTemp.copyFrom (i, 0, buffer, i, 0, numSamples);
-                for (int i = numInputChans; i < numChans; ++i)
-                    audioTemp.clear (i, 0, numSamples);
-                
+                auto* const graph = graphs.getUnchecked (index);
+                auto& slot = *slots.getUnchecked (index);
+
                 // clear so messages: avoids feedback loop when IO node ins are 
                 // connected to IO node outs
-                midiTemp.clear (0, numSamples);
+                slot.midi.clear();
                 
                 if ((last == graph && graphChanged && last->isSingle())
                     || (graphChanged && current != nullptr && current->isSingle() && graph != current))
@@ -218,65 +227,92 @@ struct RootGraphRender : public AsyncUpdater
                     for (int i = 0; i < 16; ++i)
                     {
                         // sustain pedal off
-                        midiTemp.addEvent (MidiMessage::controllerEvent (i + 1, 64, 0), 0);
+                        slot.midi.addEvent (MidiMessage::controllerEvent (i + 1, 64, 0), 0);
                         // Sostenuto off
-                        midiTemp.addEvent (MidiMessage::controllerEvent (i + 1, 66, 0), 0);
+                        slot.midi.addEvent (MidiMessage::controllerEvent (i + 1, 66, 0), 0);
                         // Hold off
-                        midiTemp.addEvent (MidiMessage::controllerEvent (i + 1, 69, 0), 0);
+                        slot.midi.addEvent (MidiMessage::controllerEvent (i + 1, 69, 0), 0);
 
-                        midiTemp.addEvent (MidiMessage::allNotesOff (i + 1), 0);
+                        slot.midi.addEvent (MidiMessage::allNotesOff (i + 1), 0);
                     }
                 }
                 else if ((current == graph && graph->isSingle()) 
                             || (current != nullptr && !current->isSingle() && !graph->isSingle()))
                 {
                     // current single graph or parallel graphs get MIDI always
-                    midiTemp.addEvents (midi, 0, numSamples, 0);
+                    slot.midi.addEvents (midi, 0, numSamples, 0);
                 }
 
-                {
-                    const ScopedLock sl (graph->getCallbackLock());
-                    if (graph->isSuspended())
-                    {
-                        graph->processBlockBypassed (audioTemp, midiTemp);
-                    }
-                    else
-                    {
-                        graph->processBlock (audioTemp, midiTemp);
-                    }
-                }
-                
+                slot.audio.setSize (numChans, numSamples, false, false, true);
+                slot.mix = GraphSlot::Silent;
                 if (graphChanged && ((current->isSingle() && current != graph) ||
                                      (modeChanged && !current->isSingle() && graph->isSingle())))
-                                     
                 {
-                    // DBG("  FADE OUT LAST GRAPH: " << graph->engineIndex);
-                    for (int i = 0; i < numOutputChans; ++i)
-                            audioOut.addFromWithRamp (i, 0, audioTemp.getReadPointer (i), 
-                                                      numSamples, 1.f, 0.f);
+                    slot.mix = GraphSlot::FadeOut;
                 }
                 else if ((graph == current && graph->isSingle()) ||
                          (!graph->isSingle() && (current != nullptr) && !current->isSingle()))
                 {
                     // if it's the current single graph or both are parallel...
-                    if (graphChanged && (graph->isSingle() || 
-                                        (modeChanged && !graph->isSingle() && !current->isSingle())))
+                    slot.mix = (graphChanged && (graph->isSingle() || 
+                                    (modeChanged && !graph->isSingle() && !current->isSingle())))
+                        ? GraphSlot::FadeIn : GraphSlot::Normal;
+                }
+            }
+
+            // graphs share no state, so render them concurrently when possible
+            currentInput = &buffer;
+            for (int start = 0; start < numSamples;)
+            {
+                const int numFrames = transport != nullptr
+                    ? transport->getFramesUntilTempoChange (numSamples - start)
+                    : numSamples - start;
+
+                GraphRenderJob job (*this, start, numFrames, numSamples);
+                if (graphs.size() < 2 || pool == nullptr || ! pool->run (job, slotTasks))
+                    for (int index = 0; index < graphs.size(); ++index)
+                        job.runTask (index);
+
+                if (transport != nullptr && transport->isPlaying())
+                    transport->advance (numFrames);
+                start += numFrames;
+            }
+            currentInput = nullptr;
+
+            // mix down in graph order so the result doesn't depend on timing.
+            // a channel at a time, so the output stays in cache while every
+            // graph is summed into it
+            for (int i = 0; i < numOutputChans; ++i)
+            {
+                float* const out = audioOut.getWritePointer (i);
+                for (auto* const slot : slots)
+                {
+                    switch (slot->mix)
                     {
-                        // DBG("  FADE IN NEW GRAPH: " << graph->engineIndex);
-                        for (int i = 0; i < numOutputChans; ++i)
-                            audioOut.addFromWithRamp (i, 0, audioTemp.getReadPointer (i), 
+                        case GraphSlot::FadeOut:
+                            audioOut.addFromWithRamp (i, 0, slot->audio.getReadPointer (i),
+                                                      numSamples, 1.f, 0.f);
+                            break;
+
+                        case GraphSlot::FadeIn:
+                            audioOut.addFromWithRamp (i, 0, slot->audio.getReadPointer (i),
                                                       numSamples, 0.f, 1.f);
+                            break;
+
+                        case GraphSlot::Normal:
+                            FloatVectorOperations::add (out, slot->audio.getReadPointer (i), numSamples);
+                            break;
+
+                        default:
+                            break;
                     }
-                    else
-                    {
-                        for (int i = 0; i < numOutputChans; ++i)
-                            audioOut.addFrom (i, 0, audioTemp, i, 0, numSamples);
-                    }
-                    
-                    midiOut.addEvents (midiTemp, 0, numSamples, 0);
                 }
             }
 
+            for (auto* const slot : slots)
+                if (slot->mix == GraphSlot::FadeIn || slot->mix == GraphSlot::Normal)
+                    midiOut.addEvents (slot->midi, 0, numSamples, 0);
+
             for (int i = 0; i < numChans; ++i)
                 buffer.copyFrom (i, 0, audioOut, i, 0, numSamples);
 
@@ -302,6 +338,8 @@ struct RootGraphRender : public AsyncUpdater
             midi.clear();
             for (int i = 0; i < buffer.getNumChannels(); ++i)
                 zeromem (buffer.getWritePointer(i), sizeof (float) * (size_t) numSamples);
+            if (transport != nullptr && transport->isPlaying())
+                transport->advance (numSamples);
         }
 
         lastGraph = currentGraph;
@@ -315,6 +353,12 @@ struct RootGraphRender : public AsyncUpdater
         graphs.add (graph);
         graph->engineIndex = graphs.size() - 1;
 
+        auto* slot = slots.add (new GraphSlot());
+        if (numInputChans >= 0)
+            slot->prepare (audioOut.getNumChannels(), audioOut.getNumSamples());
+        slotTasks.reset (slots.size());
+        slotTasks.finalize();
+
         if (graph->engineIndex == 0)
         {
             setCurrentGraph (0);
@@ -328,7 +372,11 @@ struct RootGraphRender : public AsyncUpdater
     void removeGraph (RootGraph* graph)
     {
         jassert (graphs.contains (graph));
-        graphs.removeFirstMatchingValue (graph);
+        const int index = graphs.indexOf (graph);
+        graphs.remove (index);
+        slots.remove (index);
+        slotTasks.reset (slots.size());
+        slotTasks.finalize();
         graph->engineIndex = -1;
         updateIndexes();
         if (currentGraph >= graphs.size())
@@ -372,9 +420,112 @@ private:
 
     int numInputChans       = -1;
     int numOutputChans      = -1;
-    AudioSampleBuffer   audioOut, audioTemp;
+    AudioSampleBuffer   audioOut;
+    MidiBuffer midiOut;
+
+    /** Scratch space for one graph, so graphs can render at the same time */
+    struct GraphSlot
+    {
+        enum MixMode { Silent = 0, Normal, FadeIn, FadeOut };
 
-    MidiBuffer midiOut, midiTemp;
+        AudioSampleBuffer audio { 1, 1 };
+        MidiBuffer midi;
+        MidiBuffer pieceMidi, pieceMidiOut;  // for blocks split at tempo changes
+        int mix = Silent;
+
+        void prepare (const int numChans, const int numSamples)
+        {
+            audio.setSize (jmax (1, numChans), jmax (1, numSamples));
+            midi.ensureSize (4096);
+            pieceMidi.ensureSize (4096);
+            pieceMidiOut.ensureSize (4096);
+        }
+
+        void release()
+        {
+            audio.setSize (1, 1);
+            midi.clear();
+            pieceMidi.clear();
+            pieceMidiOut.clear();
+        }
+    };
+
+    OwnedArray<GraphSlot> slots;
+    RenderThreadPool::TaskGraph slotTasks;
+    RenderThreadPool* pool = nullptr;
+    const AudioSampleBuffer* currentInput = nullptr;
+
+    struct GraphRenderJob : public RenderThreadPool::Job
+    {
+        GraphRenderJob (RootGraphRender& r, const int s, const int n, const int total)
+            : render (r), start (s), numFrames (n), numSamples (total) { }
+
+        void runTask (const int index) override
+        {
+            render.renderGraph (index, start, numFrames, numSamples);
+        }
+
+        RootGraphRender& render;
+        const int start, numFrames, numSamples;
+    };
+
+    /** Renders frames start to start + numFrames of a graph's slot */
+    void renderGraph (const int index, const int start, const int numFrames, const int numSamples)
+    {
+        auto* const graph = graphs.getUnchecked (index);
+        auto& slot = *slots.getUnchecked (index);
+        const auto& input = *currentInput;
+        const int numChans = input.getNumChannels();
+
+        // copy inputs, clear outs if more than input count
+        for (int i = 0; i < jmin (numInputChans, numChans); ++i)
+            slot.audio.copyFrom (i, start, input, i, start, numFrames);
+        for (int i = jmax (0, numInputChans); i < numChans; ++i)
+            slot.audio.clear (i, start, numFrames);
+
+        if (start == 0 && numFrames == numSamples)
+        {
+            processGraph (*graph, slot.audio, slot.midi);
+            return;
+        }
+
+        // a piece of a block split at tempo changes. the last piece also
+        // gets events past the end of the block, like a whole block would
+        const bool isLast = start + numFrames >= numSamples;
+        AudioSampleBuffer audio (slot.audio.getArrayOfWritePointers(), numChans, start, numFrames);
+        slot.pieceMidi.clear();
+        slot.pieceMidi.addEvents (slot.midi, start, isLast ? -1 : numFrames, -start);
+
+        if (start == 0)
+            slot.pieceMidiOut.clear();
+        processGraph (*graph, audio, slot.pieceMidi);
+        slot.pieceMidiOut.addEvents (slot.pieceMidi, 0, -1, start);
+
+        if (isLast)
+            slot.midi.swapWith (slot.pieceMidiOut);
+    }
+
+    /** Graphs publish their programs atomically, so rendering never waits on
+        the callback lock. It's still tried though: suspendProcessing() takes
+        it, and has to block until a block in progress is done before the
+        graph can be released. If it's held, the graph sits this block out */
+    static void processGraph (RootGraph& graph, AudioSampleBuffer& audio, MidiBuffer& midi)
+    {
+        const ScopedTryLock sl (graph.getCallbackLock());
+        if (! sl.isLocked())
+        {
+            audio.clear();
+            midi.clear();
+        }
+        else if (graph.isSuspended())
+        {
+            graph.processBlockBypassed (audio, midi);
+        }
+        else
+        {
+            graph.processBlock (audio, midi);
+        }
+    }
 
     void updateIndexes()
     {
@@ -389,7 +540,7 @@ private:
             for (int i = 0; i < graphs.size(); ++i)
             {
                 auto* const g = graphs.getUnchecked (i);
-                if (g->midiProgram == r.program && g->acceptsMidiChannel (program.channel))
+                if (g->midiProgram.get() == r.program && g->acceptsMidiChannel (program.channel))
                     return g->engineIndex;
             }
         }
@@ -402,6 +553,7 @@ class AudioEngine::Private : public AudioIODeviceCallback,
                              public MidiInputCallback,
                              public Value::Listener,
                              public MidiClock::Listener,
+                             public ValueTree::Listener,
                              public Timer
 {
 public:
@@ -417,6 +569,7 @@ public:
         sessionWantsExternalClock.set (0);
         midiClock.addListener (this);
         graphs.onActiveGraphChanged = std::bind (&AudioEngine::Private::onCurrentGraphChanged, this);
+        graphs.setRenderThreadPool (&renderThreads);
         midiIOMonitor = new MidiIOMonitor();
         startTimerHz (90);
     }
@@ -424,7 +577,11 @@ public:
     ~Private()
     {
         graphs.onActiveGraphChanged = nullptr;
+        graphs.setRenderThreadPool (nullptr);
+        for (auto* graph : graphs.getGraphs())
+            graph->setRenderThreadPool (nullptr);
         midiClock.removeListener (this);
+        tempoMapData.removeListener (this);
         tempoValue.removeListener (this);
         externalClockValue.removeListener (this);
         
@@ -439,6 +596,13 @@ public:
     void timerCallback() override
     {
         midiIOMonitor->notify();
+
+        // edits like TempoMap::addRamp change many children at once
+        if (tempoMapChanged)
+        {
+            tempoMapChanged = false;
+            updateTempoMap();
+        }
     }
 
     RootGraph* getCurrentGraph() const { return graphs.getCurrentGraph(); }
@@ -557,10 +721,13 @@ public:
         const ScopedLock sl (lock);
         const bool shouldProcess = shouldBeLocked.get() == 0;
         const bool wasPlaying = transport.isPlaying();
+        bool advanced = false;
         transport.preProcess (numSamples);
 
         if (shouldProcess)
         {
+            engine.world.getMappingEngine().processParameterChanges (numSamples, sampleRate);
+
            #if defined (EL_PRO)
             if (generateMidiClock.get() == 1 && sendMidiClockToInput.get() == 1)
             {
@@ -583,21 +750,26 @@ public:
 
             if (currentGraph.get() != graphs.getCurrentGraphIndex())
                 graphs.setCurrentGraph (currentGraph.get());
-            graphs.renderGraphs (buffer, midi);  // user requested index can be cancelled by program changed
+
+            // the graphs advance the transport when following its tempo map
+            advanced = isTimeMaster();
+            graphs.renderGraphs (buffer, midi, advanced ? &transport : nullptr);  // user requested index can be cancelled by program changed
+
             currentGraph.set (graphs.getCurrentGraphIndex());
         }
         else
         {
+            engine.world.getMappingEngine().discardParameterChanges();
             for (int i = 0; i < buffer.getNumChannels(); ++i)
                 zeromem (buffer.getWritePointer(i), sizeof (float) * (size_t) numSamples);
         }
 
-        if (transport.isPlaying())
+        if (transport.isPlaying() && ! advanced)
             transport.advance (numSamples);
         
         transport.postProcess (numSamples);
     }
-    
+
     bool isTimeMaster() const
     {
        #if EL_RUNNING_AS_PLUGIN
@@ -632,6 +804,7 @@ public:
         channels.calloc ((size_t) jmax (numChansIn, numChansOut) + 2);
         
         graphs.prepareBuffers (numInputChans, numOutputChans, blockSize);
+        updateTempoMap();
 
         if (isPrepared)
         {
@@ -641,6 +814,7 @@ public:
 
         prepareToPlay (sampleRate, blockSize);
         isPrepared = true;
+        engine.world.getMappingEngine().setRendering (true);
     }
     
     void audioDeviceStopped() override
@@ -651,6 +825,7 @@ public:
     void audioStopped()
     {
         const ScopedLock sl (lock);
+        engine.world.getMappingEngine().setRendering (false);
         keyboardState.removeListener (&messageCollector);
         if (isPrepared)
             releaseResources();
@@ -707,14 +882,20 @@ public:
         }
         
         graph->renderingSequenceChanged.disconnect_all_slots();
+        graph->setRenderThreadPool (nullptr);
         if (isPrepared)
             graph->releaseResources();
     }
     
     void connectSessionValues()
     {
+        tempoMapData.removeListener (this);
+        tempoMapData = ValueTree();
+
         if (session)
         {
+            tempoMapData = session->getTempoMap().getValueTree();
+            tempoMapData.addListener (this);
             tempoValue.referTo (session->getPropertyAsValue (Tags::tempo));
             externalClockValue.referTo (session->getPropertyAsValue ("externalSync"));
             transport.requestMeter (session->getProperty (Tags::beatsPerBar, 4),
@@ -725,6 +906,8 @@ public:
             tempoValue = tempoValue.getValue();
             externalClockValue = externalClockValue.getValue();
         }
+
+        updateTempoMap();
     }
     
     void setSession (SessionPtr s)
@@ -732,6 +915,23 @@ public:
         session = s;
         connectSessionValues();
     }
+
+    /** Rebuilds the transport's tempo table from the session */
+    void updateTempoMap()
+    {
+        tempoMapChanged = false;
+        const auto tempoMap = session != nullptr ? session->getTempoMap() : TempoMap();
+        if (tempoMap.getNumChanges() <= 0 || sampleRate <= 0.0)
+        {
+            transport.setTempoMap (nullptr);
+            return;
+        }
+
+        transport.setTempoMap (tempoMap.createTable (sampleRate,
+            (double) session->getProperty (Tags::tempo, 120.0),
+            (int) session->getProperty (Tags::beatsPerBar, 4),
+            (int) session->getProperty (Tags::beatDivisor, 2)));
+    }
     
     void valueChanged (Value& value) override
     {
@@ -740,6 +940,7 @@ public:
             const float tempo = (float) tempoValue.getValue();
             if (sessionWantsExternalClock.get() <= 0 || processMidiClock.get() <= 0)
                 transport.requestTempo (tempo);
+            updateTempoMap();
         }
         else if (externalClockValue.refersToSameSourceAs (value))
         {
@@ -757,6 +958,13 @@ public:
         }
     }
     
+    void valueTreePropertyChanged (ValueTree&, const Identifier&) override   { tempoMapChanged = true; }
+    void valueTreeChildAdded (ValueTree&, ValueTree&) override              { tempoMapChanged = true; }
+    void valueTreeChildRemoved (ValueTree&, ValueTree&, int) override       { tempoMapChanged = true; }
+    void valueTreeChildOrderChanged (ValueTree&, int, int) override         { tempoMapChanged = true; }
+    void valueTreeParentChanged (ValueTree&) override { }
+    void valueTreeRedirected (ValueTree&) override { }
+
     void resetMidiClock()
     {
         midiClock.reset (sampleRate, blockSize);
@@ -789,6 +997,8 @@ private:
     
     Value tempoValue;
     Atomic<float> nextTempo;
+    ValueTree tempoMapData;
+    bool tempoMapChanged = false;
     
     CriticalSection     lock;
     double sampleRate   = 0.0;
@@ -823,12 +1033,16 @@ private:
     Atomic<int> shouldBeLocked { 0 };
 
     MidiIOMonitorPtr midiIOMonitor;
+    RenderThreadPool renderThreads;
+    RenderBufferPool::Ptr renderBuffers { new RenderBufferPool() };
 
     void prepareGraph (RootGraph* graph, double sampleRate, int estimatedBlockSize)
     {
         graph->setPlayConfigDetails (numInputChans, numOutputChans,
                                      sampleRate, blockSize);
         graph->setPlayHead (&transport);
+        graph->setRenderThreadPool (&renderThreads);
+        graph->setRenderBufferPool (renderBuffers);
         graph->prepareToPlay (sampleRate, estimatedBlockSize);
     }
     
@@ -895,6 +1109,8 @@ void AudioEngine::applySettings (Settings& settings)
     priv->processMidiClock.set (useMidiClock ? 1 : 0);
     priv->generateMidiClock.set (settings.generateMidiClock() ? 1 : 0);
     priv->sendMidiClockToInput.set (settings.sendMidiClockToInput() ? 1 : 0);
+    if (priv->renderThreads.getNumThreads() != settings.getNumRenderThreads())
+        priv->renderThreads.setNumThreads (settings.getNumRenderThreads());
 }
 
 bool AudioEngine::removeGraph (RootGraph* graph)
@@ -51,7 +51,6 @@ public:
     inline void setLocked (const var&)
     {
         const bool isNowLocked = false;
-        ScopedLock sl (getCallbackLock());
         locked = isNowLocked;
     }
 
@@ -74,25 +73,19 @@ public:
     void setPlayConfigFor (const DeviceManager::AudioDeviceSetup& setup);
     void setPlayConfigFor (DeviceManager&);
     
-    inline RenderMode getRenderMode() const { return renderMode; }
-    inline String getRenderModeSlug() const { return getSlugForRenderMode (renderMode); }
+    inline RenderMode getRenderMode() const { return static_cast<RenderMode> (renderMode.get()); }
+    inline String getRenderModeSlug() const { return getSlugForRenderMode (getRenderMode()); }
     inline bool isSingle() const { return getRenderMode() == SingleGraph; }
     
     inline void setRenderMode (const RenderMode mode)
     {
-        // TODO: don't use a lock
-        if (! locked && renderMode == static_cast<int> (mode))
-            return;
-        ScopedLock sl (getCallbackLock());
-        renderMode = locked ? SingleGraph : mode;
+        // read by the audio thread when mixing, so it's set atomically
+        renderMode.set (locked ? SingleGraph : mode);
     }
 
     inline void setMidiProgram (const int program)
     {
-        if (program == midiProgram)
-            return;
-        ScopedLock sl (getCallbackLock());
-        midiProgram = program;
+        midiProgram.set (program);
     }
     
     const String getName() const override;
@@ -115,9 +108,9 @@ private:
     StringArray audioInputNames;
     StringArray audioOutputNames;
     int midiChannel = 0;
-    int midiProgram = -1;
+    Atomic<int> midiProgram { -1 };
     int engineIndex = -1;
-    RenderMode renderMode = Parallel;
+    Atomic<int> renderMode { Parallel };
     
     bool locked = true;
 
@@ -0,0 +1,324 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/DiskStreamer.h"
+
+namespace Element {
+
+/** Loads queued heads on the streamer's first thread */
+class DiskStreamer::Loader : public TimeSliceClient
+{
+public:
+    Loader (DiskStreamer& s) : streamer (s) { }
+    int useTimeSlice() override { return streamer.loadNextHead() ? 0 : 250; }
+
+private:
+    DiskStreamer& streamer;
+};
+
+//=============================================================================
+DiskStreamer::DiskStreamer()
+{
+    formats.registerBasicFormats();
+
+    const int numThreads = jlimit (1, 4, SystemStats::getNumCpus() / 2);
+    for (int i = 0; i < numThreads; ++i)
+        threads.add (new TimeSliceThread ("Disk Streamer " + String (i + 1)))->startThread();
+
+    loader.reset (new Loader (*this));
+    threads.getFirst()->addTimeSliceClient (loader.get());
+}
+
+DiskStreamer::~DiskStreamer()
+{
+    threads.getFirst()->removeTimeSliceClient (loader.get());
+    for (auto* const thread : threads)
+    {
+        // streams must be deleted before the streamer
+        jassert (thread->getNumClients() == 0);
+        thread->stopThread (1000);
+    }
+
+    threads.clear();
+    loader = nullptr;
+    pending.clearQuick();
+    cache.clear();
+}
+
+bool DiskStreamer::canLoad (const File& file)
+{
+    std::unique_ptr<AudioFormatReader> reader (formats.createReaderFor (file));
+    return reader != nullptr;
+}
+
+AudioFormatReader* DiskStreamer::createReaderFor (const File& file)
+{
+    auto* const format = formats.findFormatForFileExtension (file.getFileExtension());
+    if (dynamic_cast<WavAudioFormat*> (format) != nullptr ||
+        dynamic_cast<AiffAudioFormat*> (format) != nullptr)
+    {
+        std::unique_ptr<MemoryMappedAudioFormatReader> mapped (format->createMemoryMappedReader (file));
+        if (mapped != nullptr && mapped->mapEntireFile())
+            return mapped.release();
+    }
+
+    return formats.createReaderFor (file);
+}
+
+AudioFileStream* DiskStreamer::createStream (const File& file, int readAheadSamples)
+{
+    if (auto* const reader = createReaderFor (file))
+        return new AudioFileStream (*this, file, reader, readAheadSamples);
+    return nullptr;
+}
+
+String DiskStreamer::getCacheKey (const File& file)
+{
+    return file.getFullPathName() + "|" + String (file.getSize())
+        + "|" + String (file.getLastModificationTime().toMilliseconds());
+}
+
+AudioFileHead::Ptr DiskStreamer::getHead (const File& file)
+{
+    const auto key = getCacheKey (file);
+    const ScopedLock sl (lock);
+
+    for (auto* const head : cache)
+    {
+        if (head->key == key)
+        {
+            head->lastUsed = ++useCounter;
+            return head;
+        }
+    }
+
+    AudioFileHead::Ptr head = new AudioFileHead (file, key);
+    head->lastUsed = ++useCounter;
+    cache.add (head);
+    pending.add (head.get());
+    threads.getFirst()->moveToFrontOfQueue (loader.get());
+    return head;
+}
+
+bool DiskStreamer::loadNextHead()
+{
+    AudioFileHead::Ptr head;
+
+    {
+        const ScopedLock sl (lock);
+        if (pending.isEmpty())
+            return false;
+        head = pending.removeAndReturn (0);
+    }
+
+    std::unique_ptr<AudioFormatReader> reader (createReaderFor (head->file));
+    if (reader != nullptr)
+    {
+        const auto numSamples = (int) jmin (reader->lengthInSamples,
+                                            (int64) (headSeconds.load() * reader->sampleRate));
+        head->samples.setSize ((int) reader->numChannels, numSamples);
+        reader->read (&head->samples, 0, numSamples, 0, true, true);
+    }
+
+    // a head which failed to load is still marked ready, streams just
+    // won't find any samples in it
+    head->ready.store (true, std::memory_order_release);
+
+    const ScopedLock sl (lock);
+    trimCache();
+    return true;
+}
+
+TimeSliceThread& DiskStreamer::getThread()
+{
+    auto* best = threads.getFirst();
+    for (auto* const thread : threads)
+        if (thread->getNumClients() < best->getNumClients())
+            best = thread;
+    return *best;
+}
+
+void DiskStreamer::setHeadLength (double seconds)
+{
+    headSeconds.store (jlimit (0.0, 30.0, seconds));
+}
+
+void DiskStreamer::setCacheLimit (int64 maxBytes)
+{
+    cacheLimit.store (jmax ((int64) 0, maxBytes));
+    const ScopedLock sl (lock);
+    trimCache();
+}
+
+int64 DiskStreamer::getCacheSize() const
+{
+    const ScopedLock sl (lock);
+    int64 total = 0;
+    for (auto* const head : cache)
+        if (head->isReady())
+            total += head->getSizeInBytes();
+    return total;
+}
+
+void DiskStreamer::trimCache()
+{
+    int64 total = 0;
+    for (auto* const head : cache)
+        if (head->isReady())
+            total += head->getSizeInBytes();
+
+    while (total > cacheLimit.load())
+    {
+        // drop the least recently used head no stream is holding.
+        // pending heads are skipped, the loader still points at them
+        AudioFileHead* oldest = nullptr;
+        for (auto* const head : cache)
+            if (head->isReady() && head->getReferenceCount() == 1 &&
+                    (oldest == nullptr || head->lastUsed < oldest->lastUsed))
+                oldest = head;
+
+        if (oldest == nullptr)
+            break;
+
+        total -= oldest->getSizeInBytes();
+        cache.removeObject (oldest);
+    }
+}
+
+//=============================================================================
+AudioFileStream::AudioFileStream (DiskStreamer& streamer, const File& f, AudioFormatReader* reader, int readAheadSamples)
+    : file (f),
+      head (streamer.getHead (f)),
+      source (new AudioFormatReaderSource (reader, true)),
+      length (reader->lengthInSamples),
+      sampleRate (reader->sampleRate),
+      numChannels ((int) reader->numChannels),
+      readAhead (jmax (1024, readAheadSamples))
+{
+    // the head covers the start, so there's no need to wait for a prefill
+    buffering.reset (new BufferingAudioSource (source.get(), streamer.getThread(),
+                                               false, readAhead, 2, false));
+}
+
+AudioFileStream::~AudioFileStream()
+{
+    buffering = nullptr;
+    source = nullptr;
+}
+
+void AudioFileStream::prepareToPlay (int samplesPerBlockExpected, double newSampleRate)
+{
+    buffering->prepareToPlay (samplesPerBlockExpected, newSampleRate);
+    cueBuffering (getNextReadPosition());
+}
+
+void AudioFileStream::releaseResources()
+{
+    buffering->releaseResources();
+}
+
+void AudioFileStream::setLooping (bool shouldLoop)
+{
+    looping.store (shouldLoop);
+    source->setLooping (shouldLoop);
+}
+
+void AudioFileStream::setNextReadPosition (int64 newPosition)
+{
+    newPosition = jmax ((int64) 0, newPosition);
+    pendingSeek.store (newPosition);
+    cueBuffering (newPosition);
+}
+
+int64 AudioFileStream::getNextReadPosition() const
+{
+    const auto seek = pendingSeek.load();
+    const auto pos = seek >= 0 ? seek : position.load();
+    return looping.load() && length > 0 ? pos % length : pos;
+}
+
+void AudioFileStream::cueBuffering (int64 pos)
+{
+    if (head->isReady())
+    {
+        const int64 headLength = head->getNumSamples();
+        if (headLength >= length)
+            return;
+
+        // while the head plays, read ahead from where it ends
+        if (pos < headLength)
+            pos = headLength;
+    }
+
+    if (buffering->getNextReadPosition() != pos)
+        buffering->setNextReadPosition (pos);
+}
+
+void AudioFileStream::readHead (const AudioSourceChannelInfo& info, int offset, int64 pos, int numSamples)
+{
+    const auto& samples = head->getSamples();
+    for (int c = 0; c < info.buffer->getNumChannels(); ++c)
+        info.buffer->copyFrom (c, info.startSample + offset, samples,
+                               jmin (c, samples.getNumChannels() - 1),
+                               (int) pos, numSamples);
+}
+
+void AudioFileStream::getNextAudioBlock (const AudioSourceChannelInfo& info)
+{
+    const auto seek = pendingSeek.exchange (-1);
+    int64 pos = seek >= 0 ? seek : position.load();
+    const bool loop = looping.load() && length > 0;
+    const int64 headLength = head->isReady() ? head->getNumSamples() : 0;
+
+    int done = 0;
+    while (done < info.numSamples)
+    {
+        if (loop)
+            pos %= length;
+
+        const int numLeft = info.numSamples - done;
+
+        if (pos < headLength)
+        {
+            const int numSamples = (int) jmin ((int64) numLeft, headLength - pos);
+            readHead (info, done, pos, numSamples);
+            cueBuffering (pos);
+            done += numSamples;
+            pos += numSamples;
+        }
+        else if (! loop && pos >= length)
+        {
+            info.buffer->clear (info.startSample + done, numLeft);
+            done += numLeft;
+            pos += numLeft;
+        }
+        else
+        {
+            const int numSamples = loop ? (int) jmin ((int64) numLeft, length - pos) : numLeft;
+            cueBuffering (pos);
+            buffering->getNextAudioBlock (AudioSourceChannelInfo (info.buffer, info.startSample + done, numSamples));
+            done += numSamples;
+            pos += numSamples;
+        }
+    }
+
+    position.store (pos);
+}
+
+}
@@ -0,0 +1,180 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+class AudioFileStream;
+
+/** The first seconds of an audio file, decoded to float. Heads are loaded
+    in the background and shared by every stream playing the same file */
+class AudioFileHead : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<AudioFileHead>;
+
+    /** True once the samples have been loaded. Safe on any thread */
+    bool isReady() const noexcept               { return ready.load (std::memory_order_acquire); }
+
+    /** The loaded samples. Only valid once isReady returns true */
+    const AudioBuffer<float>& getSamples() const noexcept { return samples; }
+    int getNumSamples() const noexcept          { return samples.getNumSamples(); }
+    int64 getSizeInBytes() const noexcept       { return (int64) samples.getNumChannels() * samples.getNumSamples() * (int64) sizeof (float); }
+
+private:
+    friend class DiskStreamer;
+    AudioFileHead (const File& f, const String& k) : file (f), key (k) { }
+
+    const File file;
+    const String key;
+    AudioBuffer<float> samples;
+    std::atomic<bool> ready { false };
+    uint32 lastUsed = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioFileHead)
+};
+
+/** Streams audio files from disk for the player nodes.
+
+    Players share one streamer through a SharedResourcePointer. Its small
+    pool of background threads does the read-ahead for every stream, so
+    the thread count doesn't grow with the number of players. WAV and AIFF
+    files are memory mapped. The head of each file is decoded once and
+    kept in a cache bounded by size, so cueing to the start never waits
+    on the disk.
+ */
+class DiskStreamer
+{
+public:
+    enum { defaultReadAhead = 1024 * 8 };
+
+    DiskStreamer();
+    ~DiskStreamer();
+
+    /** Formats the streamer can open. Don't add or remove formats */
+    AudioFormatManager& getFormats() noexcept   { return formats; }
+
+    /** Returns true if the file is in a readable format */
+    bool canLoad (const File& file);
+
+    /** Creates a reader for a file. WAV and AIFF files are memory mapped
+        when the whole file can be mapped */
+    AudioFormatReader* createReaderFor (const File& file);
+
+    /** Creates a stream for a file, or nullptr if it can't be read. This
+        only reads the file's header, the head is loaded in the background.
+        Don't call on the audio thread */
+    AudioFileStream* createStream (const File& file, int readAheadSamples = defaultReadAhead);
+
+    /** Returns the cached head for a file, queueing it to load if needed */
+    AudioFileHead::Ptr getHead (const File& file);
+
+    /** Returns the background thread with the fewest streams on it */
+    TimeSliceThread& getThread();
+    int getNumThreads() const noexcept          { return threads.size(); }
+
+    /** Sets how much of each file is preloaded. Applies to heads loaded after */
+    void setHeadLength (double seconds);
+    double getHeadLength() const noexcept       { return headSeconds.load(); }
+
+    /** Sets the most memory the cache may use. Heads still in use by a
+        stream are kept even if that goes over */
+    void setCacheLimit (int64 maxBytes);
+    int64 getCacheLimit() const noexcept        { return cacheLimit.load(); }
+    int64 getCacheSize() const;
+
+private:
+    class Loader;
+    AudioFormatManager formats;
+    OwnedArray<TimeSliceThread> threads;
+    std::unique_ptr<Loader> loader;
+
+    CriticalSection lock;
+    ReferenceCountedArray<AudioFileHead> cache;
+    Array<AudioFileHead*> pending;
+    uint32 useCounter = 0;
+    std::atomic<double> headSeconds { 2.0 };
+    std::atomic<int64> cacheLimit { 256 * 1024 * 1024 };
+
+    static String getCacheKey (const File&);
+    bool loadNextHead();
+    void trimCache();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DiskStreamer)
+};
+
+/** A PositionableAudioSource which plays a file through a DiskStreamer.
+
+    Blocks within the file's head are copied from memory. Everything past
+    it comes from a BufferingAudioSource on one of the streamer's threads,
+    which is kept cued to the end of the head while the head plays. Seeking
+    never waits on the disk. Re-cueing the buffer takes its short lock,
+    which happens on a seek, when playback loops back into the head, and
+    when it first leaves the head.
+
+    Give it to an AudioTransportSource without read-ahead, it does its own.
+ */
+class AudioFileStream : public PositionableAudioSource
+{
+public:
+    ~AudioFileStream();
+
+    const File& getFile() const noexcept        { return file; }
+    double getSampleRate() const noexcept       { return sampleRate; }
+    int getNumChannels() const noexcept         { return numChannels; }
+    int getReadAheadSamples() const noexcept    { return readAhead; }
+    const AudioFileHead& getHead() const noexcept { return *head; }
+
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock (const AudioSourceChannelInfo&) override;
+
+    void setNextReadPosition (int64 newPosition) override;
+    int64 getNextReadPosition() const override;
+    int64 getTotalLength() const override       { return length; }
+    bool isLooping() const override             { return looping.load(); }
+    void setLooping (bool shouldLoop) override;
+
+private:
+    friend class DiskStreamer;
+    AudioFileStream (DiskStreamer&, const File&, AudioFormatReader*, int readAhead);
+
+    const File file;
+    AudioFileHead::Ptr head;
+    std::unique_ptr<AudioFormatReaderSource> source;
+    std::unique_ptr<BufferingAudioSource> buffering;
+    const int64 length;
+    const double sampleRate;
+    const int numChannels;
+    const int readAhead;
+
+    std::atomic<int64> position { 0 };
+    std::atomic<int64> pendingSeek { -1 };
+    std::atomic<bool> looping { false };
+
+    void cueBuffering (int64 newPosition);
+    void readHead (const AudioSourceChannelInfo&, int offset, int64 pos, int numSamples);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioFileStream)
+};
+
+}
@@ -185,16 +185,47 @@ bool GraphNode::isMidiDeviceNode() const
 int GraphNode::getNumAudioInputs()      const { return ports.size (PortType::Audio, true); }
 int GraphNode::getNumAudioOutputs()     const { return ports.size (PortType::Audio, false); }
 
-void GraphNode::setInputRMS (int chan, float val)
+void GraphNode::subscribeMeter (bool isInput, int channel)
 {
-    if (chan < inRMS.size())
-        inRMS.getUnchecked(chan)->set(val);
+    jassert (MessageManager::getInstance()->isThisTheMessageThread());
+    if (meter == nullptr || channel >= meter->getNumChannels (isInput))
+        updateMeter();
+    meter->subscribe (isInput, channel);
 }
 
-void GraphNode::setOutputRMS (int chan, float val)
+void GraphNode::unsubscribeMeter (bool isInput, int channel)
 {
-    if (chan < outRMS.size())
-        outRMS.getUnchecked(chan)->set(val);
+    jassert (MessageManager::getInstance()->isThisTheMessageThread());
+    if (meter != nullptr)
+        meter->unsubscribe (isInput, channel);
+}
+
+NodeMeter::Levels GraphNode::readMeter (bool isInput, int channel)
+{
+    return meter != nullptr ? meter->read (isInput, channel) : NodeMeter::Levels();
+}
+
+void GraphNode::updateMeter()
+{
+    const int numIns  = getNumAudioInputs();
+    const int numOuts = getNumAudioOutputs();
+    if (meter != nullptr && meter->getNumChannels (true) == numIns && meter->getNumChannels (false) == numOuts)
+        return;
+
+    NodeMeter::Ptr newMeter = new NodeMeter (numIns, numOuts);
+    if (meter != nullptr)
+    {
+        for (int side = 0; side < 2; ++side)
+            for (int c = 0; c < meter->getNumChannels (side == 0); ++c)
+                for (int i = meter->getNumSubscribers (side == 0, c); --i >= 0;)
+                    newMeter->subscribe (side == 0, c);
+
+        // the audio thread may still be measuring the old one
+        retiredMeters.add (meter);
+    }
+
+    meter = newMeter;
+    activeMeter.store (meter.get(), std::memory_order_release);
 }
 
 bool GraphNode::isSuspended() const
@@ -302,8 +333,8 @@ void GraphNode::prepare (const double sampleRate, const int blockSize,
 
         initOversampling (jmax (getNumPorts (PortType::Audio, true), getNumPorts (PortType::Audio, false)), blockSize);
 
-        const int osFactor = getOversamplingFactor();
-        prepareToRender (sampleRate * osFactor, blockSize * osFactor);
+        const int factor = osRenderFactor.get();
+        prepareToRender (sampleRate * factor, blockSize * factor);
 
         // TODO: move model code out of engine code
         // VERIFY: this portion is actually needed. This was here to ensure
@@ -315,21 +346,8 @@ void GraphNode::prepare (const double sampleRate, const int blockSize,
         if (metadata.getProperty (Tags::bypass, false))
             suspendProcessing (true);
 
-        inRMS.clearQuick (true);
-        for (int i = 0; i < getNumAudioInputs(); ++i)
-        {
-            AtomicValue<float>* avf = new AtomicValue<float>();
-            avf->set(0);
-            inRMS.add (avf);
-        }
-
-        outRMS.clearQuick (true);
-        for (int i = 0; i < getNumAudioOutputs(); ++i)
-        {
-            AtomicValue<float>* avf = new AtomicValue<float>();
-            avf->set(0);
-            outRMS.add(avf);
-        }
+        if (meter != nullptr)
+            updateMeter();
     }
 }
 
@@ -338,8 +356,7 @@ void GraphNode::unprepare()
     if (isPrepared)
     {
         isPrepared = false;
-        inRMS.clear (true);
-        outRMS.clear (true);
+        retiredMeters.clear();
         resetOversampling();
         releaseResources();
     }
@@ -682,6 +699,14 @@ void GraphNode::resetPorts()
 
 GraphProcessor* GraphNode::getParentGraph() const { return parent; }
 
+void GraphNode::setLatencySamples (int latency)
+{
+    if (latencySamples.exchange (latency) == latency)
+        return;
+    if (auto* const graph = getParentGraph())
+        graph->nodeLatencyChanged();
+}
+
 void GraphNode::setParentGraph (GraphProcessor* const graph)
 {
     typedef GraphProcessor::AudioGraphIOProcessor IOP;
@@ -704,45 +729,73 @@ void GraphNode::setMuted (bool muted)
 
 void GraphNode::initOversampling (int numChannels, int blockSize)
 {
-    osProcessors.clear();
+    const int factor = osFactor.get();
+    if (factor <= 1)
+    {
+        osProcessor.reset();
+        osChannels.free();
+        osNumChannels = 0;
+        osLatency.set (0);
+        osRenderFactor.set (1);
+        return;
+    }
+
     numChannels = jmax (1, numChannels); // avoid assertion on nodes that don't have audio
-    for (int pow = 1; pow <= maxOsPow; ++pow)
-        osProcessors.add (new dsp::Oversampling<float> (numChannels, pow, dsp::Oversampling<float>::FilterType::filterHalfBandPolyphaseIIR));
+    const int filter = osFilter.get();
 
-    prepareOversampling (blockSize);
-}
+    if (osProcessor == nullptr || osNumChannels != numChannels || osProcessorFilter != filter
+        || static_cast<int> (osProcessor->getOversamplingFactor()) != factor)
+    {
+        int order = 0;
+        while ((1 << order) < factor)
+            ++order;
 
-void GraphNode::prepareOversampling (int blockSize)
-{
-    for (auto* osProcessor : osProcessors)
-        osProcessor->initProcessing (blockSize);
+        osProcessor.reset (new dsp::Oversampling<float> ((size_t) numChannels, (size_t) order,
+            filter == linearPhaseFilter ? dsp::Oversampling<float>::filterHalfBandFIREquiripple
+                                        : dsp::Oversampling<float>::filterHalfBandPolyphaseIIR));
+        osProcessorFilter = filter;
+        osChannels.calloc ((size_t) numChannels);
+        osNumChannels = numChannels;
+    }
+
+    osProcessor->initProcessing ((size_t) blockSize);
+    osLatency.set (roundFloatToInt (osProcessor->getLatencyInSamples()));
+    osRenderFactor.set (factor);
 }
 
 void GraphNode::resetOversampling()
 {
-    for (auto* osProcessor : osProcessors)
+    if (osProcessor != nullptr)
         osProcessor->reset();
 }
 
-dsp::Oversampling<float>* GraphNode::getOversamplingProcessor()
+void GraphNode::setOversamplingFactor (int factor)
+{
+    int order = 0;
+    while (order < maxOsOrder && (2 << order) <= factor)
+        ++order;
+    osFactor.set (1 << order);
+}
+
+int GraphNode::getOversamplingFactor() const
 {
-    return osProcessors[osPow-1];
+    return osFactor.get();
 }
 
-void GraphNode::setOversamplingFactor (int osFactor)
+void GraphNode::setOversamplingFilter (OversamplingFilter filter)
 {
-    osPow = (int) log2f ((float) osFactor);
-    if (auto* osProc = getOversamplingProcessor())
-        osLatency = osProc->getLatencyInSamples();
+    osFilter.set (static_cast<int> (filter));
 }
 
-int GraphNode::getOversamplingFactor()
+GraphNode::OversamplingFilter GraphNode::getOversamplingFilter() const
 {
-    if (osPow > 0)
-        if (auto* osProc = getOversamplingProcessor())
-            return static_cast<int> (osProc->getOversamplingFactor());
+    return static_cast<OversamplingFilter> (osFilter.get());
+}
 
-    return 1;
+int GraphNode::getLatencySamples() const
+{
+    const int factor = osRenderFactor.get();
+    return osLatency.get() + (latencySamples.get() + factor / 2) / factor;
 }
 
 //=========================================================================
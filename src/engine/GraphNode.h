@@ -20,6 +20,7 @@
 #pragma once
 
 #include "ElementApp.h"
+#include "engine/NodeMeter.h"
 #include "engine/Parameter.h"
 
 namespace Element {
@@ -162,11 +163,14 @@ public:
     /** Suspend processing */
     void suspendProcessing (const bool);
 
-    /** Get latency audio samples */
-    int getLatencySamples() const { return latencySamples + roundFloatToInt (osLatency); }
+    /** Get latency audio samples. This includes the oversampling filters,
+        and latency the processor reports at the oversampled rate converted
+        to the graph's rate */
+    int getLatencySamples() const;
 
-    /** Set latency samples */
-    void setLatencySamples (int latency) { if (latencySamples != latency) latencySamples = latency; }
+    /** Set latency samples. The parent graph rebuilds its delay compensation
+        when this changes, so it is safe to call from any thread */
+    void setLatencySamples (int latency);
 
     /** Set the Input Gain of this Node */
     void setInputGain (const float f);
@@ -199,10 +203,15 @@ public:
        this will return nullptr */
     GraphProcessor* getParentGraph() const;
 
-    void setInputRMS (int chan, float val);
-    float getInputRMS(int chan) const { return (chan < inRMS.size()) ? inRMS.getUnchecked(chan)->get() : 0.0f; }
-    void setOutputRMS (int chan, float val);
-    float getOutputRMS (int chan) const { return (chan < outRMS.size()) ? outRMS.getUnchecked(chan)->get() : 0.0f; }
+    //=========================================================================
+    /** Starts metering one of this node's audio channels. Levels are only
+        measured while a channel has subscribers, so balance every call with
+        unsubscribeMeter. Message thread only */
+    void subscribeMeter (bool isInput, int channel);
+    void unsubscribeMeter (bool isInput, int channel);
+
+    /** Returns the levels of a subscribed channel measured since the last read */
+    NodeMeter::Levels readMeter (bool isInput, int channel);
 
     //=========================================================================
     /** Connect this node's output audio to another node's input audio */
@@ -335,8 +344,22 @@ public:
     virtual void setState (const void*, int sizeInBytes) = 0;
 
     //=========================================================================
+    /** Filters used to resample when oversampling */
+    enum OversamplingFilter
+    {
+        iirFilter = 0,      ///< Polyphase IIR, little latency but not linear phase
+        linearPhaseFilter   ///< Equiripple FIR, linear phase with more latency
+    };
+
+    /** Sets the oversampling factor: 1, 2, 4 or 8. Only the processor for
+        the chosen factor is created, and not until the node is next prepared */
     void setOversamplingFactor (int osFactor);
-    int getOversamplingFactor();
+    int getOversamplingFactor() const;
+
+    /** Sets the filter used when oversampling. Takes effect the next time
+        the node is prepared */
+    void setOversamplingFilter (OversamplingFilter filter);
+    OversamplingFilter getOversamplingFilter() const;
 
     //=========================================================================
     /** Triggered when the enabled state changes */
@@ -398,13 +421,15 @@ private:
     Atomic<int> mute { 0 };
     Atomic<int> muteInput { 0 };
 
-    int latencySamples = 0;
+    Atomic<int> latencySamples { 0 };
     String name;
 
     ParameterArray parameters;
 
     Atomic<float> gain, lastGain, inputGain, lastInputGain;
-    OwnedArray<AtomicValue<float> > inRMS, outRMS;
+    NodeMeter::Ptr meter;
+    std::atomic<NodeMeter*> activeMeter { nullptr };
+    ReferenceCountedArray<NodeMeter> retiredMeters;
     
     Atomic<int> keyRangeLow { 0 };
     Atomic<int> keyRangeHigh { 127 };
@@ -455,17 +480,22 @@ private:
     void prepare (double sampleRate, int blockSize, GraphProcessor*, bool willBeEnabled = false);
     void unprepare();
     void resetPorts();
+    void updateMeter();
     void initOversampling (int numChannels, int blockSize);
-    void prepareOversampling (int blockSize);
     void resetOversampling();
-    dsp::Oversampling<float>* getOversamplingProcessor();
+    dsp::Oversampling<float>* getOversamplingProcessor() const noexcept { return osProcessor.get(); }
 
     Parameter::Ptr getOrCreateParameter (const PortDescription&);
 
-    int osPow = 0;
-    float osLatency = 0.0f;
-    OwnedArray<dsp::Oversampling<float>> osProcessors;
-    const int maxOsPow = 3;
+    Atomic<int> osFactor { 1 };
+    Atomic<int> osFilter { iirFilter };
+    Atomic<int> osLatency { 0 };
+    Atomic<int> osRenderFactor { 1 };
+    std::unique_ptr<dsp::Oversampling<float>> osProcessor;
+    int osProcessorFilter = iirFilter;
+    HeapBlock<float*> osChannels;
+    int osNumChannels = 0;
+    static constexpr int maxOsOrder = 3;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphNode)
 };
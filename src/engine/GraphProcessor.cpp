@@ -20,8 +20,8 @@
 #include "engine/nodes/AudioProcessorNode.h"
 #include "engine/AudioEngine.h"
 #include "engine/GraphProcessor.h"
+#include "engine/MidiEventStream.h"
 #include "engine/MidiPipe.h"
-#include "engine/MidiTranspose.h"
 #include "engine/nodes/SubGraphProcessor.h"
 #include "session/Node.h"
 
@@ -32,6 +32,7 @@ const int GraphProcessor::midiChannelIndex = 0x1000;
 namespace GraphRender
 {
 
+/** A rendering op with state of its own */
 class Task
 {
 public:
@@ -42,158 +43,148 @@ public:
                           const OwnedArray <MidiBuffer>& sharedMidiBuffers,
                           const int numSamples) = 0;
 
-    JUCE_LEAK_DETECTOR (Task);
-};
-
-class ClearChannelOp : public Task
-{
-public:
-    ClearChannelOp (const int channelNum_)
-        : channelNum (channelNum_)
-    { }
-
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples)
-    {
-        sharedBufferChans.clear (channelNum, 0, numSamples);
-    }
+    /** Adds the indexes of the shared buffers this task reads or writes */
+    virtual void collectBuffers (Array<int>& audio, Array<int>& midi) const = 0;
 
-private:
-    const int channelNum;
+    /** Returns true if this task touches state outside of the shared buffers
+        and can't run concurrently with other tasks like it */
+    virtual bool isSerial() const { return false; }
 
-    JUCE_DECLARE_NON_COPYABLE (ClearChannelOp)
+    JUCE_LEAK_DETECTOR (Task);
 };
 
-
-class CopyChannelOp : public Task
+/** One instruction of a render program.  Ops which only move data around
+    are plain values, anything with state of its own is a Task. */
+struct Op
 {
-public:
-    CopyChannelOp (const int srcChannelNum_, const int dstChannelNum_)
-        : srcChannelNum (srcChannelNum_),
-          dstChannelNum (dstChannelNum_)
-    { }
-
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples)
+    enum Code : uint8
     {
-        sharedBufferChans.copyFrom (dstChannelNum, 0, sharedBufferChans, srcChannelNum, 0, numSamples);
-    }
-
-private:
-    const int srcChannelNum, dstChannelNum;
-
-    JUCE_DECLARE_NON_COPYABLE (CopyChannelOp)
+        clearChannel = 0,
+        copyChannel,
+        addChannel,
+        clearMidi,
+        copyMidi,
+        addMidi,
+        performTask,
+
+        // only found in compiled programs
+        clearChannels,      // clears 'count' channels from the channel table
+        mixChannels         // sums 'count' channels from the table into 'dest'
+    };
+
+    static Op clearAudio (int channel)              { return { clearChannel, false, channel, channel, 0, 0, nullptr }; }
+    static Op copyAudio (int source, int dest)      { return { copyChannel, false, source, dest, 0, 0, nullptr }; }
+    static Op addAudio (int source, int dest)       { return { addChannel, false, source, dest, 0, 0, nullptr }; }
+    static Op clearMidiBuffer (int buffer)          { return { clearMidi, false, buffer, buffer, 0, 0, nullptr }; }
+    static Op copyMidiBuffer (int source, int dest) { return { copyMidi, false, source, dest, 0, 0, nullptr }; }
+    static Op addMidiBuffer (int source, int dest)  { return { addMidi, false, source, dest, 0, 0, nullptr }; }
+    static Op perform (Task* task)                  { return { performTask, false, 0, 0, 0, 0, task }; }
+
+    Code code;
+    bool accumulate;    // mixChannels adds to what's already in 'dest'
+    int source, dest;
+    int index, count;
+    Task* task;
 };
 
-
-class AddChannelOp : public Task
+/** Delays one audio channel for latency compensation. The ring holds the
+    last 'delay' samples and each contiguous run of it is swapped with the
+    channel in one go, so there is no per sample wrapping */
+class DelayChannelOp : public Task
 {
 public:
-    AddChannelOp (const int srcChannelNum_, const int dstChannelNum_)
-        : srcChannelNum (srcChannelNum_),
-          dstChannelNum (dstChannelNum_)
-    { }
-
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples)
+    DelayChannelOp (const int channel_, const int numSamplesDelay_)
+        : channel (channel_),
+          bufferSize (jmax (1, numSamplesDelay_))
     {
-        sharedBufferChans.addFrom (dstChannelNum, 0, sharedBufferChans, srcChannelNum, 0, numSamples);
+        buffer.calloc ((size_t) bufferSize);
     }
 
-private:
-    const int srcChannelNum, dstChannelNum;
-
-    JUCE_DECLARE_NON_COPYABLE (AddChannelOp)
-};
-
-
-class ClearMidiBufferOp : public Task
-{
-public:
-    ClearMidiBufferOp (const int bufferNum_)
-        : bufferNum (bufferNum_)
-    {}
-
-    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int)
+    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples) override
     {
-        sharedMidiBuffers.getUnchecked (bufferNum)->clear();
-    }
-
-private:
-    const int bufferNum;
-
-    JUCE_DECLARE_NON_COPYABLE (ClearMidiBufferOp)
-};
-
-
-class CopyMidiBufferOp : public Task
-{
-public:
-    CopyMidiBufferOp (const int srcBufferNum_, const int dstBufferNum_)
-        : srcBufferNum (srcBufferNum_),
-          dstBufferNum (dstBufferNum_)
-    { }
+        float* data = sharedBufferChans.getWritePointer (channel, 0);
+        int remaining = numSamples;
 
-    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int)
-    {
-        *sharedMidiBuffers.getUnchecked (dstBufferNum) = *sharedMidiBuffers.getUnchecked (srcBufferNum);
+        while (remaining > 0)
+        {
+            const int numToSwap = jmin (remaining, bufferSize - position);
+            std::swap_ranges (data, data + numToSwap, buffer.get() + position);
+            data += numToSwap;
+            remaining -= numToSwap;
+            position += numToSwap;
+            if (position >= bufferSize)
+                position = 0;
+        }
     }
 
-private:
-    const int srcBufferNum, dstBufferNum;
-
-    JUCE_DECLARE_NON_COPYABLE (CopyMidiBufferOp)
-};
-
-
-class AddMidiBufferOp : public Task
-{
-public:
-    AddMidiBufferOp (const int srcBufferNum_, const int dstBufferNum_)
-        : srcBufferNum (srcBufferNum_),
-          dstBufferNum (dstBufferNum_)
-    { }
-
-    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples)
+    void collectBuffers (Array<int>& audio, Array<int>&) const override
     {
-        sharedMidiBuffers.getUnchecked (dstBufferNum)
-            ->addEvents (*sharedMidiBuffers.getUnchecked (srcBufferNum), 0, numSamples, 0);
+        audio.add (channel);
     }
 
 private:
-    const int srcBufferNum, dstBufferNum;
+    HeapBlock<float> buffer;
+    const int channel, bufferSize;
+    int position = 0;
 
-    JUCE_DECLARE_NON_COPYABLE (AddMidiBufferOp)
+    JUCE_DECLARE_NON_COPYABLE (DelayChannelOp)
 };
 
-class DelayChannelOp : public Task
+/** Delays the events in one MIDI buffer by a number of samples, keeping
+    their offsets sample accurate across blocks. Events are held in fixed
+    capacity streams, so nothing is allocated while rendering. Events which
+    don't fit are dropped */
+class DelayMidiOp : public Task
 {
 public:
-    DelayChannelOp (const int channel_, const int numSamplesDelay_)
-        : channel (channel_),
-          bufferSize (numSamplesDelay_ + 1),
-          readIndex (0), writeIndex (numSamplesDelay_)
+    DelayMidiOp (const int buffer_, const int numSamplesDelay_, const int blockSize)
+        : buffer (buffer_), delay (numSamplesDelay_)
     {
-        buffer.calloc ((size_t) bufferSize);
+        // room for an event on every frame the delay and one block span
+        const int maxEvents = jlimit (1024, 32768, numSamplesDelay_ + jmax (1, blockSize));
+        pending.setCapacity (maxEvents, 16384);
+        remaining.setCapacity (maxEvents, 16384);
+        current.setCapacity (maxEvents, 16384);
     }
 
-    void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>&, const int numSamples)
+    void perform (AudioSampleBuffer&, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples) override
     {
-        float* data = sharedBufferChans.getWritePointer (channel, 0);
+        auto& midi = *sharedMidiBuffers.getUnchecked (buffer);
+        const uint8* data = nullptr;
+        int numBytes = 0, frame = 0;
 
-        for (int i = numSamples; --i >= 0;)
+        // pending events are relative to the start of this block, and come
+        // before the ones arriving now
         {
-            buffer [writeIndex] = *data;
-            *data++ = buffer [readIndex];
+            MidiBuffer::Iterator iter (midi);
+            while (iter.getNextEvent (data, numBytes, frame))
+                pending.addEvent (data, numBytes, frame + delay);
+        }
 
-            if (++readIndex  >= bufferSize) readIndex = 0;
-            if (++writeIndex >= bufferSize) writeIndex = 0;
+        current.clear();
+        remaining.clear();
+        for (const auto& e : pending)
+        {
+            if (e.frame < numSamples)
+                current.addEvent (pending.getData (e), e.size, e.frame);
+            else
+                remaining.addEvent (pending.getData (e), e.size, e.frame - numSamples);
         }
+
+        current.writeTo (midi);
+        pending.swapWith (remaining);
+    }
+
+    void collectBuffers (Array<int>&, Array<int>& midi) const override
+    {
+        midi.add (buffer);
     }
 
 private:
-    HeapBlock<float> buffer;
-    const int channel, bufferSize;
-    int readIndex, writeIndex;
+    const int buffer, delay;
+    MidiEventStream pending, remaining, current;
 
-    JUCE_DECLARE_NON_COPYABLE (DelayChannelOp)
+    JUCE_DECLARE_NON_COPYABLE (DelayMidiOp)
 };
 
 
@@ -204,7 +195,8 @@ public:
                      const Array <int>& audioChannelsToUse_,
                      const int totalChans_,
                      const int midiBufferToUse_,
-                     const Array <int> chans [PortType::Unknown])
+                     const Array <int> chans [PortType::Unknown],
+                     const int blockSize)
         : node (node_),
           processor (node_->getAudioPluginInstance()),
           audioChannelsToUse (audioChannelsToUse_),
@@ -222,15 +214,61 @@ public:
         if (chans[PortType::Midi].size() > 0)
             midiBufferToUse = chans[PortType::Midi].getFirst();
 
+        // buffer 0 is the shared, read-only empty buffer. unconnected inputs
+        // and nodes without MIDI get their own instead, since plugins may
+        // write to whatever they're handed and tasks can run concurrently
+        int numScratchChans = 0;
+        for (const auto index : audioChannelsToUse)
+            if (index == 0)
+                ++numScratchChans;
+        scratchAudio.setSize (jmax (1, numScratchChans), jmax (1, blockSize));
+        scratchMidi.ensureSize (2048);
+
+        midiBuffers.calloc ((size_t) jmax (1, midiChannelsToUse.size()));
+
         lastMute = node->isMuted();
+
+        // IO nodes read and write the parent graph's buffers, and device
+        // nodes share the MIDI engine, so these always run in order
+        serial = node->isAudioIONode() || node->isMidiIONode() || node->isMidiDeviceNode();
+    }
+
+    void collectBuffers (Array<int>& audio, Array<int>& midi) const override
+    {
+        // buffer 0 is never touched, see the scratch buffers
+        for (const auto index : audioChannelsToUse)
+            if (index != 0)
+                audio.add (index);
+        for (const auto index : midiChannelsToUse)
+            if (index != 0)
+                midi.add (index);
+        if (midiBufferToUse != 0)
+            midi.add (midiBufferToUse);
     }
 
+    bool isSerial() const override { return serial; }
+
     void perform (AudioSampleBuffer& sharedBufferChans, const OwnedArray <MidiBuffer>& sharedMidiBuffers, const int numSamples)
     {
-        for (int i = totalChans; --i >= 0;) {
-            channels[i] = sharedBufferChans.getWritePointer (audioChannelsToUse.getUnchecked (i), 0);
+        jassert (numSamples <= scratchAudio.getNumSamples());
+        for (int i = totalChans, scratch = 0; --i >= 0;)
+        {
+            const int index = audioChannelsToUse.getUnchecked (i);
+            if (index == 0)
+            {
+                channels[i] = scratchAudio.getWritePointer (scratch++);
+                FloatVectorOperations::clear (channels[i], numSamples);
+            }
+            else
+            {
+                channels[i] = sharedBufferChans.getWritePointer (index, 0);
+            }
         }
 
+        scratchMidi.clear();
+        auto& midi = midiBufferToUse != 0 ? *sharedMidiBuffers.getUnchecked (midiBufferToUse)
+                                          : scratchMidi;
+
         AudioSampleBuffer buffer (channels, totalChans, numSamples);
         
         if (! node->isEnabled())
@@ -270,61 +308,77 @@ public:
             buffer.applyGain (0, numSamples, node->getInputGain());
         }
 
-        for (int i = numAudioIns; --i >= 0;)
-            node->setInputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
+        auto* const meter = node->activeMeter.load (std::memory_order_acquire);
+        if (meter != nullptr && meter->isActive())
+            meter->measure (true, buffer, numSamples);
 
        #ifndef EL_FREE
         // Begin MIDI filters
         {
-            jassert (tempMidi.getNumEvents() == 0);
             ScopedLock spl (node->getPropertyLock());
-            transpose.setNoteOffset (node->getTransposeOffset());
+            const int noteOffset = node->getTransposeOffset();
             const auto keyRange (node->getKeyRange());
             const auto midiChans (node->getMidiChannels());
             const auto useMidiProgram (node->areMidiProgramsEnabled());
  
-            if (keyRange.getLength() > 0 || !midiChans.isOmni() || useMidiProgram)
+            const bool filtering = keyRange.getLength() > 0 || ! midiChans.isOmni()
+                || useMidiProgram || noteOffset != 0;
+
+            if (filtering && ! midi.isEmpty())
             {
-                auto& midi = *sharedMidiBuffers.getUnchecked (midiBufferToUse);
-                MidiBuffer::Iterator iter (midi);
-                int frame = 0; MidiMessage msg;
-                while (iter.getNextEvent (msg, frame))
+                if (midiStream.readFrom (midi))
                 {
-                    if (msg.isNoteOnOrOff())
+                    midiStream.removeIf ([&] (const MidiEventStream::Event& e)
                     {
-                        // out of range 
-                        if (keyRange.getLength() > 0 && (msg.getNoteNumber() < keyRange.getStart() || msg.getNoteNumber() > keyRange.getEnd()))
-                            continue;
-                    }
+                        // out of range
+                        if (keyRange.getLength() > 0 && e.isNoteOnOrOff()
+                            && (e.bytes[1] < keyRange.getStart() || e.bytes[1] > keyRange.getEnd()))
+                            return true;
 
-                    if (msg.getChannel() > 0 && midiChans.isOff (msg.getChannel()))
-                        continue;
+                        const int channel = e.getChannel();
+                        if (channel > 0 && midiChans.isOff (channel))
+                            return true;
 
-                    if (useMidiProgram && msg.isProgramChange())
+                        if (useMidiProgram && e.isProgramChange())
+                        {
+                            node->setMidiProgram (e.bytes[1]);
+                            node->reloadMidiProgram();
+                            return true;
+                        }
+
+                        return false;
+                    });
+
+                    if (noteOffset != 0)
                     {
-                        node->setMidiProgram (msg.getProgramChangeNumber());
-                        node->reloadMidiProgram();
-                        continue;
+                        midiStream.transform ([noteOffset] (MidiEventStream::Event& e)
+                        {
+                            if (e.isNoteOnOrOff())
+                                e.bytes[1] = (uint8) ((e.bytes[1] + noteOffset) & 127);
+                        });
                     }
 
-                    transpose.process (msg);
-                    tempMidi.addEvent (msg, frame);
+                    midiStream.writeTo (midi);
+                }
+                else
+                {
+                    // more than the stream holds, filter message by message
+                    filterMessages (midi, keyRange, midiChans, useMidiProgram, noteOffset);
                 }
-
-                midi.swapWith (tempMidi);
-            }
-            else
-            {
-                transpose.process (*sharedMidiBuffers.getUnchecked (midiBufferToUse), numSamples);
             }
         }
-        tempMidi.clear();
         // End MIDI filters
        #endif
         
         if (node->wantsMidiPipe())
         {
-            MidiPipe midiPipe (sharedMidiBuffers, midiChannelsToUse);
+            for (int i = 0; i < midiChannelsToUse.size(); ++i)
+            {
+                const int index = midiChannelsToUse.getUnchecked (i);
+                midiBuffers[i] = index != 0 ? sharedMidiBuffers.getUnchecked (index) : &scratchMidi;
+            }
+
+            MidiPipe midiPipe (midiBuffers.get(), midiChannelsToUse.size());
             if (! node->isSuspended())
                 node->render (buffer, midiPipe);
             else
@@ -332,31 +386,31 @@ public:
         }
         else
         {
-            auto pluginProcessBlock = [=, &sharedMidiBuffers] (AudioSampleBuffer& buffer, bool isSuspended)
+            auto pluginProcessBlock = [=, &midi] (AudioSampleBuffer& buffer, bool isSuspended)
             {
                 if (! isSuspended)
                 {
-                    processor->processBlock (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
+                    processor->processBlock (buffer, midi);
                 }
                 else
                 {
-                    processor->processBlockBypassed (buffer, *sharedMidiBuffers.getUnchecked (midiBufferToUse));
+                    processor->processBlockBypassed (buffer, midi);
                 }
             };
 
-            if (node->getOversamplingFactor() > 1)
+            if (auto* const osProcessor = node->getOversamplingProcessor())
             {
-                auto osProcessor = node->getOversamplingProcessor();
-
-                dsp::AudioBlock<float> block (buffer);
+                const int numChannels = jmin (buffer.getNumChannels(), node->osNumChannels);
+                dsp::AudioBlock<float> block (buffer.getArrayOfWritePointers(),
+                                              (size_t) numChannels, (size_t) numSamples);
                 dsp::AudioBlock<float> osBlock = osProcessor->processSamplesUp (block);
 
-                std::unique_ptr<float*> ptrArray;
-                ptrArray.reset (new float* [buffer.getNumChannels()]);
-                for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
-                    ptrArray.get()[ch] = osBlock.getChannelPointer (ch);
+                // channel pointers were allocated when the node was prepared
+                float** const osChannels = node->osChannels.get();
+                for (int ch = 0; ch < numChannels; ++ch)
+                    osChannels[ch] = osBlock.getChannelPointer ((size_t) ch);
 
-                AudioBuffer<float> osBuffer (ptrArray.get(), buffer.getNumChannels(), static_cast<int> (osBlock.getNumSamples()));
+                AudioBuffer<float> osBuffer (osChannels, numChannels, static_cast<int> (osBlock.getNumSamples()));
                 pluginProcessBlock (osBuffer, processor->isSuspended());
 
                 osProcessor->processSamplesDown (block);
@@ -398,8 +452,8 @@ public:
         node->updateGain();
         lastMute = muted;
 
-        for (int i = 0; i < numAudioOuts; ++i)
-            node->setOutputRMS (i, buffer.getRMSLevel (i, 0, numSamples));
+        if (meter != nullptr && meter->isActive())
+            meter->measure (false, buffer, numSamples);
     }
 
     const GraphNodePtr node;
@@ -412,37 +466,554 @@ private:
     int totalChans, numAudioIns, numAudioOuts;
     int midiBufferToUse;
     bool lastMute = false;
-    MidiTranspose transpose;
+    bool serial = false;
+    MidiEventStream midiStream;
     MidiBuffer tempMidi;
+    AudioSampleBuffer scratchAudio;
+    MidiBuffer scratchMidi;
+    HeapBlock<MidiBuffer*> midiBuffers;
+
+    void filterMessages (MidiBuffer& midi, Range<int> keyRange, const MidiChannels& midiChans,
+                         bool useMidiProgram, int noteOffset)
+    {
+        jassert (tempMidi.getNumEvents() == 0);
+        MidiBuffer::Iterator iter (midi);
+        int frame = 0; MidiMessage msg;
+        while (iter.getNextEvent (msg, frame))
+        {
+            // out of range
+            if (keyRange.getLength() > 0 && msg.isNoteOnOrOff()
+                && (msg.getNoteNumber() < keyRange.getStart() || msg.getNoteNumber() > keyRange.getEnd()))
+                continue;
+
+            if (msg.getChannel() > 0 && midiChans.isOff (msg.getChannel()))
+                continue;
+
+            if (useMidiProgram && msg.isProgramChange())
+            {
+                node->setMidiProgram (msg.getProgramChangeNumber());
+                node->reloadMidiProgram();
+                continue;
+            }
+
+            if (noteOffset != 0 && msg.isNoteOnOrOff())
+                msg.setNoteNumber ((msg.getNoteNumber() + noteOffset) & 127);
+
+            tempMidi.addEvent (msg, frame);
+        }
+
+        midi.swapWith (tempMidi);
+        tempMidi.clear();
+    }
+
     JUCE_DECLARE_NON_COPYABLE (ProcessBufferOp)
 };
 
 
+/** A block of memory tasks are constructed in. Programs which re-use
+    tasks from a previous program hold on to its arenas too */
+class OpArena : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<OpArena>;
+
+    explicit OpArena (const size_t capacity_)
+        : capacity (capacity_)
+    {
+        block.malloc (capacity);
+    }
+
+    /** Returns nullptr when there isn't enough room left */
+    void* allocate (size_t numBytes) noexcept
+    {
+        numBytes = (numBytes + alignment - 1) & ~(alignment - 1);
+        if (used + numBytes > capacity)
+            return nullptr;
+        void* const ptr = block.get() + used;
+        used += numBytes;
+        return ptr;
+    }
+
+    bool contains (const void* const ptr) const noexcept
+    {
+        const char* const p = static_cast<const char*> (ptr);
+        return p >= block.get() && p < block.get() + used;
+    }
+
+private:
+    static constexpr size_t alignment = 16;
+    HeapBlock<char> block;
+    const size_t capacity;
+    size_t used = 0;
+};
+
+/** The parts of a node which decide what ops get built for it */
+struct NodeSignature
+{
+    NodeSignature() = default;
+    NodeSignature (const GraphNode& node)
+        : numPorts (node.getNumPorts()),
+          audioIns (node.getNumPorts (PortType::Audio, true)),
+          audioOuts (node.getNumPorts (PortType::Audio, false)),
+          midiIns (node.getNumPorts (PortType::Midi, true)),
+          midiOuts (node.getNumPorts (PortType::Midi, false)),
+          latency (node.getLatencySamples())
+    { }
+
+    bool operator== (const NodeSignature& o) const noexcept
+    {
+        return numPorts == o.numPorts && audioIns == o.audioIns && audioOuts == o.audioOuts
+            && midiIns == o.midiIns && midiOuts == o.midiOuts && latency == o.latency;
+    }
+
+    bool operator!= (const NodeSignature& o) const noexcept { return ! operator== (o); }
+
+    uint32 numPorts = 0;
+    int audioIns = 0, audioOuts = 0, midiIns = 0, midiOuts = 0;
+    int latency = 0;
+};
+
+struct ConnectionKey
+{
+    uint32 sourceNode, sourcePort, destNode, destPort;
+
+    bool operator< (const ConnectionKey& o) const noexcept
+    {
+        if (sourceNode != o.sourceNode) return sourceNode < o.sourceNode;
+        if (sourcePort != o.sourcePort) return sourcePort < o.sourcePort;
+        if (destNode != o.destNode)     return destNode < o.destNode;
+        return destPort < o.destPort;
+    }
+
+    bool operator== (const ConnectionKey& o) const noexcept
+    {
+        return sourceNode == o.sourceNode && sourcePort == o.sourcePort
+            && destNode == o.destNode && destPort == o.destPort;
+    }
+};
+
+/** Everything the audio thread needs to render a graph.  A program is built
+    off of the audio thread, published as a whole, and never modified while
+    it might be in use. */
+class Program
+{
+public:
+    /** What the builder knew at the start of each node's ops, so the next
+        build can pick up from the first node that changed */
+    struct Step
+    {
+        const GraphNode* node = nullptr;
+        NodeSignature signature;
+        int firstOp = 0;
+        int delay = 0;
+        int totalLatency = 0;
+        Array<uint32> bufferNodes [PortType::Unknown];
+        Array<uint32> bufferPorts [PortType::Unknown];
+    };
+
+    Program() = default;
+
+    ~Program()
+    {
+        for (int i = objects.size(); --i >= firstOwnedObject;)
+            objects.getUnchecked(i)->~Task();
+        objects.clearQuick();
+    }
+
+    void add (const Op& op)
+    {
+        ops.add (op);
+    }
+
+    template<class TaskType, typename... Args>
+    void addTask (Args&&... args)
+    {
+        Task* const task = new (allocate (sizeof (TaskType))) TaskType (std::forward<Args> (args)...);
+        objects.add (task);
+        ops.add (Op::perform (task));
+    }
+
+    /** Takes over the first numOps ops of a previous program, along with
+        whatever state their tasks carry (delay lines, mute ramps...) */
+    void adoptOps (Program& previous, const int numOps)
+    {
+        jassert (ops.isEmpty() && previous.firstOwnedObject == 0);
+        ops.addArray (previous.ops, 0, numOps);
+
+        int numObjects = 0;
+        for (const auto& op : ops)
+            if (op.task != nullptr)
+                ++numObjects;
+
+        // tasks are created in op order, so these are the first ones
+        objects.addArray (previous.objects, 0, numObjects);
+        previous.firstOwnedObject = numObjects;
+
+        for (auto* arena : previous.arenas)
+        {
+            for (int i = 0; i < numObjects; ++i)
+            {
+                if (arena->contains (objects.getUnchecked (i)))
+                {
+                    arenas.add (arena);
+                    break;
+                }
+            }
+        }
+    }
+
+    /** Turns the ops of each task into the code which is run, merging
+        neighbouring ops that write the same channel into single passes */
+    void compile()
+    {
+        code.clearQuick();
+        codeOffsets.clearQuick();
+        channelTable.clearQuick();
+        code.ensureStorageAllocated (ops.size());
+
+        for (int task = 0; task + 1 < taskOffsets.size(); ++task)
+        {
+            codeOffsets.add (code.size());
+            const int end = taskOffsets.getUnchecked (task + 1);
+
+            for (int i = taskOffsets.getUnchecked (task); i < end;)
+            {
+                const Op& op = ops.getReference (i);
+
+                if (op.code == Op::clearChannel || op.code == Op::copyChannel || op.code == Op::addChannel)
+                {
+                    int last = i + 1;
+                    while (last < end && ops.getReference(last).code == Op::addChannel
+                           && ops.getReference(last).dest == op.dest
+                           && ops.getReference(last).source != op.dest)
+                        ++last;
+
+                    if (last > i + 1)
+                    {
+                        Op mix = { Op::mixChannels, op.code == Op::addChannel, 0, op.dest,
+                                   channelTable.size(), 0, nullptr };
+                        if (op.code != Op::clearChannel)
+                            channelTable.add (op.source);
+                        for (int j = i + 1; j < last; ++j)
+                            channelTable.add (ops.getReference(j).source);
+                        mix.count = channelTable.size() - mix.index;
+                        code.add (mix);
+                        i = last;
+                        continue;
+                    }
+                }
+
+                if (op.code == Op::clearChannel)
+                {
+                    int last = i + 1;
+                    while (last < end && ops.getReference(last).code == Op::clearChannel)
+                        ++last;
+
+                    if (last > i + 1)
+                    {
+                        Op clear = { Op::clearChannels, false, 0, 0, channelTable.size(), last - i, nullptr };
+                        for (int j = i; j < last; ++j)
+                            channelTable.add (ops.getReference(j).dest);
+                        code.add (clear);
+                        i = last;
+                        continue;
+                    }
+                }
+
+                code.add (op);
+                ++i;
+            }
+        }
+
+        codeOffsets.add (code.size());
+    }
+
+    /** Sets up the shared buffers. Audio memory comes from the pool and
+        is sized for blocks of up to blockSize samples */
+    void allocateBuffers (RenderBufferPool& pool, const int numAudio,
+                          const int numMidi, const int blockSize)
+    {
+        audioMemory = pool.allocate (numAudio, blockSize);
+        audio.setDataToReferTo (audioMemory->getChannels(), audioMemory->getNumChannels(),
+                                audioMemory->getNumSamples());
+        audio.clear();
+
+        while (midi.size() < numMidi)
+            midi.add (new MidiBuffer())->ensureSize (midiBufferSize);
+    }
+
+    /** Returns the largest block which can be rendered in one go */
+    int getBlockSize() const noexcept { return audio.getNumSamples(); }
+
+    void render (RenderThreadPool* pool, const int numSamples)
+    {
+        jassert (numSamples <= getBlockSize());
+        if (pool != nullptr && tasks.isWorthRunningInParallel())
+        {
+            Runner runner (*this, numSamples);
+            if (pool->run (runner, tasks))
+                return;
+        }
+
+        run (0, code.size(), numSamples);
+    }
+
+    Array<Op> ops;
+    Array<int> taskOffsets;
+    RenderThreadPool::TaskGraph tasks;
+    AudioSampleBuffer audio;
+    OwnedArray<MidiBuffer> midi;
+
+    OwnedArray<Step> steps;
+    Array<ConnectionKey> connections;
+
+private:
+    /** Runs the code of one node per task on a RenderThreadPool */
+    struct Runner : public RenderThreadPool::Job
+    {
+        Runner (Program& p, const int n) noexcept : program (p), numSamples (n) { }
+
+        void runTask (const int task) override
+        {
+            program.run (program.codeOffsets.getUnchecked (task),
+                         program.codeOffsets.getUnchecked (task + 1),
+                         numSamples);
+        }
+
+        Program& program;
+        const int numSamples;
+    };
+
+    Array<Op> code;
+    Array<int> codeOffsets;
+    Array<int> channelTable;
+    std::unique_ptr<RenderBufferPool::Buffer> audioMemory;
+    enum { midiBufferSize = 2048 };
+
+    enum { arenaSize = 32 * 1024 };
+    ReferenceCountedArray<OpArena> arenas;
+    OpArena* currentArena = nullptr;
+    Array<Task*> objects;
+    int firstOwnedObject = 0;
+
+    void run (const int first, const int last, const int numSamples) noexcept
+    {
+        const int* const table = channelTable.begin();
+
+        for (int i = first; i < last; ++i)
+        {
+            const Op& op = code.getReference (i);
+            switch (op.code)
+            {
+                case Op::clearChannel:
+                    FloatVectorOperations::clear (audio.getWritePointer (op.dest), numSamples);
+                    break;
+                case Op::copyChannel:
+                    FloatVectorOperations::copy (audio.getWritePointer (op.dest),
+                                                 audio.getReadPointer (op.source), numSamples);
+                    break;
+                case Op::addChannel:
+                    FloatVectorOperations::add (audio.getWritePointer (op.dest),
+                                                audio.getReadPointer (op.source), numSamples);
+                    break;
+                case Op::clearChannels:
+                    for (int c = 0; c < op.count; ++c)
+                        FloatVectorOperations::clear (audio.getWritePointer (table [op.index + c]), numSamples);
+                    break;
+                case Op::mixChannels:
+                    mix (op, table + op.index, numSamples);
+                    break;
+                case Op::clearMidi:
+                    midi.getUnchecked (op.dest)->clear();
+                    break;
+                case Op::copyMidi:
+                    *midi.getUnchecked (op.dest) = *midi.getUnchecked (op.source);
+                    break;
+                case Op::addMidi:
+                    midi.getUnchecked (op.dest)->addEvents (*midi.getUnchecked (op.source), 0, numSamples, 0);
+                    break;
+                case Op::performTask:
+                    op.task->perform (audio, midi, numSamples);
+                    break;
+            }
+        }
+    }
+
+    /** Sums a run of channels into one. When the destination starts over,
+        the first two sources are added in a single pass */
+    void mix (const Op& op, const int* const channels, const int numSamples) noexcept
+    {
+        float* const dest = audio.getWritePointer (op.dest);
+        int i = 0;
+
+        if (! op.accumulate)
+        {
+            if (op.count >= 2)
+            {
+                FloatVectorOperations::add (dest, audio.getReadPointer (channels[0]),
+                                                  audio.getReadPointer (channels[1]), numSamples);
+                i = 2;
+            }
+            else
+            {
+                FloatVectorOperations::copy (dest, audio.getReadPointer (channels[0]), numSamples);
+                i = 1;
+            }
+        }
+
+        for (; i < op.count; ++i)
+            FloatVectorOperations::add (dest, audio.getReadPointer (channels[i]), numSamples);
+    }
+
+    void* allocate (const size_t numBytes)
+    {
+        void* ptr = currentArena != nullptr ? currentArena->allocate (numBytes) : nullptr;
+        if (ptr == nullptr)
+        {
+            currentArena = arenas.add (new OpArena (jmax ((size_t) arenaSize, numBytes)));
+            ptr = currentArena->allocate (numBytes);
+        }
+
+        jassert (ptr != nullptr);
+        return ptr;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Program)
+};
+
+/** Orders nodes so each comes after the nodes feeding it, using Kahn's
+    algorithm. Ties go to the node added first, and feedback loops are
+    broken at the earliest added node in the loop. */
+static void sortNodes (const GraphProcessor& graph, Array<GraphNode*>& ordered)
+{
+    const int numNodes = graph.getNumNodes();
+    HashMap<int64, int> indexes (jmax (101, numNodes * 2));
+    for (int i = 0; i < numNodes; ++i)
+        indexes.set (static_cast<int64> (graph.getNode(i)->nodeId), i);
+
+    Array<int64> edges;
+    for (int i = 0; i < graph.getNumConnections(); ++i)
+    {
+        const auto* const c = graph.getConnection (i);
+        const int64 sourceKey = static_cast<int64> (c->sourceNode);
+        const int64 destKey   = static_cast<int64> (c->destNode);
+        if (! indexes.contains (sourceKey) || ! indexes.contains (destKey))
+            continue;
+        const int source = indexes [sourceKey];
+        const int dest   = indexes [destKey];
+        if (source != dest)
+            edges.add ((static_cast<int64> (source) << 32) | static_cast<int64> (dest));
+    }
+
+    edges.sort();
+
+    Array<int> numInputs, dependentsStart, dependents;
+    numInputs.insertMultiple (0, 0, numNodes);
+    dependentsStart.insertMultiple (0, 0, numNodes + 1);
+    dependents.ensureStorageAllocated (edges.size());
+    for (const auto edge : edges)
+    {
+        const int source = static_cast<int> (edge >> 32);
+        const int dest   = static_cast<int> (edge & 0xffffffff);
+        dependents.add (dest);
+        dependentsStart.getReference (source + 1) += 1;
+        numInputs.getReference (dest) += 1;
+    }
+
+    for (int i = 1; i <= numNodes; ++i)
+        dependentsStart.getReference (i) += dependentsStart.getUnchecked (i - 1);
+
+    SortedSet<int> ready;
+    Array<bool> visited;
+    visited.insertMultiple (0, false, numNodes);
+    for (int i = 0; i < numNodes; ++i)
+        if (numInputs.getUnchecked (i) == 0)
+            ready.add (i);
+
+    ordered.ensureStorageAllocated (ordered.size() + numNodes);
+    int nextUnvisited = 0;
+    for (int numVisited = 0; numVisited < numNodes; ++numVisited)
+    {
+        int index = -1;
+        if (ready.size() > 0)
+        {
+            index = ready.getFirst();
+            ready.remove (0);
+        }
+        else
+        {
+            // only feedback loops are left
+            while (visited.getUnchecked (nextUnvisited))
+                ++nextUnvisited;
+            index = nextUnvisited;
+        }
+
+        visited.set (index, true);
+        ordered.add (graph.getNode (index));
+
+        for (int i = dependentsStart.getUnchecked (index); i < dependentsStart.getUnchecked (index + 1); ++i)
+        {
+            const int dependent = dependents.getUnchecked (i);
+            auto& count = numInputs.getReference (dependent);
+            if (--count == 0 && ! visited.getUnchecked (dependent))
+                ready.add (dependent);
+        }
+    }
+}
+
 /** Used to calculate the correct sequence of rendering ops needed, based on
-    the best re-use of shared buffers at each stage. */
+    the best re-use of shared buffers at each stage.
+
+    When given the previous program, ops for the nodes ahead of the first
+    one affected by a change are taken over instead of being built again. */
 class ProcessorGraphBuilder
 {
 public:
-    ProcessorGraphBuilder (GraphProcessor& graph_, 
-                           const Array<void*>& orderedNodes_,
-                           Array<void*>& renderingOps)
+    ProcessorGraphBuilder (GraphProcessor& graph_,
+                           const Array<GraphNode*>& orderedNodes_,
+                           Program& program_,
+                           Program* const previous)
         : graph (graph_),
           orderedNodes (orderedNodes_),
+          program (program_),
           totalLatency (0)
     {
-        for (int i = 0; i < PortType::Unknown; ++i)
+        indexConnections();
+        nodeDelays.insertMultiple (0, 0, orderedNodes.size());
+
+        int step = previous != nullptr ? resumeFrom (*previous) : 0;
+        if (step == 0)
         {
-            allNodes[i].add ((uint32) zeroNodeID);  // first buffer is read-only zeros
-            allPorts[i].add (KV_INVALID_PORT);
+            for (int i = 0; i < PortType::Unknown; ++i)
+            {
+                allNodes[i].add ((uint32) zeroNodeID);  // first buffer is read-only zeros
+                allPorts[i].add (KV_INVALID_PORT);
+            }
         }
 
-        for (int i = 0; i < orderedNodes.size(); ++i)
+        const int numStepsReused = step;
+
+        for (; step < orderedNodes.size(); ++step)
         {
-            createRenderingOpsForNode ((GraphNode*) orderedNodes.getUnchecked (i),
-                                       renderingOps, i);
-            markUnusedBuffersFree (i);
+            GraphNode* const node = orderedNodes.getUnchecked (step);
+            saveStep (node);
+            createRenderingOpsForNode (node, step);
+            markUnusedBuffersFree (step);
         }
 
+        saveStep (nullptr);
+
+        for (int i = numStepsReused; i < orderedNodes.size(); ++i)
+            program.steps.getUnchecked(i)->delay = nodeDelays.getUnchecked (i);
+
+        for (int i = 0; i < orderedNodes.size(); ++i)
+            if (program.steps.getUnchecked (i + 1)->firstOp > program.steps.getUnchecked (i)->firstOp)
+                program.taskOffsets.add (program.steps.getUnchecked(i)->firstOp);
+        program.taskOffsets.add (program.ops.size());
+
+        buildTaskGraph (program.ops, program.taskOffsets, program.tasks);
+        program.compile();
+
         graph.setLatencySamples (totalLatency);
     }
 
@@ -451,7 +1022,8 @@ public:
 private:
     //==============================================================================
     GraphProcessor& graph;
-    const Array<void*>& orderedNodes;
+    const Array<GraphNode*>& orderedNodes;
+    Program& program;
     Array <uint32> allNodes [PortType::Unknown];
     Array <uint32> allPorts [PortType::Unknown];
 
@@ -459,43 +1031,195 @@ private:
 
     static bool isNodeBusy (uint32 nodeID) noexcept { return nodeID != freeNodeID && nodeID != zeroNodeID; }
 
-    Array <uint32> nodeDelayIDs;
     Array <int> nodeDelays;
     int totalLatency;
 
-    int getNodeDelay (const uint32 nodeID) const          { return nodeDelays [nodeDelayIDs.indexOf (nodeID)]; }
+    // connections indexed by the step of their destination, and the nodes
+    // reading each output sorted by step
+    struct Consumer
+    {
+        int64 source;
+        int step;
+        uint32 port;
+    };
+
+    HashMap<int64, int> nodeSteps;
+    HashMap<int64, Range<int>> consumerRanges;
+    Array<Consumer> consumers;
+    Array<const GraphProcessor::Connection*> incoming;
+    Array<int> incomingStart;
+
+    static int64 outputKey (const uint32 nodeId, const uint32 port) noexcept
+    {
+        return static_cast<int64> ((static_cast<uint64> (nodeId) << 32) | port);
+    }
+
+    int getStep (const uint32 nodeId) const
+    {
+        const int64 key = static_cast<int64> (nodeId);
+        return nodeSteps.contains (key) ? nodeSteps [key] : -1;
+    }
 
-    void setNodeDelay (const uint32 nodeID, const int latency)
+    void indexConnections()
     {
-        const int index = nodeDelayIDs.indexOf (nodeID);
+        const int numSteps = orderedNodes.size();
+        nodeSteps.remapTable (jmax (101, numSteps * 2));
+        for (int i = 0; i < numSteps; ++i)
+            nodeSteps.set (static_cast<int64> (orderedNodes.getUnchecked(i)->nodeId), i);
+
+        incomingStart.insertMultiple (0, 0, numSteps + 1);
+        program.connections.ensureStorageAllocated (graph.getNumConnections());
 
-        if (index >= 0)
+        for (int i = graph.getNumConnections(); --i >= 0;)
         {
-            nodeDelays.set (index, latency);
+            const auto* const c = graph.getConnection (i);
+            program.connections.add ({ c->sourceNode, c->sourcePort, c->destNode, c->destPort });
+
+            const int step = getStep (c->destNode);
+            if (step < 0)
+                continue;
+            incomingStart.getReference (step + 1) += 1;
+            consumers.add ({ outputKey (c->sourceNode, c->sourcePort), step, c->destPort });
         }
-        else
+
+        for (int i = 1; i <= numSteps; ++i)
+            incomingStart.getReference (i) += incomingStart.getUnchecked (i - 1);
+
+        // filled in the same order the connections were searched before
+        Array<int> fill (incomingStart);
+        incoming.insertMultiple (0, nullptr, incomingStart.getLast());
+        for (int i = graph.getNumConnections(); --i >= 0;)
+        {
+            const auto* const c = graph.getConnection (i);
+            const int step = getStep (c->destNode);
+            if (step >= 0)
+                incoming.set (fill.getReference (step)++, c);
+        }
+
+        std::sort (program.connections.begin(), program.connections.end());
+        std::sort (consumers.begin(), consumers.end(), [] (const Consumer& a, const Consumer& b) {
+            return a.source != b.source ? a.source < b.source : a.step < b.step;
+        });
+
+        consumerRanges.remapTable (jmax (101, consumers.size()));
+        for (int i = 0; i < consumers.size();)
         {
-            nodeDelayIDs.add (nodeID);
-            nodeDelays.add (latency);
+            const int64 source = consumers.getReference(i).source;
+            int end = i + 1;
+            while (end < consumers.size() && consumers.getReference(end).source == source)
+                ++end;
+            consumerRanges.set (source, { i, end });
+            i = end;
         }
     }
 
-    int getInputLatency (const uint32 nodeID) const
+    /** Restores the builder to where the previous program diverges from this
+        one and adopts the ops before that point. Returns the step to
+        continue building from */
+    int resumeFrom (Program& previous)
     {
-        int maxLatency = 0;
+        // both ends of any connection added or removed since the last build
+        SortedSet<uint32> changed;
+        const auto& oldConnections = previous.connections;
+        const auto& newConnections = program.connections;
+        for (int i = 0, j = 0; i < oldConnections.size() || j < newConnections.size();)
+        {
+            if (j >= newConnections.size()
+                || (i < oldConnections.size() && oldConnections.getReference(i) < newConnections.getReference(j)))
+            {
+                changed.add (oldConnections.getReference(i).sourceNode);
+                changed.add (oldConnections.getReference(i).destNode);
+                ++i;
+            }
+            else if (i >= oldConnections.size() || newConnections.getReference(j) < oldConnections.getReference(i))
+            {
+                changed.add (newConnections.getReference(j).sourceNode);
+                changed.add (newConnections.getReference(j).destNode);
+                ++j;
+            }
+            else
+            {
+                ++i; ++j;
+            }
+        }
 
-        for (int i = graph.getNumConnections(); --i >= 0;)
+        const int limit = jmin (previous.steps.size() - 1, orderedNodes.size());
+        int step = 0;
+        for (; step < limit; ++step)
         {
-            const auto* const c = graph.getConnection (i);
-            if (c->destNode == nodeID)
-                maxLatency = jmax (maxLatency, getNodeDelay (c->sourceNode));
+            const auto* const saved = previous.steps.getUnchecked (step);
+            const GraphNode* const node = orderedNodes.getUnchecked (step);
+            if (saved->node != node || changed.contains (node->nodeId)
+                || saved->signature != NodeSignature (*node))
+                break;
+        }
+
+        if (step <= 0)
+            return 0;
+
+        const auto* const resume = previous.steps.getUnchecked (step);
+        for (int i = 0; i < PortType::Unknown; ++i)
+        {
+            allNodes[i] = resume->bufferNodes[i];
+            allPorts[i] = resume->bufferPorts[i];
+        }
+
+        totalLatency = resume->totalLatency;
+
+        for (int i = 0; i < step; ++i)
+        {
+            const auto* const saved = previous.steps.getUnchecked (i);
+            nodeDelays.set (i, saved->delay);
+            program.steps.add (new Program::Step (*saved));
+        }
+
+        program.adoptOps (previous, resume->firstOp);
+        return step;
+    }
+
+    void saveStep (const GraphNode* const node)
+    {
+        auto* const step = program.steps.add (new Program::Step());
+        if (node != nullptr)
+        {
+            step->node = node;
+            step->signature = NodeSignature (*node);
+        }
+
+        step->firstOp = program.ops.size();
+        step->totalLatency = totalLatency;
+        for (int i = 0; i < PortType::Unknown; ++i)
+        {
+            step->bufferNodes[i] = allNodes[i];
+            step->bufferPorts[i] = allPorts[i];
         }
+    }
+
+    int getNodeDelay (const uint32 nodeID) const          { return nodeDelays [getStep (nodeID)]; }
+
+    int getInputLatency (const int step) const
+    {
+        int maxLatency = 0;
+
+        for (int i = incomingStart.getUnchecked (step); i < incomingStart.getUnchecked (step + 1); ++i)
+            maxLatency = jmax (maxLatency, getNodeDelay (incoming.getUnchecked(i)->sourceNode));
 
         return maxLatency;
     }
 
-    void createRenderingOpsForNode (GraphNode* const node, Array<void*>& renderingOps,
-                                    const int ourRenderingIndex)
+    /** Compensates a buffer arriving 'numSamples' earlier than the node's other inputs */
+    void addDelay (PortType type, const int buffer, const int numSamples)
+    {
+        if (numSamples <= 0)
+            return;
+
+        if (type == PortType::Audio)
+            program.addTask<DelayChannelOp> (buffer, numSamples);
+        else if (type == PortType::Midi)
+            program.addTask<DelayMidiOp> (buffer, numSamples, graph.getBlockSize());
+    }
+
+    void createRenderingOpsForNode (GraphNode* const node, const int ourRenderingIndex)
     {
         AudioProcessor* const proc (node->getAudioProcessor());
 
@@ -512,7 +1236,7 @@ private:
         }
         
         Array <int> channelsToUse [PortType::Unknown];
-        int maxLatency = getInputLatency (node->nodeId);
+        int maxLatency = getInputLatency (ourRenderingIndex);
 
         const uint32 numPorts (node->getNumPorts());
         for (uint32 port = 0; port < numPorts; ++port)
@@ -551,11 +1275,12 @@ private:
             // get a list of all the inputs to this node
             Array <uint32> sourceNodes;
             Array <uint32> sourcePorts;
-            for (int i = graph.getNumConnections(); --i >= 0;)
+            for (int i = incomingStart.getUnchecked (ourRenderingIndex);
+                 i < incomingStart.getUnchecked (ourRenderingIndex + 1); ++i)
             {
-                const GraphProcessor::Connection* const c = graph.getConnection (i);
+                const GraphProcessor::Connection* const c = incoming.getUnchecked (i);
 
-                if (c->destNode == node->nodeId && c->destPort == port)
+                if (c->destPort == port)
                 {
                     sourceNodes.add (c->sourceNode);
                     sourcePorts.add (c->sourcePort);
@@ -577,10 +1302,10 @@ private:
                     switch (portType.id())
                     {
                         case PortType::Audio:
-                            renderingOps.add (new ClearChannelOp (bufIndex));
+                            program.add (Op::clearAudio (bufIndex));
                             break;
                         case PortType::Midi:
-                            renderingOps.add (new ClearMidiBufferOp (bufIndex));
+                            program.add (Op::clearMidiBuffer (bufIndex));
                             break;
                         default:
                             break;
@@ -594,6 +1319,7 @@ private:
                 const uint32 srcPort = sourcePorts.getUnchecked (0);
 
                 bufIndex = getBufferContaining (portType, srcNode, srcPort);
+                const int delay = bufIndex >= 0 ? maxLatency - getNodeDelay (srcNode) : 0;
 
                 if (bufIndex < 0)
                 {
@@ -603,7 +1329,7 @@ private:
                 }
                 
                 const bool bufNeededLater = isBufferNeededLater (ourRenderingIndex, port, srcNode, srcPort);
-                if (bufNeededLater && (inputChan < (int) numOuts || portType == PortType::Midi))
+                if (bufNeededLater && (delay > 0 || inputChan < (int) numOuts || portType == PortType::Midi))
                 {
                     // can't mess up this channel because it's needed later by another node, so we
                     // need to use a copy of it..
@@ -612,10 +1338,10 @@ private:
                     switch (portType.id())
                     {
                         case PortType::Audio:
-                            renderingOps.add (new CopyChannelOp (bufIndex, newFreeBuffer));
+                            program.add (Op::copyAudio (bufIndex, newFreeBuffer));
                             break;
                         case PortType::Midi:
-                            renderingOps.add (new CopyMidiBufferOp (bufIndex, newFreeBuffer));
+                            program.add (Op::copyMidiBuffer (bufIndex, newFreeBuffer));
                             break;
                         default:
                             break;
@@ -624,10 +1350,7 @@ private:
                     bufIndex = newFreeBuffer;
                 }
 
-                const int nodeDelay = getNodeDelay (srcNode);
-
-                if (nodeDelay < maxLatency)
-                    renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
+                addDelay (portType, bufIndex, delay);
             }
             else
             {
@@ -649,14 +1372,7 @@ private:
                         // we've found one of our input chans that can be re-used..
                         reusableInputIndex = i;
                         bufIndex = sourceBufIndex;
-
-                        if (portType == PortType::Audio)
-                        {
-                            const int nodeDelay = getNodeDelay (sourceNodes.getUnchecked (i));
-                            if (nodeDelay < maxLatency)
-                                renderingOps.add (new DelayChannelOp (sourceBufIndex, maxLatency - nodeDelay));
-                        }
-
+                        addDelay (portType, sourceBufIndex, maxLatency - getNodeDelay (sourceNodes.getUnchecked (i)));
                         break;
                     }
                 }
@@ -675,26 +1391,20 @@ private:
                     {
                         // if not found, this is probably a feedback loop
                         if (portType == PortType::Audio)
-                            renderingOps.add (new ClearChannelOp (bufIndex));
+                            program.add (Op::clearAudio (bufIndex));
                         else if (portType == PortType::Midi)
-                            renderingOps.add (new ClearMidiBufferOp (bufIndex));
+                            program.add (Op::clearMidiBuffer (bufIndex));
                     }
                     else
                     {
                         if (portType == PortType::Audio)
-                            renderingOps.add (new CopyChannelOp (srcIndex, bufIndex));
+                            program.add (Op::copyAudio (srcIndex, bufIndex));
                         else if (portType == PortType::Midi)
-                            renderingOps.add (new CopyMidiBufferOp (srcIndex, bufIndex));
+                            program.add (Op::copyMidiBuffer (srcIndex, bufIndex));
                     }
 
                     reusableInputIndex = 0;
-
-                    if (portType == PortType::Audio)
-                    {
-                        const int nodeDelay = getNodeDelay (sourceNodes.getFirst());
-                        if (nodeDelay < maxLatency)
-                            renderingOps.add (new DelayChannelOp (bufIndex, maxLatency - nodeDelay));
-                    }
+                    addDelay (portType, bufIndex, maxLatency - getNodeDelay (sourceNodes.getFirst()));
                 }
 
                 for (int j = 0; j < sourceNodes.size(); ++j)
@@ -705,33 +1415,29 @@ private:
                                                                       sourcePorts.getUnchecked(j));
                         if (srcIndex >= 0)
                         {
-                            if (portType == PortType::Audio)
-                            {
-                                const int nodeDelay = getNodeDelay (sourceNodes.getUnchecked (j));
+                            const bool isAudio = portType == PortType::Audio;
+                            const int delay = maxLatency - getNodeDelay (sourceNodes.getUnchecked (j));
 
-                                if (nodeDelay < maxLatency)
+                            if (delay > 0)
+                            {
+                                if (! isBufferNeededLater (ourRenderingIndex, port,
+                                                           sourceNodes.getUnchecked(j),
+                                                           sourcePorts.getUnchecked(j)))
                                 {
-                                    if (! isBufferNeededLater (ourRenderingIndex, port,
-                                                               sourceNodes.getUnchecked(j),
-                                                               sourcePorts.getUnchecked(j)))
-                                    {
-                                        renderingOps.add (new DelayChannelOp (srcIndex, maxLatency - nodeDelay));
-                                    }
-                                    else // buffer is reused elsewhere, can't be delayed
-                                    {
-                                        const int bufferToDelay = getFreeBuffer (PortType::Audio);
-                                        renderingOps.add (new CopyChannelOp (srcIndex, bufferToDelay));
-                                        renderingOps.add (new DelayChannelOp (bufferToDelay, maxLatency - nodeDelay));
-                                        srcIndex = bufferToDelay;
-                                    }
+                                    addDelay (portType, srcIndex, delay);
+                                }
+                                else // buffer is reused elsewhere, can't be delayed
+                                {
+                                    const int bufferToDelay = getFreeBuffer (portType);
+                                    program.add (isAudio ? Op::copyAudio (srcIndex, bufferToDelay)
+                                                         : Op::copyMidiBuffer (srcIndex, bufferToDelay));
+                                    addDelay (portType, bufferToDelay, delay);
+                                    srcIndex = bufferToDelay;
                                 }
-
-                                renderingOps.add (new AddChannelOp (srcIndex, bufIndex));
-                            }
-                            else if (portType == PortType::Midi)
-                            {
-                                renderingOps.add (new AddMidiBufferOp (srcIndex, bufIndex));
                             }
+
+                            program.add (isAudio ? Op::addAudio (srcIndex, bufIndex)
+                                                 : Op::addMidiBuffer (srcIndex, bufIndex));
                         }
                     }
                 }
@@ -747,15 +1453,16 @@ private:
             }
         } /* foreach port */
 
-        setNodeDelay (node->nodeId, maxLatency + node->getLatencySamples());
+        nodeDelays.set (ourRenderingIndex, maxLatency + node->getLatencySamples());
         
         if (node->isAudioIONode() && node->getNumPorts (PortType::Audio, false) == 0)
             totalLatency = maxLatency;
 
         int totalChans = jmax (node->getNumPorts (PortType::Audio, true),
                                node->getNumPorts (PortType::Audio, false));
-        renderingOps.add (new ProcessBufferOp (node, channelsToUse [PortType::Audio],
-                                               totalChans, 0, channelsToUse));
+        program.addTask<ProcessBufferOp> (GraphNodePtr (node), channelsToUse [PortType::Audio],
+                                        totalChans, 0, channelsToUse,
+                                        graph.getBlockSize() > 0 ? graph.getBlockSize() : 1024);
     }
 
     int getFreeBuffer (PortType type)
@@ -812,23 +1519,19 @@ private:
     bool isBufferNeededLater (int stepIndexToSearchFrom, uint32 inputChannelOfIndexToIgnore,
                               const uint32 sourceNode, const uint32 outputPortIndex) const
     {
-        while (stepIndexToSearchFrom < orderedNodes.size())
-        {
-            const GraphNode* const node = (const GraphNode*) orderedNodes.getUnchecked (stepIndexToSearchFrom);
-
-            {
-                for (uint32 port = 0; port < node->getNumPorts(); ++port)
-                {
-                    if (port != inputChannelOfIndexToIgnore &&
-                          graph.getConnectionBetween (sourceNode, outputPortIndex, node->nodeId, port) != nullptr)
-                    {
-                        return true;
-                    }
-                }
-            }
+        const int64 key = outputKey (sourceNode, outputPortIndex);
+        if (! consumerRanges.contains (key))
+            return false;
 
-            inputChannelOfIndexToIgnore = KV_INVALID_PORT;
-            ++stepIndexToSearchFrom;
+        // consumers are sorted by step, so only the last few need checking
+        const auto range = consumerRanges [key];
+        for (int i = range.getEnd(); --i >= range.getStart();)
+        {
+            const auto& consumer = consumers.getReference (i);
+            if (consumer.step < stepIndexToSearchFrom)
+                break;
+            if (consumer.step > stepIndexToSearchFrom || consumer.port != inputChannelOfIndexToIgnore)
+                return true;
         }
 
         return false;
@@ -844,11 +1547,194 @@ private:
         ports.set (bufferNum, portIndex);
     }
 
+    /** Who last wrote a shared buffer, and which tasks read it since */
+    struct BufferUse
+    {
+        int writer = -1;
+        Array<int> readers;
+    };
+
+    /** Each task is one node's ops.  A task reading a shared buffer depends
+        on the last task which wrote it. A task writing one also depends on
+        every task which read it since, which covers buffer re-use.  Tasks
+        only reading the same buffer, like branches fanning out from one
+        source, can run concurrently.  Mixing happens inside the consuming
+        node's task in a fixed order, so summing at join points is
+        deterministic. */
+    void buildTaskGraph (const Array<Op>& ops, const Array<int>& offsets,
+                         RenderThreadPool::TaskGraph& tasks)
+    {
+        const int numTasks = jmax (0, offsets.size() - 1);
+        tasks.reset (numTasks);
+
+        Array<BufferUse> audioUse, midiUse;
+        audioUse.resize (buffersNeeded (PortType::Audio));
+        midiUse.resize (buffersNeeded (PortType::Midi));
+        int lastSerialTask = -1;
+
+        auto addUses = [this, &tasks] (Array<BufferUse>& uses, const int task,
+                                       const Array<int>& reads, const Array<int>& writes)
+        {
+            for (const auto buffer : writes)
+            {
+                // the read-only empty buffer is never written on purpose
+                if (buffer == getReadOnlyEmptyBuffer())
+                    continue;
+                auto& use = uses.getReference (buffer);
+                if (use.writer >= 0 && use.writer != task)
+                    tasks.addDependency (task, use.writer);
+                for (const auto reader : use.readers)
+                    if (reader != task)
+                        tasks.addDependency (task, reader);
+                use.readers.clearQuick();
+                use.writer = task;
+            }
+
+            for (const auto buffer : reads)
+            {
+                if (buffer == getReadOnlyEmptyBuffer() || writes.contains (buffer))
+                    continue;
+                auto& use = uses.getReference (buffer);
+                if (use.writer >= 0 && use.writer != task)
+                    tasks.addDependency (task, use.writer);
+                use.readers.addIfNotAlreadyThere (task);
+            }
+        };
+
+        Array<int> audioReads, audioWrites, midiReads, midiWrites;
+        for (int task = 0; task < numTasks; ++task)
+        {
+            audioReads.clearQuick();
+            audioWrites.clearQuick();
+            midiReads.clearQuick();
+            midiWrites.clearQuick();
+            bool serial = false;
+
+            for (int i = offsets.getUnchecked (task); i < offsets.getUnchecked (task + 1); ++i)
+            {
+                const Op& op = ops.getReference (i);
+                switch (op.code)
+                {
+                    case Op::clearChannel:
+                        audioWrites.add (op.dest);
+                        break;
+                    case Op::copyChannel:
+                    case Op::addChannel:
+                        audioReads.add (op.source);
+                        audioWrites.add (op.dest);
+                        break;
+                    case Op::clearMidi:
+                        midiWrites.add (op.dest);
+                        break;
+                    case Op::copyMidi:
+                    case Op::addMidi:
+                        midiReads.add (op.source);
+                        midiWrites.add (op.dest);
+                        break;
+                    case Op::performTask:
+                        // tasks render in place
+                        op.task->collectBuffers (audioWrites, midiWrites);
+                        serial |= op.task->isSerial();
+                        break;
+                    default:
+                        jassertfalse; // compiled ops shouldn't be here
+                        break;
+                }
+            }
+
+            addUses (audioUse, task, audioReads, audioWrites);
+            addUses (midiUse, task, midiReads, midiWrites);
+
+            if (serial)
+            {
+                if (lastSerialTask >= 0)
+                    tasks.addDependency (task, lastSerialTask);
+                lastSerialTask = task;
+            }
+        }
+
+        tasks.finalize();
+    }
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProcessorGraphBuilder)
 };
 
 }
 
+/** Deletes programs once the audio thread can no longer be using them. This
+    runs on the message thread because dropping a program can release the
+    last reference to a node, and plugins expect to be deleted there */
+class GraphProcessor::ProgramRetirer : private Timer
+{
+public:
+    ProgramRetirer (GraphProcessor& g) : graph (g) { }
+
+    ~ProgramRetirer()
+    {
+        stopTimer();
+        // the audio thread must not be using this graph anymore
+        const ScopedLock sl (lock);
+        retired.clear();
+    }
+
+    void retire (GraphRender::Program* program)
+    {
+        if (program == nullptr)
+            return;
+        {
+            const ScopedLock sl (lock);
+            retired.add (program);
+        }
+        startTimer (20);
+    }
+
+    void releaseRetiredPrograms()
+    {
+        OwnedArray<GraphRender::Program> unused;
+
+        {
+            // newer programs can own ops that older ones still render with,
+            // so nothing is released while any retired program is in use
+            const ScopedLock sl (lock);
+            if (! retired.contains (graph.activeProgram.load()))
+                while (! retired.isEmpty())
+                    unused.add (retired.removeAndReturn (retired.size() - 1));
+        }
+    }
+
+private:
+    GraphProcessor& graph;
+    CriticalSection lock;
+    OwnedArray<GraphRender::Program> retired;
+
+    void timerCallback() override
+    {
+        releaseRetiredPrograms();
+        const ScopedLock sl (lock);
+        if (retired.isEmpty())
+            stopTimer();
+    }
+};
+
+/** Rebuilds the graph after a node's latency changes. Nodes report latency
+    from any thread, including the audio thread, so they only set a flag
+    which this picks up on the message thread */
+class GraphProcessor::LatencyWatcher : private Timer
+{
+public:
+    LatencyWatcher (GraphProcessor& g) : graph (g) { startTimer (50); }
+    ~LatencyWatcher() { stopTimer(); }
+
+private:
+    GraphProcessor& graph;
+
+    void timerCallback() override
+    {
+        if (graph.latencyChanged.exchange (false))
+            graph.triggerAsyncUpdate();
+    }
+};
+
 GraphProcessor::Connection::Connection (const uint32 sourceNode_, const uint32 sourcePort_,
                                         const uint32 destNode_, const uint32 destPort_) noexcept
     : Arc (sourceNode_, sourcePort_, destNode_, destPort_)
@@ -862,20 +1748,23 @@ GraphProcessor::Connection::Connection (const uint32 sourceNode_, const uint32 s
     
 GraphProcessor::GraphProcessor()
     : lastNodeId (0),
-      renderingBuffers (1, 1),
       currentAudioInputBuffer (nullptr),
       currentAudioOutputBuffer (1, 1),
       currentMidiInputBuffer (nullptr)
 {
     for (int i = 0; i < AudioGraphIOProcessor::numDeviceTypes; ++i)
         ioNodes[i] = KV_INVALID_PORT;
+    retirer.reset (new ProgramRetirer (*this));
+    latencyWatcher.reset (new LatencyWatcher (*this));
 }
 
 GraphProcessor::~GraphProcessor()
 {
     renderingSequenceChanged.disconnect_all_slots();
-    clearRenderingSequence();
+    latencyWatcher.reset();
     clear();
+    clearRenderingSequence();
+    retirer.reset();
 }
 
 const String GraphProcessor::getName() const
@@ -1208,49 +2097,79 @@ void GraphProcessor::setMidiChannel (const int channel) noexcept
         midiChannels.setOmni (true);
     else
         midiChannels.setChannel (channel);
+    updateMidiChannelMask();
 }
 
 void GraphProcessor::setMidiChannels (const BigInteger channels) noexcept
 {
-    ScopedLock sl (getCallbackLock());
     midiChannels.setChannels (channels);
+    updateMidiChannelMask();
 }
 
 void GraphProcessor::setMidiChannels (const kv::MidiChannels channels) noexcept
 {
-    ScopedLock sl (getCallbackLock());
     midiChannels = channels;
+    updateMidiChannelMask();
+}
+
+void GraphProcessor::updateMidiChannelMask() noexcept
+{
+    uint32 mask = 0;
+    for (int channel = 1; channel <= 16; ++channel)
+        if (midiChannels.isOmni() || midiChannels.isOn (channel))
+            mask |= (1u << channel);
+    midiChannelMask.store (mask);
 }
 
 bool GraphProcessor::acceptsMidiChannel (const int channel) const noexcept
 {
-    ScopedLock sl (getCallbackLock());
-    return midiChannels.isOn (channel);
+    const auto mask = midiChannelMask.load();
+    if (! isPositiveAndBelow (channel, 17))
+        return false;
+    return channel == 0 ? mask == allMidiChannels
+                        : (mask & (1u << channel)) != 0;
 }
 
 void GraphProcessor::setVelocityCurveMode (const VelocityCurve::Mode mode) noexcept
 {
-    ScopedLock sl (getCallbackLock());
-    velocityCurve.setMode (mode);
+    velocityCurveMode.store ((int) mode);
 }
 
-static void deleteRenderOpArray (Array<void*>& ops)
+void GraphProcessor::publishRenderingSequence (GraphRender::Program* program)
 {
-    for (int i = ops.size(); --i >= 0;)
-        delete static_cast<GraphRender::Task*> (ops.getUnchecked (i));
-    ops.clearQuick();
+    // the audio thread picks this up on its next block. the old program is
+    // retired instead of deleted since it could still be rendering
+    retirer->retire (renderProgram.exchange (program));
+    if (MessageManager::getInstance()->isThisTheMessageThread())
+        retirer->releaseRetiredPrograms();
 }
 
 void GraphProcessor::clearRenderingSequence()
 {
-    Array<void*> oldOps;
+    publishRenderingSequence (nullptr);
+}
 
-    {
-        const ScopedLock sl (getCallbackLock());
-        renderingOps.swapWith (oldOps);
-    }
+void GraphProcessor::setRenderThreadPool (RenderThreadPool* pool)
+{
+    renderThreads.store (pool);
+}
+
+void GraphProcessor::setRenderBufferPool (RenderBufferPool::Ptr pool)
+{
+    if (bufferPool == pool)
+        return;
+
+    bufferPool = pool;
+    for (auto* const node : nodes)
+        if (auto* const graph = dynamic_cast<GraphProcessor*> (node->getAudioProcessor()))
+            graph->setRenderBufferPool (pool);
+}
 
-    deleteRenderOpArray (oldOps);
+RenderBufferPool::Ptr GraphProcessor::getRenderBufferPool()
+{
+    if (bufferPool == nullptr)
+        bufferPool = new RenderBufferPool();
+    return bufferPool;
 }
 
 bool GraphProcessor::isAnInputTo (const uint32 possibleInputId,
@@ -1275,75 +2194,46 @@ bool GraphProcessor::isAnInputTo (const uint32 possibleInputId,
 
 void GraphProcessor::buildRenderingSequence()
 {
-    Array<void*> newRenderingOps;
-    int numRenderingBuffersNeeded = 2;
-    int numMidiBuffersNeeded = 1;
-
     {
         //XXX:
         MessageManagerLock mml;
 
-        Array<void*> orderedNodes;
+        std::unique_ptr<GraphRender::Program> program (new GraphRender::Program());
+        Array<GraphNode*> orderedNodes;
 
+        auto pool = getRenderBufferPool();
+        for (auto* const node : nodes)
         {
-            const LookupTable table (connections);
-
-            for (int i = 0; i < nodes.size(); ++i)
-            {
-                GraphNode* const node = nodes.getUnchecked(i);
-                node->prepare (getSampleRate(), getBlockSize(), this);
-
-                int j = 0;
-                for (; j < orderedNodes.size(); ++j)
-                    if (table.isAnInputTo (node->nodeId, ((GraphNode*) orderedNodes.getUnchecked(j))->nodeId))
-                      break;
-
-                orderedNodes.insert (j, node);
-            }
+            if (auto* const graph = dynamic_cast<GraphProcessor*> (node->getAudioProcessor()))
+                graph->setRenderBufferPool (pool);
+            node->prepare (getSampleRate(), getBlockSize(), this);
         }
 
-        GraphRender::ProcessorGraphBuilder calculator (*this, orderedNodes, newRenderingOps);
-
-        numRenderingBuffersNeeded = calculator.buffersNeeded (PortType::Audio);
-        numMidiBuffersNeeded      = calculator.buffersNeeded (PortType::Midi);
-    }
-
-    {
-        // swap over to the new rendering sequence..
-        const ScopedLock sl (getCallbackLock());
-
-        renderingBuffers.setSize (numRenderingBuffersNeeded, 4096);
-        renderingBuffers.clear();
+        GraphRender::sortNodes (*this, orderedNodes);
 
-        for (int i = midiBuffers.size(); --i >= 0;)
-            midiBuffers.getUnchecked(i)->clear();
+        // the current program is only replaced from here, under the lock, so
+        // its ops can be handed over to the new one
+        GraphRender::ProcessorGraphBuilder calculator (*this, orderedNodes, *program,
+                                                       renderProgram.load());
 
-        while (midiBuffers.size() < numMidiBuffersNeeded)
-            midiBuffers.add (new MidiBuffer());
+        // everything the new program needs is allocated here, before the
+        // audio thread ever sees it. larger host blocks get split up
+        program->allocateBuffers (*pool, calculator.buffersNeeded (PortType::Audio),
+                                  calculator.buffersNeeded (PortType::Midi),
+                                  getBlockSize() > 0 ? getBlockSize() : 1024);
 
-        renderingOps.swapWith (newRenderingOps);
+        publishRenderingSequence (program.release());
     }
 
-    // delete the old ones..
-    deleteRenderOpArray (newRenderingOps);
-
     renderingSequenceChanged();
 }
 
 void GraphProcessor::getOrderedNodes (ReferenceCountedArray<GraphNode>& orderedNodes)
 {
-    const LookupTable table (connections);
-    for (int i = 0; i < nodes.size(); ++i)
-    {
-        GraphNode* const node = nodes.getUnchecked(i);
-        
-        int j = 0;
-        for (; j < orderedNodes.size(); ++j)
-            if (table.isAnInputTo (node->nodeId, ((GraphNode*) orderedNodes.getUnchecked(j))->nodeId))
-                break;
-        
-        orderedNodes.insert (j, node);
-    }
+    Array<GraphNode*> ordered;
+    GraphRender::sortNodes (*this, ordered);
+    for (auto* const node : ordered)
+        orderedNodes.add (node);
 }
 
 void GraphProcessor::handleAsyncUpdate()
@@ -1357,6 +2247,8 @@ void GraphProcessor::prepareToPlay (double sampleRate, int estimatedSamplesPerBl
     currentAudioOutputBuffer.setSize (jmax (1, getTotalNumOutputChannels()), estimatedSamplesPerBlock);
     currentMidiInputBuffer = nullptr;
     currentMidiOutputBuffer.clear();
+    splitMidiIn.ensureSize (4096);
+    splitMidiOut.ensureSize (4096);
     clearRenderingSequence();
 
     if (getSampleRate() != sampleRate || getBlockSize() != estimatedSamplesPerBlock)
@@ -1373,18 +2265,34 @@ void GraphProcessor::prepareToPlay (double sampleRate, int estimatedSamplesPerBl
 
 void GraphProcessor::releaseResources()
 {
+    clearRenderingSequence();
+
     for (int i = 0; i < nodes.size(); ++i)
         nodes.getUnchecked(i)->unprepare();
 
-    renderingBuffers.setSize (1, 1);
-    midiBuffers.clear();
-
     currentAudioInputBuffer = nullptr;
     currentAudioOutputBuffer.setSize (1, 1);
     currentMidiInputBuffer = nullptr;
     currentMidiOutputBuffer.clear();
 }
 
+bool GraphProcessor::isReadyToRender() const
+{
+    if (renderProgram.load() == nullptr || isUpdatePending())
+        return false;
+
+    for (auto* const node : nodes)
+    {
+        if (node->isEnabled() && ! node->isPrepared)
+            return false;
+        if (auto* const graph = dynamic_cast<GraphProcessor*> (node->getAudioProcessor()))
+            if (! graph->isReadyToRender())
+                return false;
+    }
+
+    return true;
+}
+
 void GraphProcessor::reset()
 {
     const ScopedLock sl (getCallbackLock());
@@ -1396,37 +2304,110 @@ void GraphProcessor::reset()
 // MARK: Process Graph
 
 void GraphProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
+{
+    // announce which program is in use before touching it. re-checking
+    // guarantees the retirer can't miss a program picked up mid-swap
+    GraphRender::Program* program = nullptr;
+    do {
+        program = renderProgram.load();
+        activeProgram.store (program);
+    } while (program != renderProgram.load());
+
+    const int numSamples = buffer.getNumSamples();
+    const int maxBlockSize = program != nullptr ? program->getBlockSize() : numSamples;
+
+    if (numSamples <= maxBlockSize)
+    {
+        renderBlock (program, buffer, midiMessages);
+    }
+    else
+    {
+        // the host sent more than buffers were prepared for, usually an
+        // offline bounce. render it in pieces the program can handle
+        splitMidiOut.clear();
+
+        for (int offset = 0; offset < numSamples; offset += maxBlockSize)
+        {
+            const int numThisTime = jmin (maxBlockSize, numSamples - offset);
+            AudioSampleBuffer slice (buffer.getArrayOfWritePointers(), buffer.getNumChannels(),
+                                     offset, numThisTime);
+            splitMidiIn.clear();
+            splitMidiIn.addEvents (midiMessages, offset, numThisTime, -offset);
+            renderBlock (program, slice, splitMidiIn);
+            splitMidiOut.addEvents (splitMidiIn, 0, numThisTime, offset);
+        }
+
+        midiMessages.swapWith (splitMidiOut);
+    }
+
+    activeProgram.store (nullptr);
+}
+
+void GraphProcessor::renderBlock (GraphRender::Program* program, AudioSampleBuffer& buffer,
+                                  MidiBuffer& midiMessages)
 {
     const int32 numSamples = buffer.getNumSamples();
 
     currentAudioInputBuffer = &buffer;
-    currentAudioOutputBuffer.setSize (jmax (1, buffer.getNumChannels()), numSamples);
+    currentAudioOutputBuffer.setSize (jmax (1, buffer.getNumChannels()), numSamples,
+                                      false, false, true);
     currentAudioOutputBuffer.clear();
+
+    // channels and the curve are set from the message thread without a
+    // lock, take one copy of each for the whole block
+    const uint32 channelMask = midiChannelMask.load();
+    velocityCurve.setMode ((VelocityCurve::Mode) velocityCurveMode.load());
     
-    if (midiChannels.isOmni() && velocityCurve.getMode() == VelocityCurve::Linear)
+    if (channelMask == allMidiChannels && velocityCurve.getMode() == VelocityCurve::Linear)
     {
         currentMidiInputBuffer = &midiMessages;
     }
     else
     {
         filteredMidi.clear();
-        MidiBuffer::Iterator iter (midiMessages);
-        MidiMessage msg; int frame = 0, chan = 0;
-        
-        while (iter.getNextEvent (msg, frame))
+        if (filterStream.readFrom (midiMessages))
         {
-            chan = msg.getChannel();
-            if (chan > 0 && midiChannels.isOff (chan))
-                continue;
+            filterStream.removeIf ([channelMask] (const MidiEventStream::Event& e)
+            {
+                const int chan = e.getChannel();
+                return chan > 0 && (channelMask & (1u << chan)) == 0;
+            });
 
-            if (msg.isNoteOn())
+           #ifndef EL_FREE
+            if (velocityCurve.getMode() != VelocityCurve::Linear)
             {
-               #ifndef EL_FREE
-                msg.setVelocity (velocityCurve.process (msg.getFloatVelocity()));
-               #endif
+                filterStream.transform ([this] (MidiEventStream::Event& e)
+                {
+                    if (e.isNoteOn())
+                        e.bytes[2] = MidiMessage::floatValueToMidiByte (
+                            velocityCurve.process ((float) e.bytes[2] * (1.0f / 127.0f)));
+                });
             }
+           #endif
+
+            filterStream.writeTo (filteredMidi);
+        }
+        else
+        {
+            // more than the stream holds, filter message by message
+            MidiBuffer::Iterator iter (midiMessages);
+            MidiMessage msg; int frame = 0, chan = 0;
 
-            filteredMidi.addEvent (msg, frame);
+            while (iter.getNextEvent (msg, frame))
+            {
+                chan = msg.getChannel();
+                if (chan > 0 && (channelMask & (1u << chan)) == 0)
+                    continue;
+
+                if (msg.isNoteOn())
+                {
+                   #ifndef EL_FREE
+                    msg.setVelocity (velocityCurve.process (msg.getFloatVelocity()));
+                   #endif
+                }
+
+                filteredMidi.addEvent (msg, frame);
+            }
         }
         
         currentMidiInputBuffer = &filteredMidi;
@@ -1434,11 +2415,8 @@ void GraphProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMe
     
     currentMidiOutputBuffer.clear();
 
-    for (int i = 0; i < renderingOps.size(); ++i)
-    {
-        GraphRender::Task* const op = static_cast<GraphRender::Task*> (renderingOps.getUnchecked (i));
-        op->perform (renderingBuffers, midiBuffers, numSamples);
-    }
+    if (program != nullptr)
+        program->render (renderThreads.load(), numSamples);
 
     for (int i = 0; i < buffer.getNumChannels(); ++i)
         buffer.copyFrom (i, 0, currentAudioOutputBuffer, i, 0, numSamples);
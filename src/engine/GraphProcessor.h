@@ -21,11 +21,18 @@
 
 #include "ElementApp.h"
 #include "engine/GraphNode.h"
+#include "engine/MidiEventStream.h"
+#include "engine/RenderBufferPool.h"
+#include "engine/RenderThreadPool.h"
 #include "engine/VelocityCurve.h"
 #include "Signals.h"
 
 namespace Element {
 
+namespace GraphRender {
+class Program;
+}
+
 /**
     A type of AudioProcessor which plays back a graph of other AudioProcessors.
 
@@ -89,6 +96,11 @@ public:
     */
     GraphNode* getNodeForId (const uint32 nodeId) const;
 
+    /** Returns true once a render program is built for the current nodes
+        and connections, no rebuild is pending and every enabled node has
+        been prepared. Sub graphs have to be ready as well */
+    bool isReadyToRender() const;
+
     /** Adds a node to the graph.
 
         This creates a new node in the graph, for the specified processor. Once you have
@@ -187,6 +199,21 @@ public:
     /** Set the MIDI curve of this graph */
     void setVelocityCurveMode (const VelocityCurve::Mode) noexcept;
 
+    /** Render independent branches of this graph on a pool of threads. The
+        pool isn't owned, pass nullptr to render on the calling thread only */
+    void setRenderThreadPool (RenderThreadPool* pool);
+
+    /** Take rendering buffers from a pool shared with other graphs. Graphs
+        without one make their own. Also applies to nested graphs */
+    void setRenderBufferPool (RenderBufferPool::Ptr pool);
+
+    /** Returns the pool rendering buffers are taken from */
+    RenderBufferPool::Ptr getRenderBufferPool();
+
+    /** Called by nodes when their latency changes. Safe to call from any
+        thread, the graph is rebuilt shortly after on the message thread */
+    void nodeLatencyChanged() noexcept { latencyChanged.store (true); }
+
     /** A special number that represents the midi channel of a node.
 
         This is used as a channel index value if you want to refer to the midi input
@@ -341,9 +368,16 @@ private:
     uint32 ioNodes [AudioGraphIOProcessor::numDeviceTypes];
     
     uint32 lastNodeId;
-    AudioSampleBuffer renderingBuffers;
-    OwnedArray <MidiBuffer> midiBuffers;
-    Array<void*> renderingOps;
+
+    class ProgramRetirer;
+    std::unique_ptr<ProgramRetirer> retirer;
+    class LatencyWatcher;
+    std::unique_ptr<LatencyWatcher> latencyWatcher;
+    std::atomic<bool> latencyChanged { false };
+    std::atomic<GraphRender::Program*> renderProgram { nullptr };
+    std::atomic<GraphRender::Program*> activeProgram { nullptr };
+    std::atomic<RenderThreadPool*> renderThreads { nullptr };
+    RenderBufferPool::Ptr bufferPool;
 
     friend class AudioGraphIOProcessor;
     friend class GraphPort;
@@ -353,13 +387,23 @@ private:
     MidiBuffer* currentMidiInputBuffer;
     MidiBuffer currentMidiOutputBuffer;
     
+    // the message thread keeps the channels, the audio thread reads a
+    // mask of them. bit n is set when channel n is on
+    enum { allMidiChannels = 0x1fffe };
     kv::MidiChannels midiChannels;
+    std::atomic<uint32> midiChannelMask { allMidiChannels };
+    std::atomic<int> velocityCurveMode { VelocityCurve::Linear };
     VelocityCurve velocityCurve;
     MidiBuffer filteredMidi;
+    MidiEventStream filterStream;
+    MidiBuffer splitMidiIn, splitMidiOut;
     
+    void renderBlock (GraphRender::Program*, AudioSampleBuffer&, MidiBuffer&);
+    void updateMidiChannelMask() noexcept;
     void handleAsyncUpdate() override;
     void clearRenderingSequence();
     void buildRenderingSequence();
+    void publishRenderingSequence (GraphRender::Program*);
     bool isAnInputTo (uint32 possibleInputId, uint32 possibleDestinationId, int recursionCheck) const;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphProcessor)
@@ -25,6 +25,220 @@
 
 namespace Element {
 
+/** Carries parameter changes from MIDI input threads to the start of the
+    next audio block.
+
+    Handlers push changes with the time their MIDI message arrived. The
+    audio thread places each change at its offset in the block that just
+    went by and either sets the parameter or, when smoothing is on, ramps it
+    from there. Plugins still see one value per block, but changes land in
+    order with the controller's timing and without MIDI thread jitter.
+ */
+class MappingEngine::ParameterQueue
+{
+public:
+    /** A mapped parameter and its ramp. Owned by the handler using it */
+    struct Target
+    {
+        Target (Parameter* p, bool canSmooth)
+            : parameter (p),
+              smooth (canSmooth && p != nullptr && ! p->isDiscrete() && ! p->isBoolean()) { }
+
+        Parameter::Ptr parameter;
+        const bool smooth;
+
+        // only touched by the audio thread
+        float current = 0.f, target = 0.f, step = 0.f;
+        int remaining = 0, startOffset = 0;
+        bool ramping = false;
+    };
+
+    enum { capacity = 2048, maxRamps = 512 };
+
+    ParameterQueue()
+        : fifo (capacity)
+    {
+        changes.calloc ((size_t) capacity);
+        ramps.ensureStorageAllocated (maxRamps);
+    }
+
+    /** Queues a change. Called from MIDI input threads. Changes are
+        dropped if the audio thread has fallen too far behind, and applied
+        right away when nothing is rendering */
+    void push (Target& target, float value, double timeSeconds)
+    {
+        // more than one input thread can be writing
+        const SpinLock::ScopedLockType sl (writeLock);
+        if (! rendering.load())
+        {
+            if (target.parameter != nullptr)
+                setNow (target, value);
+            return;
+        }
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+        if (size1 + size2 < 1)
+            return;
+        changes [size1 > 0 ? start1 : start2] = { &target, value, timeSeconds, generation.load() };
+        fifo.finishedWrite (1);
+    }
+
+    /** Makes the audio thread forget every target. Call this on the message
+        thread after the inputs have stopped and before targets are deleted */
+    void invalidate()
+    {
+        ++generation;
+        while (numProcessing.load() > 0)
+            Thread::yield();
+    }
+
+    void process (const int numSamples, const double sampleRate)
+    {
+        ++numProcessing;
+
+        const uint32 currentGeneration = generation.load();
+        if (currentGeneration != lastGeneration)
+        {
+            ramps.clearQuick();
+            lastGeneration = currentGeneration;
+        }
+
+        const double now = Time::getMillisecondCounterHiRes() * 0.001;
+        const double blockStart = now - numSamples / sampleRate;
+        const int rampLength = roundToInt (smoothingTime.load() * 0.001 * sampleRate);
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (fifo.getNumReady(), start1, size1, start2, size2);
+        for (int i = 0; i < size1; ++i)
+            apply (changes [start1 + i], currentGeneration, blockStart, numSamples, sampleRate, rampLength);
+        for (int i = 0; i < size2; ++i)
+            apply (changes [start2 + i], currentGeneration, blockStart, numSamples, sampleRate, rampLength);
+        fifo.finishedRead (size1 + size2);
+
+        for (int i = ramps.size(); --i >= 0;)
+        {
+            auto& target = *ramps.getUnchecked (i);
+            const int numToAdvance = jmin (target.remaining, numSamples - target.startOffset);
+            target.startOffset = 0;
+            target.remaining -= numToAdvance;
+            target.current = target.remaining > 0 ? target.current + target.step * (float) numToAdvance
+                                                  : target.target;
+            target.parameter->setValueNotifyingHost (target.current);
+
+            if (target.remaining <= 0)
+            {
+                target.parameter->endChangeGesture();
+                target.ramping = false;
+                ramps.remove (i);
+            }
+        }
+
+        --numProcessing;
+    }
+
+    /** Drops queued changes. Call this where process() would be called */
+    void discard()
+    {
+        fifo.finishedRead (fifo.getNumReady());
+    }
+
+    /** Switches between queueing and applying changes right away. Ramps
+        still running jump to their targets when rendering stops. Must not
+        be called while process() runs */
+    void setRendering (const bool isRendering)
+    {
+        const SpinLock::ScopedLockType sl (writeLock);
+        if (rendering.load() == isRendering)
+            return;
+
+        if (! isRendering)
+        {
+            if (generation.load() == lastGeneration)
+            {
+                for (auto* target : ramps)
+                {
+                    target->parameter->setValueNotifyingHost (target->target);
+                    target->parameter->endChangeGesture();
+                    target->ramping = false;
+                }
+            }
+
+            ramps.clearQuick();
+        }
+
+        // anything queued is stale by now
+        discard();
+        rendering.store (isRendering);
+    }
+
+    std::atomic<double> smoothingTime { 0.0 };
+
+private:
+    struct Change
+    {
+        Target* target;
+        float value;
+        double time;
+        uint32 generation;
+    };
+
+    AbstractFifo fifo;
+    HeapBlock<Change> changes;
+    SpinLock writeLock;
+
+    std::atomic<uint32> generation { 0 };
+    std::atomic<int> numProcessing { 0 };
+    std::atomic<bool> rendering { false };
+    uint32 lastGeneration = 0;
+    Array<Target*> ramps;
+
+    static void setNow (Target& target, const float value)
+    {
+        target.parameter->beginChangeGesture();
+        target.parameter->setValueNotifyingHost (value);
+        target.parameter->endChangeGesture();
+    }
+
+    void apply (const Change& change, const uint32 currentGeneration, const double blockStart,
+                const int numSamples, const double sampleRate, const int rampLength)
+    {
+        if (change.generation != currentGeneration)
+            return;
+
+        auto& target = *change.target;
+        if (target.parameter == nullptr)
+            return;
+
+        if (rampLength <= 0 || ! target.smooth || (! target.ramping && ramps.size() >= maxRamps))
+        {
+            if (target.ramping)
+            {
+                target.parameter->endChangeGesture();
+                target.ramping = false;
+                ramps.removeFirstMatchingValue (&target);
+            }
+
+            setNow (target, change.value);
+            return;
+        }
+
+        if (! target.ramping)
+        {
+            target.current = target.parameter->getValue();
+            target.ramping = true;
+            target.parameter->beginChangeGesture();
+            ramps.add (&target);
+        }
+
+        target.target       = change.value;
+        target.step         = (target.target - target.current) / (float) rampLength;
+        target.remaining    = rampLength;
+        target.startOffset  = jlimit (0, numSamples - 1, roundToInt ((change.time - blockStart) * sampleRate));
+    }
+};
+
+//=============================================================================
 class ControllerMapHandler
 {
 public:
@@ -39,10 +253,12 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
                                public AsyncUpdater,
                                private Value::Listener
 {
-    MidiNoteControllerMap (const ControllerDevice::Control& ctl,
+    MidiNoteControllerMap (MappingEngine::ParameterQueue& queue_,
+                           const ControllerDevice::Control& ctl,
                            const MidiMessage& message, const Node& _node, 
                            const int _parameter)
-        : control (ctl),
+        : queue (queue_),
+          control (ctl),
           model (_node), 
           node (_node.getGraphNode()),
           parameterIndex (_parameter),
@@ -69,6 +285,9 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
             parameter = node->getParameters()[parameterIndex];
             jassert (nullptr != parameter);
         }
+
+        // notes switch values, there is nothing to glide
+        target.reset (new MappingEngine::ParameterQueue::Target (parameter.get(), false));
     }
 
     ~MidiNoteControllerMap()
@@ -103,18 +322,15 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
        
         if (parameter != nullptr)
         {
-            parameter->beginChangeGesture();
             if (momentary.get() == 0)
             {
-                parameter->setValueNotifyingHost (parameter->getValue() < 0.5 ? 1.f : 0.f);
+                queue.push (*target, parameter->getValue() < 0.5 ? 1.f : 0.f, message.getTimeStamp());
             }
             else
             {
                 const bool onOrOff = isInverse ? message.isNoteOff() : message.isNoteOn();
-                parameter->setValueNotifyingHost (onOrOff ? 1.f : 0.f);
+                queue.push (*target, onOrOff ? 1.f : 0.f, message.getTimeStamp());
             }
-
-            parameter->endChangeGesture();
         }
         else if (parameterIndex == GraphNode::EnabledParameter ||
                  parameterIndex == GraphNode::BypassParameter ||
@@ -174,11 +390,13 @@ struct MidiNoteControllerMap : public ControllerMapHandler,
     }
 
 private:
+    MappingEngine::ParameterQueue& queue;
     ControllerDevice::Control control;
     Node model;
     GraphNodePtr node { nullptr };
-    Parameter::Ptr parameter { nullptr };
     int parameterIndex = -1;
+    Parameter::Ptr parameter { nullptr };
+    std::unique_ptr<MappingEngine::ParameterQueue::Target> target;
 
     Value channelObject;
     Atomic<int> channel { 0 };
@@ -215,11 +433,12 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
                                     public AsyncUpdater,
                                     private Value::Listener
 {
-    MidiCCControllerMapHandler (const ControllerDevice::Control& ctl, 
+    MidiCCControllerMapHandler (MappingEngine::ParameterQueue& queue_,
+                                const ControllerDevice::Control& ctl, 
                                 const MidiMessage& message,
                                 const Node& _node,
                                 const int _parameter)
-        : control (ctl), model (_node), node (_node.getGraphNode()),
+        : queue (queue_), control (ctl), model (_node), node (_node.getGraphNode()),
           parameter (nullptr),
           controllerNumber (message.getControllerNumber()),
           parameterIndex (_parameter)
@@ -252,6 +471,8 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
         {
             lastControllerValue = model.isEnabled() ? 127 : 0;
         }
+
+        target.reset (new MappingEngine::ParameterQueue::Target (parameter.get(), true));
     }
 
     ~MidiCCControllerMapHandler()
@@ -275,9 +496,7 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
 
         if (nullptr != parameter)
         {
-            parameter->beginChangeGesture();
-            parameter->setValueNotifyingHost (static_cast<float> (ccValue) / 127.f);
-            parameter->endChangeGesture();
+            queue.push (*target, static_cast<float> (ccValue) / 127.f, message.getTimeStamp());
         }
         else if (parameterIndex == GraphNode::EnabledParameter ||
                  parameterIndex == GraphNode::BypassParameter ||
@@ -369,10 +588,12 @@ struct MidiCCControllerMapHandler : public ControllerMapHandler,
     }
 
 private:
+    MappingEngine::ParameterQueue& queue;
     ControllerDevice::Control control;
     Node model;
     GraphNodePtr node { nullptr };
     Parameter::Ptr parameter { nullptr };
+    std::unique_ptr<MappingEngine::ParameterQueue::Target> target;
     
     const int controllerNumber { -1 };
     const int parameterIndex { -1 };
@@ -441,7 +662,12 @@ public:
         else if (message.isController())
             mapping.captureNextEvent (*this, controls[message.getControllerNumber()], message);
 
-        for (auto* handler : handlers)
+        // handlers still check the channel, which can change while mapped
+        const auto& candidates = message.isController()
+            ? controllerHandlers [message.getControllerNumber()]
+            : noteHandlers [message.getNoteNumber()];
+
+        for (auto* handler : candidates)
             if (handler->wants (message))
                 handler->perform (message);
     }
@@ -499,10 +725,15 @@ public:
         return isInputFor (control.getControllerDevice());
     }
 
-    void addHandler (ControllerMapHandler* handler)
+    /** Adds a handler for the controller or note in the message */
+    void addHandler (ControllerMapHandler* handler, const MidiMessage& message)
     {
         stop();
         handlers.add (handler);
+        if (message.isController())
+            controllerHandlers [message.getControllerNumber()].add (handler);
+        else if (message.isNoteOn())
+            noteHandlers [message.getNoteNumber()].add (handler);
         start();
     }
 
@@ -512,6 +743,7 @@ private:
     ControllerDevice controllerDevice;
     std::unique_ptr<MidiInput> midiInput;
     OwnedArray<ControllerMapHandler> handlers;
+    Array<ControllerMapHandler*> controllerHandlers [128], noteHandlers [128];
     BigInteger controllerNumbers, noteNumbers;
     HashMap<int, ControllerDevice::Control> controls, notes;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ControllerMapInput)
@@ -520,7 +752,7 @@ private:
 class MappingEngine::Inputs
 {
 public:
-    Inputs() { }
+    Inputs (ParameterQueue& q) : parameters (q) { }
     ~Inputs() { }
 
     bool add (ControllerMapInput* input)
@@ -538,6 +770,7 @@ public:
         if (auto* input = findInput (device))
         {
             input->close();
+            parameters.invalidate();
             inputs.removeObject (input, true);
         }
 
@@ -549,6 +782,7 @@ public:
         stop();
         for (auto* input : inputs)
             input->close();
+        parameters.invalidate();
         inputs.clear (true);
     }
 
@@ -594,13 +828,15 @@ public:
     void swapWith (OwnedArray<ControllerMapInput>& other) { inputs.swapWith (other); }
 
 private:
+    ParameterQueue& parameters;
     OwnedArray<ControllerMapInput> inputs;
     bool running = false;
 };
 
 MappingEngine::MappingEngine()
 { 
-    inputs.reset (new Inputs());
+    parameters.reset (new ParameterQueue());
+    inputs.reset (new Inputs (*parameters));
     capturedEvent.capture.set (true);
 }
 
@@ -608,6 +844,7 @@ MappingEngine::~MappingEngine()
 {
     inputs->clear();
     inputs = nullptr;
+    parameters = nullptr;
 }
 
 bool MappingEngine::addInput (const ControllerDevice& controller, MidiEngine& midi)
@@ -638,13 +875,13 @@ bool MappingEngine::addHandler (const ControllerDevice::Control& control,
             std::unique_ptr<ControllerMapHandler> handler;
 
             if (message.isController())
-                handler.reset (new MidiCCControllerMapHandler (control, message, node, parameter));
+                handler.reset (new MidiCCControllerMapHandler (*parameters, control, message, node, parameter));
             else if (message.isNoteOn())
-                handler.reset (new MidiNoteControllerMap (control, message, node, parameter));
+                handler.reset (new MidiNoteControllerMap (*parameters, control, message, node, parameter));
 
             if (nullptr != handler)
             {
-                input->addHandler (handler.release());
+                input->addHandler (handler.release(), message);
                 return true;
             }
         }
@@ -690,6 +927,32 @@ void MappingEngine::stopMapping()
     inputs->stop();
 }
 
+void MappingEngine::processParameterChanges (int numSamples, double sampleRate)
+{
+    if (numSamples > 0 && sampleRate > 0.0)
+        parameters->process (numSamples, sampleRate);
+}
+
+void MappingEngine::discardParameterChanges()
+{
+    parameters->discard();
+}
+
+void MappingEngine::setRendering (bool isRendering)
+{
+    parameters->setRendering (isRendering);
+}
+
+void MappingEngine::setSmoothingTime (double milliseconds)
+{
+    parameters->smoothingTime.store (jmax (0.0, milliseconds));
+}
+
+double MappingEngine::getSmoothingTime() const
+{
+    return parameters->smoothingTime.load();
+}
+
 bool MappingEngine::captureNextEvent (ControllerMapInput& input, 
                                       const ControllerDevice::Control& control, 
                                       const MidiMessage& message)
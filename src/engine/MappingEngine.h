@@ -52,8 +52,32 @@ public:
     ControllerDevice::Control getCapturedControl() const { return capturedEvent.control; }
     CapturedEventSignal& capturedSignal() { return capturedEvent.callback; }
 
+    /** Applies the parameter changes mapped controls have queued since the
+        last block. Called by the audio engine before rendering a block */
+    void processParameterChanges (int numSamples, double sampleRate);
+
+    /** Drops the queued parameter changes. Called by the audio engine for
+        blocks it doesn't render, so the queue doesn't fill up */
+    void discardParameterChanges();
+
+    /** Called by the audio engine when it starts or stops rendering. While
+        it isn't, mapped controls apply changes right away on the thread
+        receiving MIDI instead of queueing them, without smoothing. Call
+        this while no block is being processed */
+    void setRendering (bool isRendering);
+
+    /** Sets how long continuous parameters take to glide to a value sent by
+        a controller. Zero applies changes right away */
+    void setSmoothingTime (double milliseconds);
+
+    /** Returns the smoothing time in milliseconds */
+    double getSmoothingTime() const;
+
 private:
     friend class ControllerMapInput;
+    friend struct MidiNoteControllerMap;
+    friend struct MidiCCControllerMapHandler;
+    class ParameterQueue; std::unique_ptr<ParameterQueue> parameters;
     class Inputs; std::unique_ptr<Inputs> inputs;
 
     class CapturedEvent : public AsyncUpdater
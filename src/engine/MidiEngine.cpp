@@ -129,17 +129,85 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CallbackHandler)
 };
 
+/** Counts the dispatches in progress on the calling thread, so callbacks
+    which add or remove callbacks can be told apart from other callers */
+static thread_local int dispatchDepth = 0;
+
+MidiEngine::MidiInputHolder::~MidiInputHolder()
+{
+    // nothing is dispatched once the input is gone
+    input.reset();
+    cancelPendingUpdate();
+    retired.clear();
+    delete subscribers.exchange (nullptr);
+}
+
 void MidiEngine::MidiInputHolder::handleIncomingMidiMessage (MidiInput* source, const MidiMessage& message)
 {
     if (message.isActiveSense())
         return;
 
     jassert (source == input.get());
-    const ScopedLock sl (engine.midiCallbackLock);
+    ++numDispatching;
+    ++dispatchDepth;
+
+    if (auto* const list = subscribers.load())
+        for (const auto& sub : *list)
+            if (active || sub.consumer)
+                sub.callback->handleIncomingMidiMessage (source, message);
+
+    --dispatchDepth;
+    --numDispatching;
+}
+
+void MidiEngine::MidiInputHolder::setSubscribers (SubscriberList* newSubscribers)
+{
+    std::unique_ptr<SubscriberList> oldSubscribers (subscribers.exchange (newSubscribers));
+    if (oldSubscribers != nullptr)
+    {
+        const SpinLock::ScopedLockType sl (retiredLock);
+        retired.push_back (std::move (oldSubscribers));
+    }
+
+    // a callback changing the callbacks would wait on its own dispatch, so
+    // the old list is freed later on the message thread instead
+    if (dispatchDepth > 0)
+    {
+        triggerAsyncUpdate();
+        return;
+    }
 
-    for (auto& mc : engine.midiCallbacks)
-        if ((active || mc.consumer) && (mc.deviceName.isEmpty() || mc.deviceName == input->getName()))
-            mc.callback->handleIncomingMidiMessage (input.get(), message);
+    // the MIDI thread could have picked up the old list just before the
+    // swap. once this returns, removed callbacks are never called again
+    while (numDispatching.load() > 0)
+        Thread::yield();
+
+    releaseRetired();
+}
+
+void MidiEngine::MidiInputHolder::releaseRetired()
+{
+    std::vector<std::unique_ptr<SubscriberList>> lists;
+
+    {
+        // dispatching counts up before loading the list, so if nothing is
+        // dispatching now nothing holds a retired one
+        const SpinLock::ScopedLockType sl (retiredLock);
+        if (retired.empty())
+            return;
+        if (numDispatching.load() > 0)
+        {
+            triggerAsyncUpdate();
+            return;
+        }
+
+        lists.swap (retired);
+    }
+}
+
+void MidiEngine::MidiInputHolder::handleAsyncUpdate()
+{
+    releaseRetired();
 }
 
 //==============================================================================
@@ -167,12 +235,14 @@ MidiEngine::MidiInputHolder* MidiEngine::getMidiInput (const String& deviceName,
     if (index >= 0)
     {
         std::unique_ptr<MidiInputHolder> holder;
-        holder.reset (new MidiInputHolder (*this));
+        holder.reset (new MidiInputHolder());
         if (auto midiIn = MidiInput::openDevice (index, holder.get()))
         {
             holder->input.reset (midiIn.release());
-            holder->input->start();
-            return openMidiInputs.add (holder.release());
+            auto* const opened = openMidiInputs.add (holder.release());
+            updateSubscribers();
+            opened->input->start();
+            return opened;
         }
     }
 
@@ -225,13 +295,19 @@ void MidiEngine::addMidiInputCallback (const String& name, MidiInputCallback* ca
         mc.callback = callbackToAdd;
         mc.consumer = consumer;
 
-        const ScopedLock sl (midiCallbackLock);
-        midiCallbacks.add (mc);
+        {
+            const ScopedLock sl (midiCallbackLock);
+            midiCallbacks.add (mc);
+        }
+
+        updateSubscribers();
     }
 }
 
 void MidiEngine::removeMidiInputCallback (const String& name, MidiInputCallback* callbackToRemove)
 {
+    bool removed = false;
+
     for (int i = midiCallbacks.size(); --i >= 0;)
     {
         auto& mc = midiCallbacks.getReference (i);
@@ -240,12 +316,18 @@ void MidiEngine::removeMidiInputCallback (const String& name, MidiInputCallback*
         {
             const ScopedLock sl (midiCallbackLock);
             midiCallbacks.remove (i);
+            removed = true;
         }
     }
+
+    if (removed)
+        updateSubscribers();
 }
 
 void MidiEngine::removeMidiInputCallback (MidiInputCallback* callbackToRemove)
 {
+    bool removed = false;
+
     for (int i = midiCallbacks.size(); --i >= 0;)
     {
         auto& mc = midiCallbacks.getReference (i);
@@ -254,8 +336,32 @@ void MidiEngine::removeMidiInputCallback (MidiInputCallback* callbackToRemove)
         {
             const ScopedLock sl (midiCallbackLock);
             midiCallbacks.remove (i);
+            removed = true;
         }
     }
+
+    if (removed)
+        updateSubscribers();
+}
+
+void MidiEngine::updateSubscribers()
+{
+    const ScopedLock sl (midiCallbackLock);
+    for (auto* const holder : openMidiInputs)
+    {
+        if (holder->input == nullptr)
+            continue;
+
+        const auto deviceName = holder->input->getName();
+        std::unique_ptr<SubscriberList> list (new SubscriberList());
+        list->reserve ((size_t) midiCallbacks.size());
+
+        for (const auto& mc : midiCallbacks)
+            if (mc.deviceName.isEmpty() || mc.deviceName == deviceName)
+                list->push_back ({ mc.callback, mc.consumer });
+
+        holder->setSubscribers (list.release());
+    }
 }
 
 void MidiEngine::handleIncomingMidiMessageInt (MidiInput* source, const MidiMessage& message)
@@ -132,18 +132,42 @@ private:
         MidiInputCallback* callback;
     };
 
-    struct MidiInputHolder : public MidiInputCallback
+    /** A callback registered for one input, resolved from midiCallbacks */
+    struct Subscriber
     {
-        MidiInputHolder (MidiEngine& e)
-            : engine (e) { }
+        MidiInputCallback* callback;
+        bool consumer;
+    };
+
+    using SubscriberList = std::vector<Subscriber>;
+
+    struct MidiInputHolder : public MidiInputCallback,
+                             private AsyncUpdater
+    {
+        MidiInputHolder() { }
+        ~MidiInputHolder();
 
         std::unique_ptr<MidiInput> input;
         bool active = false;  // if true, then will feed to audio engine
 
         void handleIncomingMidiMessage (MidiInput* source, const MidiMessage& message) override;
 
+        /** Replaces the callbacks for this input. The list is never changed
+            after being published here, so the MIDI thread can walk it
+            without locking. Returns once the old list is no longer in use,
+            except when called from inside a dispatch: callbacks may add or
+            remove callbacks, and then the old list is deleted later on the
+            message thread */
+        void setSubscribers (SubscriberList* newSubscribers);
+
     private:
-        MidiEngine& engine;
+        std::atomic<SubscriberList*> subscribers { nullptr };
+        std::atomic<int> numDispatching { 0 };
+        std::vector<std::unique_ptr<SubscriberList>> retired;
+        SpinLock retiredLock;
+
+        void releaseRetired();
+        void handleAsyncUpdate() override;
     };
 
     StringArray midiInsFromXml;
@@ -158,6 +182,7 @@ private:
     std::unique_ptr<CallbackHandler> callbackHandler;
 
     MidiInputHolder* getMidiInput (const String& deviceName, bool openIfNotAlready);
+    void updateSubscribers();
     void handleIncomingMidiMessageInt (MidiInput*, const MidiMessage&);
 };
 
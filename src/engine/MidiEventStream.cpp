@@ -0,0 +1,138 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/MidiEventStream.h"
+
+namespace Element {
+
+/** Bytes MidiBuffer stores in front of each message: int32 frame, uint16 size */
+static const int midiBufferHeaderSize = (int) (sizeof (int32) + sizeof (uint16));
+
+MidiEventStream::MidiEventStream (int numEvents_, int numSysexBytes)
+{
+    setCapacity (numEvents_, numSysexBytes);
+}
+
+MidiEventStream::~MidiEventStream() { }
+
+void MidiEventStream::setCapacity (int newMaxEvents, int newMaxSysex)
+{
+    maxEvents = jmax (0, newMaxEvents);
+    maxSysex  = jmax (0, newMaxSysex);
+    events.malloc ((size_t) jmax (1, maxEvents));
+    sysex.malloc ((size_t) jmax (1, maxSysex));
+    clear();
+}
+
+void MidiEventStream::swapWith (MidiEventStream& other) noexcept
+{
+    events.swapWith (other.events);
+    sysex.swapWith (other.sysex);
+    std::swap (maxEvents, other.maxEvents);
+    std::swap (maxSysex, other.maxSysex);
+    std::swap (numEvents, other.numEvents);
+    std::swap (sysexUsed, other.sysexUsed);
+}
+
+bool MidiEventStream::addEvent (const uint8* data, int size, int frame) noexcept
+{
+    if (size <= 0 || size > 0xffff || numEvents >= maxEvents)
+        return false;
+
+    Event& e = events [numEvents];
+    e.frame     = frame;
+    e.size      = (uint16) size;
+    e.reserved  = 0;
+
+    if (e.isInline())
+    {
+        e.offset = 0;
+        memcpy (e.bytes, data, (size_t) size);
+    }
+    else
+    {
+        if (sysexUsed + size > maxSysex)
+            return false;
+        e.offset = (uint32) sysexUsed;
+        memcpy (sysex.get() + sysexUsed, data, (size_t) size);
+        sysexUsed += size;
+    }
+
+    ++numEvents;
+    return true;
+}
+
+bool MidiEventStream::readFrom (const MidiBuffer& midi, int endFrame) noexcept
+{
+    clear();
+
+    MidiBuffer::Iterator iter (midi);
+    const uint8* data = nullptr;
+    int size = 0, frame = 0;
+    bool allAdded = true;
+
+    while (iter.getNextEvent (data, size, frame))
+    {
+        if (frame >= endFrame)
+            break;
+        allAdded = addEvent (data, size, frame) && allAdded;
+    }
+
+    return allAdded;
+}
+
+void MidiEventStream::append (MidiBuffer& midi, const uint8* data, int size, int frame)
+{
+    // MidiBuffer::addEvent searches for the insert position on every call.
+    // Events here are already in order, so they go straight on the end
+    auto& bytes = midi.data;
+    const int pos = bytes.size();
+    bytes.resize (pos + midiBufferHeaderSize + size);
+
+    uint8* d = bytes.getRawDataPointer() + pos;
+    const int32 frame32 = (int32) frame;
+    const uint16 size16 = (uint16) size;
+    memcpy (d, &frame32, sizeof (int32));
+    memcpy (d + sizeof (int32), &size16, sizeof (uint16));
+    memcpy (d + midiBufferHeaderSize, data, (size_t) size);
+}
+
+void MidiEventStream::writeTo (MidiBuffer& midi) const
+{
+    int totalBytes = 0;
+    for (const auto& e : *this)
+        totalBytes += midiBufferHeaderSize + e.size;
+
+    midi.clear();
+    midi.ensureSize ((size_t) totalBytes);
+    for (const auto& e : *this)
+        append (midi, getData (e), e.size, e.frame);
+}
+
+void MidiEventStream::splitByChannel (MidiBuffer* const* channelBuffers, MidiBuffer* other) const
+{
+    for (const auto& e : *this)
+    {
+        const int channel = e.getChannel();
+        if (auto* const dest = channel > 0 ? channelBuffers [channel - 1] : other)
+            append (*dest, getData (e), e.size, e.frame);
+    }
+}
+
+}
@@ -0,0 +1,141 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** A fixed capacity list of timestamped MIDI events for the render path.
+
+    Short messages are stored inline in 12 byte events, so filtering and
+    transforming them never builds a MidiMessage. Longer messages, like
+    sysex, are copied to a side arena. Nothing is allocated after
+    construction or setCapacity.
+
+    Events keep the order they were added in. Filling a stream from a
+    MidiBuffer and writing it back keeps the buffer's time ordering.
+ */
+class MidiEventStream
+{
+public:
+    struct Event
+    {
+        int32 frame;
+        uint16 size;
+        uint16 reserved;
+        union
+        {
+            uint8 bytes[4];     // messages of 4 bytes or less
+            uint32 offset;      // longer ones, in the sysex arena
+        };
+
+        bool isInline() const noexcept         { return size <= 4; }
+
+        /** Returns the channel, 1 to 16, or 0 if this isn't a channel message */
+        int getChannel() const noexcept
+        {
+            return (isInline() && bytes[0] >= 0x80 && bytes[0] < 0xf0) ? (bytes[0] & 0x0f) + 1 : 0;
+        }
+
+        bool isNoteOn() const noexcept         { return isInline() && size >= 3 && (bytes[0] & 0xf0) == 0x90 && bytes[2] != 0; }
+        bool isNoteOnOrOff() const noexcept    { return isInline() && size >= 3 && ((bytes[0] & 0xf0) == 0x90 || (bytes[0] & 0xf0) == 0x80); }
+        bool isProgramChange() const noexcept  { return isInline() && (bytes[0] & 0xf0) == 0xc0; }
+    };
+
+    MidiEventStream (int maxEvents = 1024, int maxSysexBytes = 4096);
+    ~MidiEventStream();
+
+    /** Changes the capacity. This allocates and clears the stream */
+    void setCapacity (int maxEvents, int maxSysexBytes);
+
+    void clear() noexcept                       { numEvents = 0; sysexUsed = 0; }
+
+    /** Swaps contents and capacity with another stream. Doesn't allocate */
+    void swapWith (MidiEventStream& other) noexcept;
+    int getNumEvents() const noexcept           { return numEvents; }
+    bool isEmpty() const noexcept               { return numEvents == 0; }
+
+    /** Adds an event. Returns false if there wasn't room for it */
+    bool addEvent (const uint8* data, int size, int frame) noexcept;
+
+    /** Returns an event's bytes */
+    const uint8* getData (const Event& e) const noexcept
+    {
+        return e.isInline() ? e.bytes : sysex.get() + e.offset;
+    }
+
+    Event* begin() noexcept                     { return events.get(); }
+    Event* end() noexcept                       { return events.get() + numEvents; }
+    const Event* begin() const noexcept         { return events.get(); }
+    const Event* end() const noexcept           { return events.get() + numEvents; }
+
+    /** Replaces the stream's contents with a MidiBuffer's events before
+        endFrame. Returns false if they didn't all fit */
+    bool readFrom (const MidiBuffer& midi, int endFrame = std::numeric_limits<int>::max()) noexcept;
+
+    /** Replaces a MidiBuffer's contents with these events. This doesn't
+        allocate if the buffer has room, see MidiBuffer::ensureSize */
+    void writeTo (MidiBuffer& midi) const;
+
+    /** Appends each channel message to the buffer for its channel, and
+        everything else to other, if given. The buffers should be empty
+        or only hold events earlier than these */
+    void splitByChannel (MidiBuffer* const* channelBuffers, MidiBuffer* other = nullptr) const;
+
+    /** Removes the events a predicate returns true for. The predicate is
+        called once per event, in order, so it may act on what it removes */
+    template<class Predicate>
+    void removeIf (Predicate shouldRemove)
+    {
+        int kept = 0;
+        for (int i = 0; i < numEvents; ++i)
+        {
+            if (shouldRemove (static_cast<const Event&> (events[i])))
+                continue;
+            if (kept != i)
+                events[kept] = events[i];
+            ++kept;
+        }
+
+        numEvents = kept;
+    }
+
+    /** Calls a function to modify every inline event in place */
+    template<class Function>
+    void transform (Function fn)
+    {
+        for (int i = 0; i < numEvents; ++i)
+            if (events[i].isInline())
+                fn (events[i]);
+    }
+
+private:
+    HeapBlock<Event> events;
+    HeapBlock<uint8> sysex;
+    int maxEvents = 0, maxSysex = 0;
+    int numEvents = 0, sysexUsed = 0;
+
+    static void append (MidiBuffer& midi, const uint8* data, int size, int frame);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiEventStream)
+};
+
+}
@@ -0,0 +1,174 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/NodeMeter.h"
+
+namespace Element {
+
+/** Blocks held per channel. Enough for ~100ms between reads at 32 samples per block */
+static const int ringSize = 128;
+
+static float getPeak (const float* data, int numSamples) noexcept
+{
+    const auto range = FloatVectorOperations::findMinAndMax (data, numSamples);
+    return jmax (-range.getStart(), range.getEnd());
+}
+
+static double getSumOfSquares (const float* data, int numSamples) noexcept
+{
+    float sum = 0.f;
+    int i = 0;
+
+   #if JUCE_USE_SIMD
+    using Vec = dsp::SIMDRegister<float>;
+    while (i < numSamples && ! Vec::isSIMDAligned (data + i))
+    {
+        sum += data[i] * data[i];
+        ++i;
+    }
+
+    auto acc = Vec::expand (0.f);
+    for (; i + (int) Vec::SIMDNumElements <= numSamples; i += (int) Vec::SIMDNumElements)
+    {
+        const auto v = Vec::fromRawArray (data + i);
+        acc += v * v;
+    }
+
+    sum += acc.sum();
+   #endif
+
+    for (; i < numSamples; ++i)
+        sum += data[i] * data[i];
+
+    return (double) sum;
+}
+
+NodeMeter::Channel::Channel()
+    : fifo (ringSize)
+{
+    blocks.calloc ((size_t) ringSize);
+    overflow = { 0.f, 0.0, 0 };
+}
+
+NodeMeter::NodeMeter (int numInputs, int numOutputs)
+{
+    for (int i = 0; i < numInputs; ++i)
+        inputs.add (new Channel());
+    for (int i = 0; i < numOutputs; ++i)
+        outputs.add (new Channel());
+}
+
+NodeMeter::~NodeMeter() { }
+
+NodeMeter::Channel* NodeMeter::getChannel (bool isInput, int channel) const noexcept
+{
+    const auto& channels = isInput ? inputs : outputs;
+    return isPositiveAndBelow (channel, channels.size()) ? channels.getUnchecked (channel) : nullptr;
+}
+
+void NodeMeter::subscribe (bool isInput, int channel)
+{
+    if (auto* const ch = getChannel (isInput, channel))
+    {
+        ++ch->subscribers;
+        ++numSubscribed;
+    }
+}
+
+void NodeMeter::unsubscribe (bool isInput, int channel)
+{
+    auto* const ch = getChannel (isInput, channel);
+    if (ch == nullptr || ch->subscribers.get() <= 0)
+        return;
+
+    if (--ch->subscribers == 0)
+        ch->last = Levels();
+    --numSubscribed;
+}
+
+int NodeMeter::getNumSubscribers (bool isInput, int channel) const noexcept
+{
+    auto* const ch = getChannel (isInput, channel);
+    return ch != nullptr ? ch->subscribers.get() : 0;
+}
+
+void NodeMeter::measure (bool isInput, const AudioSampleBuffer& buffer, int numSamples) noexcept
+{
+    const auto& channels = isInput ? inputs : outputs;
+    const int numChannels = jmin (channels.size(), buffer.getNumChannels());
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        auto* const ch = channels.getUnchecked (c);
+        if (ch->subscribers.get() <= 0)
+            continue;
+
+        const float* const data = buffer.getReadPointer (c);
+        auto& block = ch->overflow;
+        block.peak = jmax (block.peak, getPeak (data, numSamples));
+        block.sumOfSquares += getSumOfSquares (data, numSamples);
+        block.numSamples += numSamples;
+
+        int start1, size1, start2, size2;
+        ch->fifo.prepareToWrite (1, start1, size1, start2, size2);
+        if (size1 + size2 < 1)
+            continue;
+
+        ch->blocks [size1 > 0 ? start1 : start2] = block;
+        ch->fifo.finishedWrite (1);
+        block = { 0.f, 0.0, 0 };
+    }
+}
+
+NodeMeter::Levels NodeMeter::read (bool isInput, int channel)
+{
+    auto* const ch = getChannel (isInput, channel);
+    if (ch == nullptr)
+        return {};
+
+    int start1, size1, start2, size2;
+    ch->fifo.prepareToRead (ch->fifo.getNumReady(), start1, size1, start2, size2);
+    if (size1 + size2 <= 0)
+        return ch->last;
+
+    float peak = 0.f;
+    double sumOfSquares = 0.0;
+    int numSamples = 0;
+
+    auto add = [&] (int start, int size)
+    {
+        for (int i = start; i < start + size; ++i)
+        {
+            const auto& block = ch->blocks [i];
+            peak = jmax (peak, block.peak);
+            sumOfSquares += block.sumOfSquares;
+            numSamples += block.numSamples;
+        }
+    };
+
+    add (start1, size1);
+    add (start2, size2);
+    ch->fifo.finishedRead (size1 + size2);
+
+    ch->last.peak = peak;
+    ch->last.rms  = numSamples > 0 ? (float) std::sqrt (sumOfSquares / (double) numSamples) : 0.f;
+    return ch->last;
+}
+
+}
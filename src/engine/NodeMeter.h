@@ -0,0 +1,95 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** Peak and RMS levels of a node's audio channels.
+
+    Nothing is measured for a channel until something subscribes to it. The
+    audio thread measures subscribed channels once per block and pushes the
+    results into a lock-free ring per channel. Readers drain the ring at
+    display rate, so a reading covers every block since the last one.
+ */
+class NodeMeter : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<NodeMeter>;
+
+    struct Levels
+    {
+        float peak  = 0.f;
+        float rms   = 0.f;
+    };
+
+    NodeMeter (int numInputs, int numOutputs);
+    ~NodeMeter();
+
+    /** Number of channels on either side */
+    int getNumChannels (bool isInput) const noexcept { return (isInput ? inputs : outputs).size(); }
+
+    /** Starts or stops measuring a channel. Calls are counted, so several
+        meters can watch the same channel */
+    void subscribe (bool isInput, int channel);
+    void unsubscribe (bool isInput, int channel);
+
+    /** Number of subscribers a channel has */
+    int getNumSubscribers (bool isInput, int channel) const noexcept;
+
+    /** True if any channel has a subscriber */
+    bool isActive() const noexcept { return numSubscribed.get() > 0; }
+
+    /** Measures the subscribed channels of a buffer. Audio thread only */
+    void measure (bool isInput, const AudioSampleBuffer& buffer, int numSamples) noexcept;
+
+    /** Returns the levels of everything measured since the last read. If
+        nothing new arrived, the last levels are returned again. Call this
+        from one thread only, usually the message thread */
+    Levels read (bool isInput, int channel);
+
+private:
+    struct Block
+    {
+        float peak;
+        double sumOfSquares;
+        int numSamples;
+    };
+
+    struct Channel
+    {
+        Channel();
+        Atomic<int> subscribers { 0 };
+        AbstractFifo fifo;
+        HeapBlock<Block> blocks;
+        Block overflow;  // held back by the audio thread while the ring is full
+        Levels last;
+    };
+
+    OwnedArray<Channel> inputs, outputs;
+    Atomic<int> numSubscribed { 0 };
+
+    Channel* getChannel (bool isInput, int channel) const noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NodeMeter)
+};
+
+}
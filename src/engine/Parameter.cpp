@@ -168,4 +168,96 @@ ControlPortParameter& ControlPortParameter::operator= (float newValue)
     return *this;
 }
 
+//==============================================================================
+ParameterDispatcher::ParameterDispatcher()
+{
+    for (auto*& page : pages)
+        page = nullptr;
+}
+
+ParameterDispatcher::~ParameterDispatcher()
+{
+    stopTimer();
+}
+
+int ParameterDispatcher::add (ParameterListener* listener)
+{
+    jassert (MessageManager::getInstance()->currentThreadHasLockedMessageManager());
+    int slot = -1;
+
+    if (freeSlots.size() > 0)
+    {
+        slot = freeSlots.removeAndReturn (freeSlots.size() - 1);
+        listeners.set (slot, listener);
+    }
+    else
+    {
+        slot = listeners.size();
+        jassert (slot < maxPages * slotsPerPage);
+
+        if (slot % slotsPerPage == 0)
+        {
+            auto* const page = ownedPages.add (new Page());
+            for (auto& word : page->words)
+                word.store (0);
+            pages [slot / slotsPerPage] = page;
+        }
+
+        listeners.add (listener);
+    }
+
+    if (! isTimerRunning())
+        startTimerHz (framesPerSecond);
+
+    return slot;
+}
+
+void ParameterDispatcher::remove (int slot)
+{
+    jassert (MessageManager::getInstance()->currentThreadHasLockedMessageManager());
+    if (! isPositiveAndBelow (slot, listeners.size()))
+        return;
+
+    getWord (slot).fetch_and (~((uint64) 1 << (slot % 64)));
+    listeners.set (slot, nullptr);
+    freeSlots.add (slot);
+
+    if (freeSlots.size() == listeners.size())
+        stopTimer();
+}
+
+void ParameterDispatcher::markDirty (int slot) noexcept
+{
+    getWord (slot).fetch_or ((uint64) 1 << (slot % 64));
+}
+
+void ParameterDispatcher::timerCallback()
+{
+    const double deadline = Time::getMillisecondCounterHiRes() + budgetMilliseconds;
+    const int numWords = (listeners.size() + 63) / 64;
+
+    for (int i = 0; i < numWords; ++i)
+    {
+        const int wordIndex = (nextWord + i) % numWords;
+        uint64 bits = getWord (wordIndex * 64).exchange (0);
+
+        for (int bit = 0; bits != 0; ++bit, bits >>= 1)
+        {
+            // listeners can be deleted by other listeners' callbacks
+            if ((bits & 1) != 0)
+                if (auto* const listener = listeners [wordIndex * 64 + bit])
+                    listener->handleNewParameterValue();
+        }
+
+        if (Time::getMillisecondCounterHiRes() >= deadline)
+        {
+            // out of time for this frame, pick up from here next time
+            nextWord = wordIndex + 1;
+            return;
+        }
+    }
+
+    nextWord = 0;
+}
+
 }
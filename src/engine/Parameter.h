@@ -345,22 +345,71 @@ private:
     float value { 0.0 };
 };
 
-class ParameterListener : private Parameter::Listener,
-                          private Timer
+class ParameterListener;
+
+/** Delivers parameter changes to ParameterListeners on the message thread.
+
+    Listeners get a slot in a bitset which parameters mark from whatever
+    thread changed them, without locking. A single timer drains the set
+    once per display frame and calls each dirty listener once, no matter
+    how many times its parameter changed in between. If a frame's time
+    budget runs out, the remaining listeners are called on the next frame.
+
+    Listeners share the dispatcher through a SharedResourcePointer, so
+    there's no need to create one.
+ */
+class ParameterDispatcher : private Timer
+{
+public:
+    enum { framesPerSecond = 60, budgetMilliseconds = 8 };
+
+    ParameterDispatcher();
+    ~ParameterDispatcher();
+
+    /** Gives a listener a slot. Call on the message thread */
+    int add (ParameterListener*);
+
+    /** Frees a slot. Call on the message thread */
+    void remove (int slot);
+
+    /** Flags a slot as changed. Can be called from any thread */
+    void markDirty (int slot) noexcept;
+
+private:
+    enum { wordsPerPage = 64, slotsPerPage = wordsPerPage * 64, maxPages = 256 };
+    struct Page { std::atomic<uint64> words [wordsPerPage]; };
+
+    // pages never move once created, so other threads can index them
+    Page* pages [maxPages];
+    OwnedArray<Page> ownedPages;
+
+    Array<ParameterListener*> listeners;
+    Array<int> freeSlots;
+    int nextWord = 0;
+
+    std::atomic<uint64>& getWord (int slot) const noexcept { return pages [slot / slotsPerPage]->words [(slot % slotsPerPage) / 64]; }
+    void timerCallback() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParameterDispatcher)
+};
+
+/** Calls handleNewParameterValue on the message thread after its parameter
+    has changed. Changes are coalesced by the ParameterDispatcher */
+class ParameterListener : private Parameter::Listener
 {
 public:
     ParameterListener (Parameter::Ptr param)
         : parameter (param)
     {
         jassert (parameter != nullptr);
+        slot = dispatcher->add (this);
         parameter->addListener (this);
-        startTimer (100);
     }
 
     ~ParameterListener() override
     {
-        stopTimer();
         parameter->removeListener (this);
+        dispatcher->remove (slot);
         parameter = nullptr;
     }
 
@@ -373,28 +422,16 @@ private:
   
     void controlValueChanged (int, float) override
     {
-        parameterValueHasChanged = 1;
+        dispatcher->markDirty (slot);
     }
 
     void controlTouched (int, bool) override {}
 
     //==============================================================================
 
-    void timerCallback() override
-    {
-        if (parameterValueHasChanged.compareAndSetBool (0, 1))
-        {
-            handleNewParameterValue();
-            startTimerHz (50);
-        }
-        else
-        {
-            startTimer (jmin (250, getTimerInterval() + 10));
-        }
-    }
-
+    SharedResourcePointer<ParameterDispatcher> dispatcher;
     Parameter::Ptr parameter;
-    Atomic<int> parameterValueHasChanged { 0 };
+    int slot = -1;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParameterListener)
 };
@@ -0,0 +1,156 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/RenderBufferPool.h"
+
+namespace Element {
+
+// pooled memory beyond this is given back to the system
+static const size_t maxBytesPooled = 64 * 1024 * 1024;
+
+struct RenderBufferPool::Buffer::Chunk
+{
+    explicit Chunk (const size_t size_)
+        : size (size_)
+    {
+        data.calloc (size + alignment);
+    }
+
+    float* getAlignedData() const noexcept
+    {
+        const auto address = reinterpret_cast<pointer_sized_uint> (data.get());
+        return reinterpret_cast<float*> ((address + alignment - 1) & ~static_cast<pointer_sized_uint> (alignment - 1));
+    }
+
+    HeapBlock<char> data;
+    const size_t size;
+};
+
+//=============================================================================
+RenderBufferPool::Buffer::Buffer (RenderBufferPool& p, Chunk* c, const int nc, const int ns)
+    : pool (&p), chunk (c), numChannels (nc), numSamples (ns)
+{
+    // round each channel up so the next one starts aligned as well
+    const int floatsPerAlignment = alignment / (int) sizeof (float);
+    const int stride = ((numSamples + floatsPerAlignment - 1) / floatsPerAlignment) * floatsPerAlignment;
+
+    channels.calloc ((size_t) jmax (1, numChannels));
+    float* const data = chunk->getAlignedData();
+    for (int i = 0; i < numChannels; ++i)
+        channels[i] = data + (i * stride);
+}
+
+RenderBufferPool::Buffer::~Buffer()
+{
+    pool->release (chunk.release());
+}
+
+//=============================================================================
+RenderBufferPool::RenderBufferPool() { }
+
+RenderBufferPool::~RenderBufferPool()
+{
+    // buffers hold a reference to their pool, so none can be left
+    jassert (numBytesInUse == 0);
+}
+
+std::unique_ptr<RenderBufferPool::Buffer> RenderBufferPool::allocate (int numChannels, int numSamples)
+{
+    numChannels = jmax (1, numChannels);
+    numSamples  = jmax (1, numSamples);
+
+    const size_t floatsPerAlignment = alignment / sizeof (float);
+    const size_t stride = ((size_t) numSamples + floatsPerAlignment - 1) / floatsPerAlignment * floatsPerAlignment;
+    const size_t numBytesNeeded = stride * sizeof (float) * (size_t) numChannels;
+
+    // sizes are rounded up to a power of two so chunks can be swapped
+    // between graphs with slightly different needs
+    size_t size = 4096;
+    while (size < numBytesNeeded)
+        size *= 2;
+
+    Buffer::Chunk* chunk = nullptr;
+
+    {
+        const ScopedLock sl (lock);
+        for (int i = unused.size(); --i >= 0;)
+        {
+            if (unused.getUnchecked(i)->size == size)
+            {
+                chunk = unused.removeAndReturn (i);
+                numBytesPooled -= size;
+                break;
+            }
+        }
+
+        numBytesInUse += size;
+    }
+
+    if (chunk != nullptr)
+        zeromem (chunk->getAlignedData(), numBytesNeeded);
+    else
+        chunk = new Buffer::Chunk (size);
+
+    return std::unique_ptr<Buffer> (new Buffer (*this, chunk, numChannels, numSamples));
+}
+
+void RenderBufferPool::release (Buffer::Chunk* chunk)
+{
+    std::unique_ptr<Buffer::Chunk> deleter;
+
+    {
+        const ScopedLock sl (lock);
+        numBytesInUse -= chunk->size;
+
+        if (numBytesPooled + chunk->size <= maxBytesPooled)
+        {
+            unused.add (chunk);
+            numBytesPooled += chunk->size;
+        }
+        else
+        {
+            deleter.reset (chunk);
+        }
+    }
+}
+
+size_t RenderBufferPool::getNumBytesInUse() const
+{
+    const ScopedLock sl (lock);
+    return numBytesInUse;
+}
+
+size_t RenderBufferPool::getNumBytesPooled() const
+{
+    const ScopedLock sl (lock);
+    return numBytesPooled;
+}
+
+void RenderBufferPool::releaseUnused()
+{
+    OwnedArray<Buffer::Chunk> chunks;
+
+    {
+        const ScopedLock sl (lock);
+        unused.swapWith (chunks);
+        numBytesPooled = 0;
+    }
+}
+
+}
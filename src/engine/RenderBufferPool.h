@@ -0,0 +1,94 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** Aligned memory for graph rendering buffers.
+
+    Graphs take their shared buffers from here whenever a rendering sequence
+    is built, and hand them back when it is retired, so editing and
+    re-preparing graphs re-uses memory instead of going back to the system
+    allocator every time.  One pool is shared by all the graphs in an engine.
+
+    Allocating and releasing takes a lock, so only do it off of the audio
+    thread.
+ */
+class RenderBufferPool : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<RenderBufferPool>;
+
+    /** Every channel starts on a boundary of this many bytes */
+    enum { alignment = 32 };
+
+    /** A set of channels. The memory goes back to the pool when deleted */
+    class Buffer
+    {
+    public:
+        ~Buffer();
+
+        /** Returns the channel pointers, suitable for AudioSampleBuffer::setDataToReferTo */
+        float** getChannels() const noexcept    { return channels.get(); }
+        int getNumChannels() const noexcept     { return numChannels; }
+        int getNumSamples() const noexcept      { return numSamples; }
+
+    private:
+        friend class RenderBufferPool;
+        struct Chunk;
+        Buffer (RenderBufferPool&, Chunk*, int numChannels, int numSamples);
+
+        RenderBufferPool::Ptr pool;
+        std::unique_ptr<Chunk> chunk;
+        HeapBlock<float*> channels;
+        const int numChannels, numSamples;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Buffer)
+    };
+
+    RenderBufferPool();
+    ~RenderBufferPool();
+
+    /** Returns cleared memory for the given number of channels and samples */
+    std::unique_ptr<Buffer> allocate (int numChannels, int numSamples);
+
+    /** Returns the number of bytes handed out in buffers that still exist */
+    size_t getNumBytesInUse() const;
+
+    /** Returns the number of bytes waiting to be re-used */
+    size_t getNumBytesPooled() const;
+
+    /** Frees all memory which isn't being used by a buffer */
+    void releaseUnused();
+
+private:
+    CriticalSection lock;
+    OwnedArray<Buffer::Chunk> unused;
+    size_t numBytesInUse = 0;
+    size_t numBytesPooled = 0;
+
+    void release (Buffer::Chunk*);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderBufferPool)
+};
+
+}
@@ -0,0 +1,293 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <thread>
+#include "engine/RenderThreadPool.h"
+
+#if JUCE_MAC
+ #include <mach/mach.h>
+ #include <mach/mach_time.h>
+ #include <mach/thread_policy.h>
+#endif
+
+namespace Element {
+
+//=============================================================================
+void RenderThreadPool::TaskGraph::reset (const int newNumTasks)
+{
+    jassert (newNumTasks >= 0);
+    numTasks = jmax (0, newNumTasks);
+    maxConcurrency = 1;
+    edges.clearQuick();
+    numDependencies.clearQuick();
+    dependentsStart.clearQuick();
+    dependents.clearQuick();
+    pending.reset();
+    ready.reset();
+}
+
+void RenderThreadPool::TaskGraph::addDependency (const int task, const int dependsOn)
+{
+    jassert (isPositiveAndBelow (task, numTasks));
+    jassert (isPositiveAndBelow (dependsOn, task));
+    if (isPositiveAndBelow (dependsOn, task) && task < numTasks)
+        edges.add ((static_cast<int64> (dependsOn) << 32) | static_cast<int64> (task));
+}
+
+void RenderThreadPool::TaskGraph::finalize()
+{
+    // sorting by source then removing duplicates gives a compact list of
+    // dependents for each task
+    edges.sort();
+    for (int i = edges.size(); --i >= 1;)
+        if (edges.getUnchecked (i) == edges.getUnchecked (i - 1))
+            edges.remove (i);
+
+    numDependencies.insertMultiple (0, 0, numTasks);
+    dependentsStart.insertMultiple (0, 0, numTasks + 1);
+    dependents.ensureStorageAllocated (edges.size());
+
+    for (const auto edge : edges)
+    {
+        const int source = static_cast<int> (edge >> 32);
+        const int dest   = static_cast<int> (edge & 0xffffffff);
+        dependents.add (dest);
+        dependentsStart.getReference (source + 1) += 1;
+        numDependencies.getReference (dest) += 1;
+    }
+
+    for (int i = 1; i <= numTasks; ++i)
+        dependentsStart.getReference (i) += dependentsStart.getUnchecked (i - 1);
+
+    // estimate how wide the graph is by counting the tasks on each level
+    Array<int> levels, tasksPerLevel;
+    levels.insertMultiple (0, 0, numTasks);
+    maxConcurrency = numTasks > 0 ? 1 : 0;
+    for (int task = 0; task < numTasks; ++task)
+    {
+        const int level = levels.getUnchecked (task);
+        while (tasksPerLevel.size() <= level)
+            tasksPerLevel.add (0);
+        tasksPerLevel.getReference (level) += 1;
+        maxConcurrency = jmax (maxConcurrency, tasksPerLevel.getUnchecked (level));
+
+        for (int i = dependentsStart[task]; i < dependentsStart[task + 1]; ++i)
+        {
+            auto& next = levels.getReference (dependents.getUnchecked (i));
+            next = jmax (next, level + 1);
+        }
+    }
+
+    pending.reset (new std::atomic<int> [(size_t) jmax (1, numTasks)]);
+    ready.reset (new std::atomic<int> [(size_t) jmax (1, numTasks)]);
+    for (int i = 0; i < numTasks; ++i)
+    {
+        pending[i].store (0);
+        ready[i].store (-1);
+    }
+}
+
+void RenderThreadPool::TaskGraph::begin (Job& newJob) noexcept
+{
+    job = &newJob;
+    readPos.store (0, std::memory_order_relaxed);
+    writePos.store (0, std::memory_order_relaxed);
+    remaining.store (numTasks, std::memory_order_relaxed);
+
+    for (int i = 0; i < numTasks; ++i)
+    {
+        pending[i].store (numDependencies.getUnchecked (i), std::memory_order_relaxed);
+        ready[i].store (-1, std::memory_order_relaxed);
+    }
+
+    for (int i = 0; i < numTasks; ++i)
+        if (numDependencies.getUnchecked (i) == 0)
+            push (i);
+}
+
+void RenderThreadPool::TaskGraph::push (const int task) noexcept
+{
+    // every task is pushed exactly once per run, so this can never overflow
+    const int pos = writePos.fetch_add (1, std::memory_order_acq_rel);
+    jassert (pos < numTasks);
+    ready[pos].store (task, std::memory_order_release);
+}
+
+int RenderThreadPool::TaskGraph::pop() noexcept
+{
+    int pos = readPos.load (std::memory_order_acquire);
+    while (pos < numTasks)
+    {
+        const int task = ready[pos].load (std::memory_order_acquire);
+        if (task < 0)
+            return -1; // nothing ready yet, or the slot is still being published
+        if (readPos.compare_exchange_weak (pos, pos + 1, std::memory_order_acq_rel))
+            return task;
+    }
+
+    return -1;
+}
+
+void RenderThreadPool::TaskGraph::work() noexcept
+{
+    while (remaining.load (std::memory_order_acquire) > 0)
+    {
+        const int task = pop();
+        if (task < 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        job->runTask (task);
+
+        for (int i = dependentsStart.getUnchecked (task); i < dependentsStart.getUnchecked (task + 1); ++i)
+        {
+            const int dependent = dependents.getUnchecked (i);
+            if (pending[dependent].fetch_sub (1, std::memory_order_acq_rel) == 1)
+                push (dependent);
+        }
+
+        // must come last so nobody leaves while dependents are being queued
+        remaining.fetch_sub (1, std::memory_order_acq_rel);
+    }
+}
+
+//=============================================================================
+class RenderThreadPool::Worker : public Thread
+{
+public:
+    Worker (RenderThreadPool& p, int index)
+        : Thread ("Element: Render " + String (index + 1)),
+          pool (p) { }
+
+    ~Worker()
+    {
+        signalThreadShouldExit();
+        notify();
+        stopThread (1000);
+    }
+
+    void run() override
+    {
+        setTimeConstraintPolicy();
+
+        while (! threadShouldExit())
+        {
+            pool.activeWorkers.fetch_add (1);
+            if (auto* graph = pool.current.load())
+            {
+                ScopedNoDenormals denormals;
+                graph->work();
+            }
+            pool.activeWorkers.fetch_sub (1);
+
+            wait (50);
+        }
+    }
+
+private:
+    RenderThreadPool& pool;
+
+    /** CoreAudio renders on a time constraint thread, a high priority alone
+        would let the system preempt workers the audio thread is waiting on */
+    static void setTimeConstraintPolicy()
+    {
+       #if JUCE_MAC
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info (&timebase);
+        const double ticksPerMs = 1.0e6 * (double) timebase.denom / (double) timebase.numer;
+
+        thread_time_constraint_policy_data_t policy;
+        policy.period       = (uint32_t) (ticksPerMs * 2.9);
+        policy.computation  = (uint32_t) (ticksPerMs * 1.5);
+        policy.constraint   = (uint32_t) (ticksPerMs * 2.9);
+        policy.preemptible  = true;
+        thread_policy_set (pthread_mach_thread_np (pthread_self()), THREAD_TIME_CONSTRAINT_POLICY,
+                           (thread_policy_t) &policy, THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+       #endif
+    }
+};
+
+//=============================================================================
+RenderThreadPool::RenderThreadPool (const int numThreads)
+{
+    setNumThreads (numThreads);
+}
+
+RenderThreadPool::~RenderThreadPool()
+{
+    setNumThreads (0);
+}
+
+void RenderThreadPool::setNumThreads (const int numThreads)
+{
+    // take ownership so the audio thread falls back to rendering by itself
+    // while threads are being started or stopped
+    bool expected = false;
+    while (! busy.compare_exchange_weak (expected, true))
+    {
+        expected = false;
+        Thread::yield();
+    }
+
+    workers.clear();
+    for (int i = 0; i < jmax (0, numThreads); ++i)
+    {
+        auto* worker = workers.add (new Worker (*this, i));
+        worker->startThread (Thread::realtimeAudioPriority);
+    }
+
+    busy.store (false);
+}
+
+bool RenderThreadPool::run (Job& job, TaskGraph& graph) noexcept
+{
+    if (graph.getNumTasks() <= 0)
+        return false;
+
+    bool expected = false;
+    if (! busy.compare_exchange_strong (expected, true))
+        return false;
+
+    if (workers.isEmpty())
+    {
+        busy.store (false);
+        return false;
+    }
+
+    graph.begin (job);
+    current.store (&graph);
+
+    // notify() signals a WaitableEvent, which briefly takes its mutex
+    for (auto* worker : workers)
+        worker->notify();
+
+    graph.work();
+
+    // make sure no worker is still looking at the graph before returning
+    current.store (nullptr);
+    while (activeWorkers.load() > 0)
+        std::this_thread::yield();
+
+    busy.store (false);
+    return true;
+}
+
+}
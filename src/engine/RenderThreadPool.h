@@ -0,0 +1,127 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include <atomic>
+#include "ElementApp.h"
+
+namespace Element {
+
+/** A fixed set of realtime priority threads which help the audio callback
+    render independent work concurrently.
+
+    The audio thread hands a TaskGraph to run() and then takes part in
+    executing it until every task has completed.  Nothing in run() allocates.
+    Waking the workers does take a lock: each one waits on a WaitableEvent,
+    and signalling it locks the event's mutex. A worker only holds that mutex
+    briefly while going into or out of its wait, but the audio thread can
+    still block on it for that long.
+ */
+class RenderThreadPool
+{
+public:
+    /** Something which can perform the tasks of a TaskGraph */
+    struct Job
+    {
+        virtual ~Job() { }
+        virtual void runTask (int taskIndex) = 0;
+    };
+
+    /** A set of tasks and the dependencies between them.
+
+        Build these off of the audio thread.  The runtime counters are stored
+        in here too, so a task graph can only be run by one thread at a time.
+     */
+    class TaskGraph
+    {
+    public:
+        TaskGraph() = default;
+        ~TaskGraph() = default;
+
+        /** Clears all dependencies and sets the number of tasks */
+        void reset (int numTasks);
+
+        /** Makes 'task' wait for 'dependsOn' to finish. dependsOn must come
+            before task */
+        void addDependency (int task, int dependsOn);
+
+        /** Call this after all dependencies have been added. Allocates the
+            runtime storage needed by run() */
+        void finalize();
+
+        /** Returns the number of tasks */
+        int getNumTasks() const noexcept                { return numTasks; }
+
+        /** Returns the largest number of tasks which can run at the same time */
+        int getMaxConcurrency() const noexcept          { return maxConcurrency; }
+
+        /** Returns true if running this on a pool would do any good */
+        bool isWorthRunningInParallel() const noexcept  { return maxConcurrency > 1; }
+
+    private:
+        friend class RenderThreadPool;
+        int numTasks = 0;
+        int maxConcurrency = 1;
+        Array<int64> edges;
+        Array<int> numDependencies, dependentsStart, dependents;
+
+        Job* job = nullptr;
+        std::unique_ptr<std::atomic<int>[]> pending;
+        std::unique_ptr<std::atomic<int>[]> ready;
+        std::atomic<int> readPos  { 0 };
+        std::atomic<int> writePos { 0 };
+        std::atomic<int> remaining { 0 };
+
+        void begin (Job&) noexcept;
+        void push (int task) noexcept;
+        int pop() noexcept;
+        void work() noexcept;
+    };
+
+    /** Creates a pool with the given number of worker threads */
+    explicit RenderThreadPool (int numThreads = 0);
+    ~RenderThreadPool();
+
+    /** Change the number of worker threads. This will wait for a job in
+        progress to finish. Don't call from the audio thread. */
+    void setNumThreads (int numThreads);
+
+    /** Returns the number of worker threads, not counting the caller of run() */
+    int getNumThreads() const noexcept { return workers.size(); }
+
+    /** Runs every task in the graph and returns when all are done.
+
+        Returns false without doing anything if the pool has no threads, or is
+        already running another job (e.g. a nested graph).  In that case the
+        caller should perform the work itself.
+     */
+    bool run (Job& job, TaskGraph& graph) noexcept;
+
+private:
+    class Worker;
+    OwnedArray<Worker> workers;
+    std::atomic<TaskGraph*> current { nullptr };
+    std::atomic<int> activeWorkers { 0 };
+    std::atomic<bool> busy { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderThreadPool)
+};
+
+}
@@ -22,6 +22,10 @@
 namespace Element
 {
 
+/** Tempo changes closer than this to the start of a piece of a block wait
+    until the piece ends. Every piece costs a pass through the graphs */
+static const int64 minFramesPerPiece = 16;
+
 Transport::Transport()
     : playState (false),
       recordState (false)
@@ -42,6 +46,17 @@ Transport::~Transport() { }
 
 void Transport::preProcess (int nframes)
 {
+    {
+        // the previous map goes to nextMap, so it's never freed here
+        SpinLock::ScopedTryLockType sl (mapLock);
+        if (sl.isLocked() && mapChanged)
+        {
+            std::swap (map, nextMap);
+            activeMap.store (map.get());
+            mapChanged = false;
+        }
+    }
+
     if (recording != recordState.get()) {
         recording = recordState.get();
     }
@@ -57,7 +72,23 @@ void Transport::preProcess (int nframes)
 
 void Transport::postProcess (int nframes)
 {
-    if (getTempo() != nextTempo.get())
+    int beatsPerBar = nextBeatsPerBar.get();
+    int beatDivisor = nextBeatDivisor.get();
+
+    if (map != nullptr)
+    {
+        // the map decides the tempo and meter while there is one
+        const auto& segment = map->getSegment (map->indexOfFrame ((double) getPositionFrames()));
+        if (getTempo() != segment.bpm)
+        {
+            setTempo (segment.bpm);
+            monitor->tempo.set (getTempo());
+        }
+
+        beatsPerBar = segment.beatsPerBar;
+        beatDivisor = segment.beatDivisor;
+    }
+    else if (getTempo() != nextTempo.get())
     {
         setTempo (nextTempo.get());
         nextTempo.set (getTempo());
@@ -69,22 +100,29 @@ void Transport::postProcess (int nframes)
     monitor->positionFrames.set (getPositionFrames());
     
     bool updateTimeScale = false;
-    if (getBeatsPerBar() != nextBeatsPerBar.get())
+    if (getBeatsPerBar() != beatsPerBar)
     {
-        ts.setBeatsPerBar ((unsigned short) nextBeatsPerBar.get());
+        ts.setBeatsPerBar ((unsigned short) beatsPerBar);
         monitor->beatsPerBar.set (getBeatsPerBar());
         updateTimeScale = true;
     }
     
-    if (ts.beatDivisor() != nextBeatDivisor.get())
+    if (ts.beatDivisor() != beatDivisor)
     {
-        ts.setBeatDivisor ((unsigned short) nextBeatDivisor.get());
-        monitor->beatDivisor.set (nextBeatDivisor.get());
+        ts.setBeatDivisor ((unsigned short) beatDivisor);
+        monitor->beatDivisor.set (beatDivisor);
         updateTimeScale = true;
     }
     
     if (updateTimeScale)
         ts.updateScale();
+
+    const double beat = seekBeat.exchange (-1.0);
+    if (beat >= 0.0 && map != nullptr)
+    {
+        seekFrame.set ((int64) map->beatToFrame (beat));
+        seekWanted.set (true);
+    }
     
     if (seekWanted.get())
     {
@@ -110,4 +148,48 @@ void Transport::requestAudioFrame (const int64 frame)
     seekWanted.set (true);
 }
 
+void Transport::requestBeat (const double beat)
+{
+    seekBeat.set (jmax (0.0, beat));
+}
+
+void Transport::setTempoMap (TempoTable::Ptr newMap)
+{
+    {
+        SpinLock::ScopedLockType sl (mapLock);
+        std::swap (nextMap, newMap);
+        mapChanged = true;
+    }
+
+    // newMap now holds what nextMap held, which may be the map the audio
+    // thread just stopped using. It's released outside the lock, once no
+    // reader could still be looking at it
+    while (numMapReaders.load() > 0)
+        Thread::yield();
+    newMap = nullptr;
+}
+
+int Transport::getFramesUntilTempoChange (int nframes) const
+{
+    if (map == nullptr || ! playing)
+        return nframes;
+
+    const auto frame = getPositionFrames();
+    const auto next  = map->getNextChange (frame);
+    return next < 0 ? nframes : (int) jmin ((int64) nframes, jmax (minFramesPerPiece, next - frame));
+}
+
+bool Transport::getCurrentPosition (CurrentPositionInfo& result)
+{
+    const bool ok = Shuttle::getCurrentPosition (result);
+
+    // plugins can ask from any thread
+    ++numMapReaders;
+    if (auto* const table = activeMap.load())
+        table->getPosition (getPositionFrames(), result);
+    --numMapReaders;
+
+    return ok;
+}
+
 }
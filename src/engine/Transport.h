@@ -20,6 +20,7 @@
 #pragma once
 
 #include "ElementApp.h"
+#include "session/TempoMap.h"
 
 namespace Element
 {
@@ -86,6 +87,23 @@ namespace Element
         
         void requestAudioFrame (const int64 frame);
 
+        /** Seeks to a position in quarter notes. Does nothing without a tempo map */
+        void requestBeat (const double beat);
+
+        /** Sets the tempo map to follow, or nullptr to use the requested tempo
+            and meter. Call from outside the audio callback */
+        void setTempoMap (TempoTable::Ptr newMap);
+
+        /** Returns how many of the next frames render before the tempo map
+            changes, at most nframes. Changes very close to the current
+            position may be applied a few frames late. Call on the audio
+            thread */
+        int getFramesUntilTempoChange (int nframes) const;
+
+        /** Reports the tempo map's tempo, meter and ppq position, if there is
+            one. Safe to call from any thread */
+        bool getCurrentPosition (CurrentPositionInfo& result) override;
+
         void preProcess (int nframes);
         void postProcess (int nframes);
 
@@ -98,6 +116,13 @@ namespace Element
         
         Atomic<bool> seekWanted;
         AtomicValue<int64> seekFrame;
+        Atomic<double> seekBeat { -1.0 };
+
+        SpinLock mapLock;
+        TempoTable::Ptr map, nextMap;
+        bool mapChanged = false;
+        std::atomic<TempoTable*> activeMap { nullptr };
+        std::atomic<int> numMapReaders { 0 };
         
         MonitorPtr monitor;
     };
@@ -364,8 +364,7 @@ void AudioFilePlayerNode::fillInPluginDescription (PluginDescription& desc) cons
 void AudioFilePlayerNode::clearPlayer()
 {
     player.setSource (nullptr);
-    if (reader)
-        reader = nullptr;
+    stream = nullptr;
     *playing = player.isPlaying();
 }
 
@@ -373,35 +372,29 @@ void AudioFilePlayerNode::openFile (const File& file)
 {
     if (file == audioFile)
         return;
-    if (auto* newReader = formats.createReaderFor (file))
-    {
-        clearPlayer();
-        reader.reset (new AudioFormatReaderSource (newReader, true));
-        audioFile = file;
-        player.setSource (reader.get(), 1024 * 8, &thread, 
-                          newReader->sampleRate, 2);
-
-        ScopedLock sl (getCallbackLock());
-        reader->setLooping (*looping);
-        player.setLooping (*looping);
-    }
+
+    // only the header is read here. the new stream is prepared before the
+    // player swaps it in under its own lock, so the render thread never
+    // waits on the disk
+    std::unique_ptr<AudioFileStream> newStream (streamer->createStream (file, readAhead.get()));
+    if (newStream == nullptr)
+        return;
+
+    newStream->setLooping (*looping);
+    player.setSource (newStream.get(), 0, nullptr, newStream->getSampleRate(), 2);
+    stream.swap (newStream);
+    audioFile = file;
+    *playing = player.isPlaying();
 }
 
 void AudioFilePlayerNode::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
 {
-    thread.startThread();
-    formats.registerBasicFormats();
     player.prepareToPlay (maximumExpectedSamplesPerBlock, sampleRate);
 
-    if (reader)
+    if (stream)
     {
-        double readerSampleRate = sampleRate;
-        if (auto* fmtReader = reader->getAudioFormatReader())
-            readerSampleRate = fmtReader->sampleRate;
-
-        reader->setLooping (*looping);
-        player.setLooping (*looping);
-        player.setSource (reader.get(), 1024 * 8, &thread, readerSampleRate, 2);
+        stream->setLooping (*looping);
+        player.setSource (stream.get(), 0, nullptr, stream->getSampleRate(), 2);
         player.setPosition (jmax (0.0, lastTransportPos));
         if (wasPlaying)
             player.start();
@@ -420,8 +413,6 @@ void AudioFilePlayerNode::releaseResources()
     player.stop();
     player.releaseResources();
     player.setSource (nullptr);
-    formats.clearFormats();
-    thread.stopThread (14);
 }
 
 void AudioFilePlayerNode::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi)
@@ -534,6 +525,7 @@ void AudioFilePlayerNode::getStateInformation (juce::MemoryBlock& destData)
          .setProperty ("playing", (bool)*playing, nullptr)
          .setProperty ("slave", (bool)*slave, nullptr)
          .setProperty ("loop", (bool)*looping, nullptr)
+         .setProperty ("readAhead", readAhead.get(), nullptr)
          .setProperty ("midiStartStopContinue", midiStartStopContinue.get() == 1, nullptr);
     
     if (watchDir.exists())
@@ -548,6 +540,7 @@ void AudioFilePlayerNode::setStateInformation (const void* data, int sizeInBytes
     const auto state = ValueTree::readFromData (data, (size_t) sizeInBytes);
     if (state.isValid())
     {
+        setReadAheadSamples ((int) state.getProperty ("readAhead", (int) DiskStreamer::defaultReadAhead));
         if (File::isAbsolutePath (state["audioFile"].toString()))
             openFile (File (state["audioFile"].toString()));
         *playing = (bool) state.getProperty ("playing", false);
@@ -589,11 +582,8 @@ void AudioFilePlayerNode::parameterValueChanged (int parameter, float newValue)
 
         case Looping:
         {
-            if (reader != nullptr)
-            {
+            if (stream != nullptr)
                 player.setLooping (*looping);
-                reader->setLooping (*looping);
-            }
         } break;
     }
 }
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "engine/nodes/BaseProcessor.h"
+#include "engine/DiskStreamer.h"
 #include "Signals.h"
 
 namespace Element {
@@ -35,7 +36,7 @@ public:
     AudioFilePlayerNode ();
     virtual ~AudioFilePlayerNode();
 
-    AudioFormatManager& getAudioFormatManager() { return formats; }
+    AudioFormatManager& getAudioFormatManager() { return streamer->getFormats(); }
     void setWatchDir (const File& newWatchDir) { watchDir = newWatchDir; jassert (newWatchDir.isDirectory()); }
     File getWatchDir() const { return watchDir; }
 
@@ -46,13 +47,13 @@ public:
 
     void openFile (const File& file);
     const File& getAudioFile() const { return audioFile; }
-    String getWildcard() const { return formats.getWildcardForAllFormats(); }
-    
-    bool canLoad (const File& file)
-    {
-        std::unique_ptr<AudioFormatReader> reader (formats.createReaderFor (file));
-        return reader != nullptr;
-    }
+    String getWildcard() const { return streamer->getFormats().getWildcardForAllFormats(); }
+    bool canLoad (const File& file) { return streamer->canLoad (file); }
+
+    /** Sets how many samples are buffered ahead of the play position.
+        Takes effect the next time a file is opened */
+    void setReadAheadSamples (int numSamples) { readAhead.set (jmax (1024, numSamples)); }
+    int getReadAheadSamples() const { return readAhead.get(); }
 
     void fillInPluginDescription (PluginDescription& desc) const override;
 
@@ -127,10 +128,10 @@ protected:
 #endif
 
 private:
-    TimeSliceThread thread { "MediaPlayer" };
-    std::unique_ptr<AudioFormatReaderSource> reader;
-    AudioFormatManager formats;
+    SharedResourcePointer<DiskStreamer> streamer;
+    std::unique_ptr<AudioFileStream> stream;
     AudioTransportSource player;
+    Atomic<int> readAhead { DiskStreamer::defaultReadAhead };
 
     AudioParameterBool*   slave     { nullptr };
     AudioParameterBool* playing     { nullptr };
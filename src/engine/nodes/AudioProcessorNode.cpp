@@ -142,13 +142,20 @@ void AudioProcessorNode::EnablementUpdater::handleAsyncUpdate()
     node.setEnabled (! node.isEnabled());
 }
 
+void AudioProcessorNode::LatencyWatcher::audioProcessorChanged (AudioProcessor* processor)
+{
+    node.setLatencySamples (processor->getLatencySamples());
+}
+
 AudioProcessorNode::AudioProcessorNode (uint32 nodeId, AudioProcessor* processor)
     : GraphNode (nodeId),
-      enablement (*this)
+      enablement (*this),
+      latencyWatcher (*this)
 {
     proc = processor;
     jassert (proc != nullptr);
     setLatencySamples (proc->getLatencySamples());
+    proc->addListener (&latencyWatcher);
     setName (proc->getName());
     
     for (auto* param : proc->getParameters())
@@ -168,6 +175,7 @@ AudioProcessorNode::~AudioProcessorNode()
 {
     params.clear();
     enablement.cancelPendingUpdate();
+    proc->removeListener (&latencyWatcher);
     pluginState.reset();
     proc = nullptr;
 }
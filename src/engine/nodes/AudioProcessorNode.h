@@ -60,6 +60,16 @@ private:
         AudioProcessorNode& node;
     } enablement;
 
+    /** Picks up latency changes reported by the plugin */
+    struct LatencyWatcher : public AudioProcessorListener
+    {
+        LatencyWatcher (AudioProcessorNode& n) : node (n) { }
+        ~LatencyWatcher() { }
+        void audioProcessorParameterChanged (AudioProcessor*, int, float) override { }
+        void audioProcessorChanged (AudioProcessor*) override;
+        AudioProcessorNode& node;
+    } latencyWatcher;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioProcessorNode);
 };
 
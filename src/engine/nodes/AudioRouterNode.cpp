@@ -29,18 +29,19 @@ AudioRouterNode::AudioRouterNode (int ins, int outs)
     : GraphNode (0),
       numSources (ins),
       numDestinations (outs),
-      state (ins, outs),
-      toggles (ins, outs),
-      nextToggles (ins, outs)
+      state (ins, outs)
 {
     jassert (metadata.hasType (Tags::node));
     metadata.setProperty (Tags::format, "Element", nullptr);
     metadata.setProperty (Tags::identifier, EL_INTERNAL_ID_AUDIO_ROUTER, nullptr);
     
-    fadeIn.setFadesIn (true);
-    fadeIn.setLength (fadeLengthSeconds);
-    fadeOut.setFadesIn (false);
-    fadeOut.setLength (fadeLengthSeconds);
+    // reserve everything up front so neither publishing nor rendering
+    // ever grows a route list
+    const auto maxRoutes = static_cast<size_t> (ins * outs);
+    for (auto& list : routeLists)
+        list.reserve (maxRoutes);
+    routes.reserve (maxRoutes);
+    mergedRoutes.reserve (maxRoutes);
 
     clearPatches();
 
@@ -83,6 +84,12 @@ AudioRouterNode::AudioRouterNode (int ins, int outs)
 
 AudioRouterNode::~AudioRouterNode() { }
 
+void AudioRouterNode::prepareToRender (double newSampleRate, int maxBufferSize)
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    tempAudio.setSize (jmax (numSources, numDestinations), jmax (1, maxBufferSize), false, false, true);
+}
+
 void AudioRouterNode::setCurrentProgram (int index)
 {
     if (auto* program = programs [index])
@@ -95,13 +102,11 @@ void AudioRouterNode::setCurrentProgram (int index)
 void AudioRouterNode::setMatrixState (const MatrixState& matrix)
 {
     jassert (state.sameSizeAs (matrix));
-    state = matrix;
-    ToggleGrid newPatches (state);
 
     {
         ScopedLock sl (getLock());
-        nextToggles.swapWith (newPatches);
-        togglesChanged = true; // initiate the crossfade
+        state = matrix;
+        publishRoutes(); // the audio thread crossfades to these
     }
 
     sendChangeMessage();
@@ -112,6 +117,52 @@ MatrixState AudioRouterNode::getMatrixState() const
     return state;
 }
 
+void AudioRouterNode::publishRoutes()
+{
+    auto& list = routeLists [writeIndex];
+    list.clear();
+
+    for (int i = 0; i < numSources; ++i)
+        for (int j = 0; j < numDestinations; ++j)
+            if (state.connected (i, j))
+                list.push_back ({ i, j, 1.f, 1.f });
+
+    writeIndex = middleIndex.exchange (writeIndex | newRoutesBit, std::memory_order_acq_rel) & indexMask;
+}
+
+void AudioRouterNode::applyRoutes (const RouteList& patched)
+{
+    // merge the new patches with whatever is still sounding. Existing routes
+    // keep their current gain so a change during a fade picks up from where
+    // the last one left off
+    mergedRoutes.clear();
+    auto current = routes.cbegin();
+    auto next    = patched.cbegin();
+
+    while (current != routes.cend() || next != patched.cend())
+    {
+        if (next == patched.cend() || (current != routes.cend() && 
+            (current->source < next->source || (current->source == next->source && current->dest < next->dest))))
+        {
+            mergedRoutes.push_back ({ current->source, current->dest, current->gain, 0.f });
+            ++current;
+        }
+        else if (current == routes.cend() || next->source != current->source || next->dest != current->dest)
+        {
+            mergedRoutes.push_back ({ next->source, next->dest, 0.f, 1.f });
+            ++next;
+        }
+        else
+        {
+            mergedRoutes.push_back ({ current->source, current->dest, current->gain, 1.f });
+            ++current;
+            ++next;
+        }
+    }
+
+    routes.swap (mergedRoutes);
+}
+
 void AudioRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
     jassert (midi.getNumBuffers() == 1);
@@ -135,123 +186,56 @@ void AudioRouterNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
     tempAudio.setSize (numChannels, numFrames, false, false, true);
     tempAudio.clear (0, numFrames);
 
-    if (togglesChanged)
+    if ((middleIndex.load (std::memory_order_acquire) & newRoutesBit) != 0)
     {
-        fadeIn.reset();
-        fadeIn.startFading();
-        fadeOut.reset();
-        fadeOut.startFading();
-        togglesChanged = false;
+        readIndex = middleIndex.exchange (readIndex, std::memory_order_acq_rel) & indexMask;
+        applyRoutes (routeLists [readIndex]);
         TRACE_AUDIO_ROUTER("fade start");
     }
 
-    if (fadeIn.isActive() || fadeOut.isActive())
+    const float fadeStep = static_cast<float> (1.0 / (fadeLengthSeconds.load (std::memory_order_relaxed) * sampleRate));
+    bool anySilent = false;
+
+    for (auto& route : routes)
     {
-        auto framesToProcess = numFrames;
-        int frame = 0;
-        ScopedLock sl (lock);
-        
-        float fadeInGain  = 0.0f;
-        float fadeOutGain = 1.0f;
-
-        while (--framesToProcess >= 0)
+        if (route.source >= numChannels || route.dest >= numChannels)
+            continue;
+
+        const float* const input = audio.getReadPointer (route.source);
+
+        if (route.gain == route.target)
         {
-            fadeInGain  = fadeIn.isActive()  ? fadeIn.getNextEnvelopeValue()  : 1.0f;
-            fadeOutGain = fadeOut.isActive() ? fadeOut.getNextEnvelopeValue() : 0.0f;
-
-            if (!fadeIn.isActive() && !fadeOut.isActive())
-            {
-                TRACE_AUDIO_ROUTER("last frame fade in gain  : " << fadeInGain);
-                TRACE_AUDIO_ROUTER("last frame fade out gain : " << fadeOutGain);
-            }
-
-            for (int i = 0; i < numSources; ++i)
-            {
-                for (int j = 0; j < numDestinations; ++j)
-                {
-                    if (toggles.get (i, j) && nextToggles.get (i, j))
-                    {
-                        // no patch change and on means 1 to 1 mix
-                        tempAudio.getWritePointer(j)[frame] += 
-                            audio.getReadPointer(i)[frame];
-                    }
-                    else if (! toggles.get (i, j) && ! nextToggles.get (i, j))
-                    {
-                        // no patch change and off means no fade and zero'd
-                        tempAudio.getWritePointer(j)[frame] += 0.0f;
-                    }
-                    else if (!toggles.get (i, j) && nextToggles.get (i, j))
-                    {
-                        tempAudio.getWritePointer(j)[frame] += 
-                            (audio.getReadPointer(i)[frame] * fadeInGain);
-                    }
-                    else if (toggles.get (i, j) && !nextToggles.get (i, j))
-                    {
-                        tempAudio.getWritePointer(j)[frame] += 
-                            (audio.getReadPointer(i)[frame] * fadeOutGain);
-                    }
-                }
-            }
-
-            ++frame;
-
-            if (!fadeIn.isActive() && !fadeOut.isActive())
-                break;
+            // steady route: unity gain if patched, nothing if faded out
+            if (route.gain > 0.f)
+                tempAudio.addFrom (route.dest, 0, input, numFrames);
+            else
+                anySilent = true;
+            continue;
         }
 
-        if (!fadeOut.isActive() && !fadeIn.isActive())
+        const float distance = std::abs (route.target - route.gain);
+        const int rampFrames = jlimit (1, numFrames, static_cast<int> (std::ceil (distance / fadeStep)));
+        const float endGain = route.target > route.gain
+            ? jmin (route.target, route.gain + fadeStep * static_cast<float> (numFrames))
+            : jmax (route.target, route.gain - fadeStep * static_cast<float> (numFrames));
+
+        tempAudio.addFromWithRamp (route.dest, 0, input, rampFrames, route.gain, endGain);
+        route.gain = endGain;
+
+        if (route.gain == route.target)
         {
-            TRACE_AUDIO_ROUTER("fade stopped @ frame: " << (frame));
-            TRACE_AUDIO_ROUTER("fade in level  : " << fadeInGain);
-            TRACE_AUDIO_ROUTER("fade out level : " << fadeOutGain);
-
-            if (framesToProcess > 0)
-            {
-                TRACE_AUDIO_ROUTER("rendering " << framesToProcess << " remainging frames");
-                for (int i = 0; i < numSources; ++i)
-                {
-                    for (int j = 0; j < numDestinations; ++j)
-                    {
-                        if (toggles.get(i, j) && nextToggles.get (i, j))
-                        {
-                            // no patch change and on means 1 to 1 mix
-                            tempAudio.addFrom (j, frame, audio.getReadPointer (i, frame), 
-                                               framesToProcess);
-                        }
-                        else if (! toggles.get (i, j) && ! nextToggles.get (i, j))
-                        {
-                            // patch not changed and of, so clear the out channel.
-                            // nothing to do
-                        }
-                        else if (!toggles.get (i, j) && nextToggles.get (i, j))
-                        {
-                            tempAudio.addFromWithRamp (j, frame, audio.getReadPointer (i, frame), 
-                                                          framesToProcess, fadeInGain, 1.0f);
-                        }
-                        else if (toggles.get (i, j) && !nextToggles.get (i, j))
-                        {
-                            tempAudio.addFromWithRamp (j, frame, audio.getReadPointer (i, frame),
-                                                          framesToProcess, fadeOutGain, 0.0f);
-                        }
-                        else
-                        {
-                            // this would be an unhandled fading scenario
-                            jassertfalse;
-                        }
-                    }
-                }
-            }
-
-            toggles.swapWith (nextToggles);
+            TRACE_AUDIO_ROUTER("fade stopped @ frame: " << rampFrames);
+            if (route.gain > 0.f && rampFrames < numFrames)
+                tempAudio.addFrom (route.dest, rampFrames, input + rampFrames, numFrames - rampFrames);
+            anySilent |= route.gain <= 0.f;
         }
     }
-    else
+
+    if (anySilent)
     {
-        ScopedLock sl (lock);
-        for (int i = 0; i < numSources; ++i)
-            for (int j = 0; j < numDestinations; ++j)
-                if (toggles.get (i, j))
-                    tempAudio.addFrom (j, 0, audio, i, 0, numFrames);
+        // drop routes that finished fading out. Erasing never reallocates
+        routes.erase (std::remove_if (routes.begin(), routes.end(), 
+            [](const Route& r) { return r.gain <= 0.f && r.target <= 0.f; }), routes.end());
     }
 
     for (int c = 0; c < numChannels; ++c)
@@ -281,28 +265,24 @@ void AudioRouterNode::setState (const void* data, int sizeInBytes)
 void AudioRouterNode::setWithoutLocking (int src, int dst, bool set)
 {
     jassert (src >= 0 && src < numSources && dst >= 0 && dst < numDestinations);
-    toggles.set (src, dst, set);
     state.set (src, dst, set);
+    publishRoutes();
 }
 
 void AudioRouterNode::set (int src, int dst, bool patched)
 {
-    jassert (src >= 0 && src < numSources && dst >= 0 && numDestinations < 4);
-    toggles.set (src, dst, patched);
-    state.set (src, dst, patched);
+    jassert (src >= 0 && src < numSources && dst >= 0 && dst < numDestinations);
+    ScopedLock sl (getLock());
+    setWithoutLocking (src, dst, patched);
 }
 
 void AudioRouterNode::clearPatches()
 {
-    {
-        ScopedLock sl (getLock());
-        toggles.clear();
-        nextToggles.clear();
-    }
-
+    ScopedLock sl (getLock());
     for (int r = 0; r < state.getNumRows(); ++r)
         for (int c = 0; c < state.getNumColumns(); ++c)
             state.set (r, c, false);
+    publishRoutes();
 }
 
 }
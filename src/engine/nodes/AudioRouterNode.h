@@ -20,8 +20,6 @@
 #pragma once
 
 #include "engine/GraphNode.h"
-#include "engine/LinearFade.h"
-#include "engine/ToggleGrid.h"
 #include "engine/nodes/BaseProcessor.h"
 
 namespace Element {
@@ -33,7 +31,7 @@ public:
     explicit AudioRouterNode (int ins = 4, int outs = 4);
     ~AudioRouterNode();
 
-    void prepareToRender (double sampleRate, int maxBufferSize) override { ignoreUnused (sampleRate, maxBufferSize); }
+    void prepareToRender (double sampleRate, int maxBufferSize) override;
     void releaseResources() override { }
 
     inline bool wantsMidiPipe() const override { return true; }
@@ -43,7 +41,10 @@ public:
 
     void setMatrixState (const MatrixState&);
     MatrixState getMatrixState() const;
+    /** Changes one patch. The caller must hold getLock() */
     void setWithoutLocking (int src, int dst, bool set);
+
+    /** This lock serializes patch changes. The audio thread never takes it */
     CriticalSection& getLock() { return lock; }
 
     int getNumPrograms() const override { return jmax (1, programs.size()); }
@@ -58,11 +59,7 @@ public:
 
     void setFadeLength (double seconds)
     {
-        seconds = jlimit (0.001, 5.0, seconds);
-        ScopedLock sl (lock);
-        fadeLengthSeconds = seconds;
-        fadeIn.setLength (static_cast<float> (fadeLengthSeconds));
-        fadeOut.setLength (static_cast<float> (fadeLengthSeconds));
+        fadeLengthSeconds.store (jlimit (0.001, 5.0, seconds));
     }
 
     void getPluginDescription (PluginDescription& desc) const override
@@ -124,12 +121,36 @@ private:
     // used by the UI, but not the rendering
     MatrixState state;
 
-    double fadeLengthSeconds { 0.001 }; // 1 ms
-    LinearFade fadeIn;
-    LinearFade fadeOut;
-    ToggleGrid toggles;
-    ToggleGrid nextToggles;
-    bool togglesChanged { false };
+    /** A patch between one input and one output channel. Routes are kept
+        sorted by source then destination. Published routes always have
+        unity gain, rendered routes ramp towards their target gain */
+    struct Route
+    {
+        int source, dest;
+        float gain, target;
+    };
+
+    using RouteList = std::vector<Route>;
+
+    // The patched routes are handed to the audio thread through a triple
+    // buffer so neither side ever waits on the other. The message thread
+    // fills routeLists[writeIndex] under the lock, then swaps it with the
+    // middle slot. The audio thread picks up the middle slot when it's
+    // marked as new.
+    enum { indexMask = 3, newRoutesBit = 4 };
+    RouteList routeLists [3];
+    int writeIndex = 0;
+    int readIndex = 1;
+    std::atomic<int> middleIndex { 2 };
+
+    // only touched in render
+    RouteList routes, mergedRoutes;
+    double sampleRate { 44100.0 };
+
+    std::atomic<double> fadeLengthSeconds { 0.001 }; // 1 ms
+
+    void publishRoutes();
+    void applyRoutes (const RouteList&);
 };
 
 }
@@ -25,6 +25,7 @@
 #include "engine/nodes/LuaNode.h"
 #include "engine/MidiPipe.h"
 #include "engine/Parameter.h"
+#include "scripting/LuaAllocator.h"
 #include "scripting/LuaBindings.h"
 
 #define EL_LUA_DBG(x)
@@ -183,6 +184,7 @@ private:
 struct LuaNode::Context
 {
     explicit Context ()
+        : state (sol::default_at_panic, LuaAllocator::allocate, &allocator)
     { 
         L = state.lua_state();
     }
@@ -261,6 +263,10 @@ struct LuaNode::Context
             addParameters();
             auto param = state["Param"].get_or_create<sol::table>();
             param["values"] = &paramData;
+
+            // from here on the collector only runs in bounded steps after
+            // each block, never in the middle of node_render
+            lua_gc (L, LUA_GCSTOP, 0);
         }
         else
         {
@@ -369,9 +375,12 @@ struct LuaNode::Context
         {
             lrt_midi_pipe_resize (L, midiPipe, nmidi);
             lrt_midi_pipe_clear (midiPipe, -1);
+            midiPipeSize = nmidi;
         }
 
         state.collect_garbage();
+        allocator.reserve (jmax ((size_t) LuaAllocator::chunkSize, allocator.getNumBytesInUse()));
+        maxBlockBytes = 0;
     }
 
     void release()
@@ -391,6 +400,7 @@ struct LuaNode::Context
         if (midiPipe != nullptr)
         {
             lrt_midi_pipe_resize (L, midiPipe, 0);
+            midiPipeSize = 0;
         }
 
         state.collect_garbage();
@@ -404,6 +414,7 @@ struct LuaNode::Context
         const auto nchans  = audio.getNumChannels();
         const auto nframes = audio.getNumSamples();
         const auto nmidi   = midi.getNumBuffers();
+        const auto totalBytesBefore = allocator.getTotalBytesAllocated();
 
         if (lua_rawgeti (L, LUA_REGISTRYINDEX, renderRef) == LUA_TFUNCTION)
         {
@@ -411,17 +422,25 @@ struct LuaNode::Context
             {
                 if (lua_rawgeti (L, LUA_REGISTRYINDEX, midiPipeRef) == LUA_TUSERDATA)
                 {
-                   #if ! LRT_FORCE_FLOAT32
-                    lrt_audio_buffer_duplicate_32 (audioBuffer,
-                        audio.getArrayOfReadPointers(), nchans, nframes);
-                   #else
+                   #if LRT_FORCE_FLOAT32
+                    // the script works directly on the graph's channels
                     lrt_audio_buffer_refer_to (audioBuffer,
                         audio.getArrayOfWritePointers(), nchans, nframes);
+                   #else
+                    lrt_audio_buffer_duplicate_32 (audioBuffer,
+                        audio.getArrayOfReadPointers(), nchans, nframes);
                    #endif
-                
-                    lrt_midi_pipe_resize (L, midiPipe, midi.getNumBuffers());
+
+                    if (nmidi != midiPipeSize)
+                    {
+                        lrt_midi_pipe_resize (L, midiPipe, nmidi);
+                        midiPipeSize = nmidi;
+                    }
+
                     lrt_midi_pipe_clear (midiPipe, -1);
-                    
+
+                    // lua-rt keeps its own event storage, so MIDI is still
+                    // copied, but only for the ports the script declared
                     int bytes = 0, frame = 0;
                     const uint8* data = nullptr;
                     for (int i = 0; i < nmidi; ++i)
@@ -430,15 +449,20 @@ struct LuaNode::Context
                         auto* dst = lrt_midi_pipe_get (midiPipe, i);
                         if (src->isEmpty())
                             continue;
-                        MidiBuffer::Iterator iter (*src);
-                        while (iter.getNextEvent (data, bytes, frame))
-                            lrt_midi_buffer_insert (dst, data, bytes, frame);
+
+                        if (i < numMidiIns)
+                        {
+                            MidiBuffer::Iterator iter (*src);
+                            while (iter.getNextEvent (data, bytes, frame))
+                                lrt_midi_buffer_insert (dst, data, bytes, frame);
+                        }
+
                         src->clear();
                     }
 
                     lua_call (L, 2, 0);
                     
-                    for (int i = 0; i < nmidi; ++i) 
+                    for (int i = 0; i < jmin (nmidi, numMidiOuts); ++i) 
                     {
                         auto* src = lrt_midi_pipe_get (midiPipe, i);
                         auto* dst = midi.getWriteBuffer (i);
@@ -468,6 +492,22 @@ struct LuaNode::Context
         {
             DBG("didn't get render fucntion in callback");
         }
+
+        lastBlockBytes = static_cast<size_t> (allocator.getTotalBytesAllocated() - totalBytesBefore);
+        maxBlockBytes = jmax (maxBlockBytes, lastBlockBytes);
+
+        // collect about twice what this block allocated so the collector
+        // keeps up with the script, but never more than the step budget
+        const int stepKB = jmin (maxGCStepKB, minGCStepKB + 2 * static_cast<int> (lastBlockBytes / 1024));
+        lua_gc (L, LUA_GCSTEP, stepKB);
+    }
+
+    void getMemoryStats (MemoryStats& stats) const noexcept
+    {
+        stats.bytesInUse                = allocator.getNumBytesInUse();
+        stats.bytesAllocatedLastBlock   = lastBlockBytes;
+        stats.maxBytesAllocatedPerBlock = maxBlockBytes;
+        stats.numSystemAllocations      = allocator.getNumSystemAllocations();
     }
     
     const OwnedArray<PortDescription>& getPortArray() const noexcept
@@ -580,6 +620,11 @@ struct LuaNode::Context
     }
 
 private:
+    enum { minGCStepKB = 1, maxGCStepKB = 64 };
+    LuaAllocator allocator;
+    size_t lastBlockBytes = 0;
+    size_t maxBlockBytes = 0;
+
     sol::state state;
     lua_State* L { nullptr };
     sol::function renderf;
@@ -592,6 +637,8 @@ private:
     int midiPipeRef = LUA_NOREF;
     lrt_midi_pipe_t* midiPipe { nullptr };
     lrt_audio_buffer_t* audioBuffer { nullptr };
+    int midiPipeSize = 0;
+    int numMidiIns = 0, numMidiOuts = 0;
 
     PortList ports;
     ParameterArray inParams, outParams;
@@ -702,6 +749,9 @@ private:
             }
             catch (const std::exception&) {}
 
+            numMidiIns  = midiIns;
+            numMidiOuts = midiOuts;
+
             int index = 0, channel = 0;
             for (int i = 0; i < audioIns; ++i)
             {
@@ -844,6 +894,13 @@ void LuaNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 {
     ScopedLock sl (lock);
     context->render (audio, midi);
+    context->getMemoryStats (memoryStats);
+}
+
+LuaNode::MemoryStats LuaNode::getMemoryStats() const
+{
+    ScopedLock sl (lock);
+    return memoryStats;
 }
 
 void LuaNode::setState (const void* data, int size)
@@ -56,6 +56,18 @@ public:
     */
     void setParameter (int index, float value);
 
+    /** Memory used by the script's Lua state */
+    struct MemoryStats
+    {
+        size_t bytesInUse = 0;                  ///< bytes currently allocated
+        size_t bytesAllocatedLastBlock = 0;     ///< bytes allocated while rendering the last block
+        size_t maxBytesAllocatedPerBlock = 0;   ///< most bytes allocated in a block since prepared
+        int numSystemAllocations = 0;           ///< times the arena went to the system allocator
+    };
+
+    /** Returns memory statistics as of the last rendered block */
+    MemoryStats getMemoryStats() const;
+
 protected:
     inline bool wantsMidiPipe() const override { return true; }
     void createPorts() override;
@@ -68,6 +80,7 @@ private:
     bool prepared = false;
     CriticalSection lock;
     std::unique_ptr<Context> context;
+    MemoryStats memoryStats;
     ParameterArray inParams, outParams;
 };
 
@@ -213,8 +213,7 @@ void MediaPlayerProcessor::fillInPluginDescription (PluginDescription& desc) con
 void MediaPlayerProcessor::clearPlayer()
 {
     player.setSource (nullptr);
-    if (reader)
-        reader = nullptr;
+    stream = nullptr;
     *playing = player.isPlaying();
 }
 
@@ -222,34 +221,28 @@ void MediaPlayerProcessor::openFile (const File& file)
 {
     if (file == audioFile)
         return;
-    if (auto* newReader = formats.createReaderFor (file))
-    {
-        clearPlayer();
-        reader.reset (new AudioFormatReaderSource (newReader, true));
-        audioFile = file;
-        player.setSource (reader.get(), 1024 * 8, &thread, getSampleRate(), 2);
-        ScopedLock sl (getCallbackLock());        
-        player.setLooping (true);
-        reader->setLooping (true);
-    }
+
+    std::unique_ptr<AudioFileStream> newStream (streamer->createStream (file, readAhead.get()));
+    if (newStream == nullptr)
+        return;
+
+    newStream->setLooping (true);
+    player.setSource (newStream.get(), 0, nullptr, newStream->getSampleRate(), 2);
+    stream.swap (newStream);
+    audioFile = file;
+    *playing = player.isPlaying();
 }
 
 void MediaPlayerProcessor::prepareToPlay (double sampleRate, int maximumExpectedSamplesPerBlock)
 {
-    thread.startThread();
-    formats.registerBasicFormats();
     player.prepareToPlay (maximumExpectedSamplesPerBlock, sampleRate);
     player.setLooping (true);
-    if (reader)
-        reader->setLooping (true);
 }
 
 void MediaPlayerProcessor::releaseResources()
 {
     player.stop();
     player.releaseResources();
-    formats.clearFormats();
-    thread.stopThread (14);
 }
 
 void MediaPlayerProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midi)
@@ -282,7 +275,8 @@ void MediaPlayerProcessor::getStateInformation (juce::MemoryBlock& destData)
     ValueTree state (Tags::state);
     state.setProperty ("audioFile", audioFile.getFullPathName(), nullptr)
          .setProperty ("playing", (bool)*playing, nullptr)
-         .setProperty ("slave", (bool)*slave, nullptr);
+         .setProperty ("slave", (bool)*slave, nullptr)
+         .setProperty ("readAhead", readAhead.get(), nullptr);
     MemoryOutputStream stream (destData, false);
     state.writeToStream (stream);
 }
@@ -292,6 +286,7 @@ void MediaPlayerProcessor::setStateInformation (const void* data, int sizeInByte
     const auto state = ValueTree::readFromData (data, (size_t) sizeInBytes);
     if (state.isValid())
     {
+        setReadAheadSamples ((int) state.getProperty ("readAhead", (int) DiskStreamer::defaultReadAhead));
         if (File::isAbsolutePath (state["audioFile"].toString()))
             openFile (File (state["audioFile"].toString()));
         *playing = (bool) state.getProperty ("playing", false);
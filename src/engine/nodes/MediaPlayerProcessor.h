@@ -20,6 +20,7 @@
 #pragma once
 
 #include "engine/nodes/BaseProcessor.h"
+#include "engine/DiskStreamer.h"
 
 namespace Element {
 
@@ -34,7 +35,12 @@ public:
 
     void openFile (const File& file);
     const File& getAudioFile() const { return audioFile; }
-    String getWildcard() const { return formats.getWildcardForAllFormats(); }
+    String getWildcard() const { return streamer->getFormats().getWildcardForAllFormats(); }
+
+    /** Sets how many samples are buffered ahead of the play position.
+        Takes effect the next time a file is opened */
+    void setReadAheadSamples (int numSamples) { readAhead.set (jmax (1024, numSamples)); }
+    int getReadAheadSamples() const { return readAhead.get(); }
 
     void fillInPluginDescription (PluginDescription& desc) const override;
 
@@ -104,10 +110,10 @@ protected:
 #endif
 
 private:
-    TimeSliceThread thread { "MediaPlayer" };
-    std::unique_ptr<AudioFormatReaderSource> reader;
-    AudioFormatManager formats;
+    SharedResourcePointer<DiskStreamer> streamer;
+    std::unique_ptr<AudioFileStream> stream;
     AudioTransportSource player;
+    Atomic<int> readAhead { DiskStreamer::defaultReadAhead };
 
     AudioParameterBool* slave       { nullptr };
     AudioParameterBool* playing     { nullptr };
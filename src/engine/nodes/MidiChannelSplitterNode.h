@@ -20,6 +20,7 @@
 #pragma once
 
 #include "engine/nodes/MidiFilterNode.h"
+#include "engine/MidiEventStream.h"
 #include "engine/MidiPipe.h"
 #include "engine/nodes/BaseProcessor.h"
 
@@ -58,26 +59,15 @@ public:
             return;
         }
 
-        buffers[0] = &tempMidi;
-        for (int ch = 1; ch < 16; ++ch)
+        // channel 1 goes out the buffer the input came in on
+        stream.readFrom (*midi.getWriteBuffer (0));
+        for (int ch = 0; ch < 16; ++ch)
         {
             buffers[ch] = midi.getWriteBuffer (ch);
             buffers[ch]->clear();
         }
-        
-        MidiBuffer& input (*midi.getWriteBuffer (0));
-        MidiBuffer::Iterator iter (input);
-        MidiMessage msg; int frame = 0;
 
-        while (iter.getNextEvent (msg, frame))
-        {
-            if (msg.getChannel() <= 0)
-                continue;
-            buffers[msg.getChannel() - 1]->addEvent (msg, frame);
-        }
-
-        input.swapWith (tempMidi);
-        tempMidi.clear();
+        stream.splitByChannel (buffers);
     }
 
     void getPluginDescription (PluginDescription& desc) const override
@@ -99,7 +89,7 @@ protected:
     bool assertedLowChannels = false;
     bool createdPorts = false;
     MidiBuffer* buffers [16];
-    MidiBuffer tempMidi;
+    MidiEventStream stream { 4096, 0 }; // only channel messages are split
 
     inline void createPorts() override
     {
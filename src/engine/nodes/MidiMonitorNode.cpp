@@ -60,14 +60,17 @@ void MidiMonitorNode::render (AudioSampleBuffer& audio, MidiPipe& midi)
 
     auto* const midiIn = midi.getWriteBuffer (0);
     MidiBuffer::Iterator iter (*midiIn);
-    MidiMessage msg;
-    int frame;
+    const uint8* data = nullptr;
+    int size = 0, frame = 0;
 
     ScopedLock sl (lock);
-    while (iter.getNextEvent (msg, frame))
+    while (iter.getNextEvent (data, size, frame))
     {
-        msg.setTimeStamp (timestamp + (1000.0 * (static_cast<double> (frame) / currentSampleRate)));
-        inputMessages.addMessageToQueue (msg);
+        // clock isn't logged, so don't queue it either
+        if (size == 1 && data[0] == 0xf8)
+            continue;
+        inputMessages.addMessageToQueue (MidiMessage (data, size,
+            timestamp + (1000.0 * (static_cast<double> (frame) / currentSampleRate))));
     }
 
     numSamples += nframes;
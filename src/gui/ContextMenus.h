@@ -229,6 +229,9 @@ public:
         osMenu.addItem (index++, "2x", true, ptr->getOversamplingFactor() == 2);
         osMenu.addItem (index++, "4x", true, ptr->getOversamplingFactor() == 4);
         osMenu.addItem (index++, "8x", true, ptr->getOversamplingFactor() == 8);
+        osMenu.addSeparator();
+        osMenu.addItem (40010, "Linear phase filter", true,
+                        ptr->getOversamplingFilter() == GraphNode::linearPhaseFilter);
                                                       
         menuToAddTo.addSubMenu ("Oversample", osMenu);
     }
@@ -339,8 +342,7 @@ public:
                 const auto data = Node::parse (item->file);
                 if (n.isValid() && data.isValid() && data.hasProperty (Tags::state))
                 {
-                    const String state = data.getProperty(Tags::state).toString();
-                    n.getValueTree().setProperty (Tags::state, state, 0);
+                    n.getValueTree().setProperty (Tags::state, data.getProperty (Tags::state), 0);
                     if (data.hasProperty (Tags::programState))
                         n.getValueTree().setProperty (Tags::programState, data.getProperty (Tags::programState), 0);
                     n.restorePluginState();
@@ -365,7 +367,6 @@ public:
         }
         else if (result >= 40000 && result < 50000)
         {
-            const int osFactor = (int) powf(2, float (result - 40000));
             if (auto gNode = node.getGraphNode())
             {
                 auto* graph = gNode->getParentGraph();
@@ -373,7 +374,11 @@ public:
                 bool wasSuspended = graph->isSuspended();
                 graph->suspendProcessing (true);
                 graph->releaseResources();
-                gNode->setOversamplingFactor (osFactor);
+                if (result == 40010)
+                    gNode->setOversamplingFilter (gNode->getOversamplingFilter() == GraphNode::linearPhaseFilter
+                        ? GraphNode::iirFilter : GraphNode::linearPhaseFilter);
+                else
+                    gNode->setOversamplingFactor ((int) powf (2, float (result - 40000)));
                 graph->prepareToPlay (gNode->getParentGraph()->getSampleRate(), gNode->getParentGraph()->getBlockSize());
                 graph->suspendProcessing (wasSuspended);
             }
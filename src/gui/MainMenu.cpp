@@ -154,6 +154,7 @@ void MainMenu::menuItemSelected (int index, int menu)
         DBG("[EL] === SESSION DUMP ===");
         auto data = session->getValueTree().createCopy();
         Node::sanitizeProperties (data, true);
+        Node::encodeStateProperties (data);
         DBG(data.toXmlString());
     }
     else if (index >= 1111 && index <= 1114)
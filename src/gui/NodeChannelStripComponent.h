@@ -60,6 +60,7 @@ public:
 
     ~NodeChannelStripComponent()
     {
+        unsubscribeMeters();
         unbindSignals();
     }
 
@@ -129,22 +130,17 @@ public:
             const int startChannel = jmax (0, channelBox.getSelectedId() - 1);
             if (ptr->getNumAudioOutputs() == 1)
             {
-                if (isAudioOutNode)
-                    for (int c = 0; c < 2; ++c)
-                        meter.setValue (c, ptr->getInputRMS (startChannel));
-                else
-                    for (int c = 0; c < 2; ++c)
-                        meter.setValue (c, ptr->getOutputRMS (startChannel));
+                subscribeMeters (ptr, isAudioOutNode, startChannel, 1);
+                const auto levels = ptr->readMeter (isAudioOutNode, startChannel);
+                for (int c = 0; c < 2; ++c)
+                    meter.setValue (c, levels.rms);
             }
             else
             {
-                const int endChannel = startChannel + 2;
-                if (isAudioOutNode || isMonitoringInputs())
-                    for (int c = startChannel; c < endChannel; ++c)
-                        meter.setValue (c - startChannel, ptr->getInputRMS (c));
-                else
-                    for (int c = startChannel; c < endChannel; ++c)
-                        meter.setValue (c - startChannel, ptr->getOutputRMS (c));
+                const bool inputs = isAudioOutNode || isMonitoringInputs();
+                subscribeMeters (ptr, inputs, startChannel, 2);
+                for (int c = 0; c < 2; ++c)
+                    meter.setValue (c, ptr->readMeter (inputs, startChannel + c).rms);
             }
 
             const auto cv = getCurrentVolume();
@@ -157,6 +153,7 @@ public:
         }
         else
         {
+            unsubscribeMeters();
             meter.resetPeaks();
             stopTimer();
         }
@@ -197,6 +194,7 @@ public:
     inline void setNode (const Node& newNode)
     {
         stopTimer();
+        unsubscribeMeters();
         node = newNode;
         isAudioOutNode = node.isAudioOutputNode();
         isAudioInNode  = node.isAudioInputNode();
@@ -267,12 +265,41 @@ private:
 
     Value displayName;
 
+    // channels this strip is metering
+    GraphNodePtr meteredNode;
+    bool meteringInputs = false;
+    int meteredStart = 0, meteredCount = 0;
+
     SignalConnection nodeSelectedConnection;
     SignalConnection volumeChangedConnection;
     SignalConnection powerChangedConnection;
     SignalConnection volumeDoubleClickedConnection;
     SignalConnection muteChangedConnection;
 
+    void subscribeMeters (GraphNode* ptr, bool inputs, int start, int count)
+    {
+        if (ptr == meteredNode.get() && inputs == meteringInputs &&
+            start == meteredStart && count == meteredCount)
+            return;
+
+        unsubscribeMeters();
+        meteredNode     = ptr;
+        meteringInputs  = inputs;
+        meteredStart    = start;
+        meteredCount    = count;
+        for (int c = start; c < start + count; ++c)
+            meteredNode->subscribeMeter (inputs, c);
+    }
+
+    void unsubscribeMeters()
+    {
+        if (meteredNode != nullptr)
+            for (int c = meteredStart; c < meteredStart + meteredCount; ++c)
+                meteredNode->unsubscribeMeter (meteringInputs, c);
+        meteredNode = nullptr;
+        meteredCount = 0;
+    }
+
     inline bool isMonitoringInputs() const  { return flowBox.getSelectedId() == 1; }
     inline bool isMonitoringOutputs() const { return flowBox.getSelectedId() == 2; }
 
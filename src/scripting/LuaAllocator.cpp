@@ -0,0 +1,201 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "scripting/LuaAllocator.h"
+
+namespace Element {
+
+LuaAllocator::LuaAllocator()
+{
+    for (auto*& list : freeLists)
+        list = nullptr;
+}
+
+LuaAllocator::~LuaAllocator()
+{
+    // the lua_State must be closed before its arena goes away
+    jassert (numBytesInUse == 0);
+}
+
+void LuaAllocator::reserve (size_t numBytes)
+{
+    while (getNumBytesReserved() < numBytes)
+        if (! addChunk())
+            break;
+}
+
+size_t LuaAllocator::getNumBytesReserved() const noexcept
+{
+    if (currentChunk < 0)
+        return (size_t) chunks.size() * chunkSize;
+    return (chunkSize - chunkOffset) + (size_t) (chunks.size() - currentChunk - 1) * chunkSize;
+}
+
+void* LuaAllocator::allocate (void* userData, void* ptr, size_t oldSize, size_t newSize)
+{
+    auto& arena = *static_cast<LuaAllocator*> (userData);
+
+    // when ptr is null, Lua passes the type of object being created as the old size
+    if (ptr == nullptr)
+        oldSize = 0;
+
+    if (newSize == 0)
+    {
+        if (ptr != nullptr)
+            arena.freeBlock (ptr, oldSize);
+        return nullptr;
+    }
+
+    if (ptr == nullptr)
+        return arena.allocateBlock (newSize);
+
+    const bool wasPooled = oldSize <= maxPooledSize;
+    const bool isPooled  = newSize <= maxPooledSize;
+
+    if ((! wasPooled && ! isPooled) || (wasPooled && isPooled && getSizeClass (oldSize) == getSizeClass (newSize)))
+    {
+        void* block = ptr;
+        if (! isPooled)
+        {
+            block = std::realloc (ptr, newSize);
+            if (block == nullptr)
+                return nullptr;
+            ++arena.numSystemAllocations;
+        }
+
+        arena.numBytesInUse = arena.numBytesInUse + newSize - oldSize;
+        if (newSize > oldSize)
+            arena.totalBytesAllocated += newSize - oldSize;
+        return block;
+    }
+
+    // moving to another size class. On failure Lua expects the old block untouched
+    void* block = arena.allocateBlock (newSize);
+    if (block == nullptr)
+        return nullptr;
+
+    memcpy (block, ptr, jmin (oldSize, newSize));
+    arena.freeBlock (ptr, oldSize);
+    return block;
+}
+
+void* LuaAllocator::allocateBlock (size_t size)
+{
+    void* block = nullptr;
+
+    if (size > maxPooledSize)
+    {
+        block = std::malloc (size);
+        ++numSystemAllocations;
+    }
+    else
+    {
+        const int sizeClass = getSizeClass (size);
+        if (auto* const head = freeLists [sizeClass])
+        {
+            freeLists [sizeClass] = head->next;
+            block = head;
+        }
+        else
+        {
+            block = carve (sizeClass);
+        }
+    }
+
+    if (block != nullptr)
+    {
+        numBytesInUse += size;
+        totalBytesAllocated += size;
+    }
+
+    return block;
+}
+
+void LuaAllocator::freeBlock (void* ptr, size_t size)
+{
+    jassert (numBytesInUse >= size);
+    numBytesInUse -= size;
+
+    if (size > maxPooledSize)
+    {
+        std::free (ptr);
+        return;
+    }
+
+    const int sizeClass = getSizeClass (size);
+    auto* const block = static_cast<FreeBlock*> (ptr);
+    block->next = freeLists [sizeClass];
+    freeLists [sizeClass] = block;
+}
+
+void* LuaAllocator::carve (int sizeClass)
+{
+    const size_t size = getClassSize (sizeClass);
+
+    if (currentChunk < 0 || chunkOffset + size > chunkSize)
+    {
+        if (currentChunk >= 0)
+        {
+            // hand what's left of the chunk to the smaller free lists
+            size_t remaining = chunkSize - chunkOffset;
+            for (int c = numClasses; --c >= 0;)
+            {
+                while (remaining >= getClassSize (c))
+                {
+                    auto* const block = reinterpret_cast<FreeBlock*> (chunks.getUnchecked (currentChunk)->get() + chunkOffset);
+                    block->next = freeLists [c];
+                    freeLists [c] = block;
+                    chunkOffset += getClassSize (c);
+                    remaining -= getClassSize (c);
+                }
+            }
+        }
+
+        if (currentChunk + 1 >= chunks.size() && ! addChunk())
+            return nullptr;
+
+        ++currentChunk;
+        chunkOffset = 0;
+    }
+
+    void* const block = chunks.getUnchecked (currentChunk)->get() + chunkOffset;
+    chunkOffset += size;
+    return block;
+}
+
+bool LuaAllocator::addChunk()
+{
+    std::unique_ptr<HeapBlock<char>> chunk (new HeapBlock<char> (chunkSize));
+    if (chunk->get() == nullptr)
+        return false;
+
+    chunks.add (chunk.release());
+    ++numSystemAllocations;
+    return true;
+}
+
+int LuaAllocator::getSizeClass (size_t size) noexcept
+{
+    jassert (size > 0 && size <= maxPooledSize);
+    if (size <= ((size_t) 1 << minClassBits))
+        return 0;
+    return findHighestSetBit ((uint32) (size - 1)) + 1 - minClassBits;
+}
+
+}
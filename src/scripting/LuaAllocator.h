@@ -0,0 +1,98 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "JuceHeader.h"
+
+namespace Element {
+
+/** A memory arena for a single lua_State.
+
+    Pass LuaAllocator::allocate and a pointer to the arena to lua_newstate.
+    Small blocks come from segregated free lists carved out of large chunks,
+    so once a script has warmed up, allocating and freeing is a constant
+    time list operation and never goes to the system allocator. Lua tells
+    the allocator the size of every block it frees, so no per-block headers
+    are needed.
+
+    Blocks larger than maxPooledSize are handed to the system allocator.
+
+    An arena isn't thread safe. It belongs to the Lua state using it and is
+    only touched from whichever thread is running that state.
+ */
+class LuaAllocator
+{
+public:
+    /** Blocks up to this size come from the free lists */
+    enum { maxPooledSize = 64 * 1024 };
+
+    /** The size of each chunk the free lists are carved from */
+    enum { chunkSize = 256 * 1024 };
+
+    LuaAllocator();
+    ~LuaAllocator();
+
+    /** Make sure there are at least this many bytes of chunk memory which
+        haven't been handed out yet. Call this off of the audio thread to
+        give a script headroom before it renders */
+    void reserve (size_t numBytes);
+
+    /** The lua_Alloc function. userData must point to a LuaAllocator */
+    static void* allocate (void* userData, void* ptr, size_t oldSize, size_t newSize);
+
+    /** Bytes currently allocated by Lua */
+    size_t getNumBytesInUse() const noexcept            { return numBytesInUse; }
+
+    /** Total bytes Lua has asked for since the arena was created. The
+        difference between two readings is the amount allocated in between */
+    uint64 getTotalBytesAllocated() const noexcept      { return totalBytesAllocated; }
+
+    /** Number of times the arena called the system allocator */
+    int getNumSystemAllocations() const noexcept        { return numSystemAllocations; }
+
+    /** Bytes of chunk memory not yet handed out to a free list */
+    size_t getNumBytesReserved() const noexcept;
+
+private:
+    enum { minClassBits = 4, numClasses = 13 }; // 16 bytes to 64 KiB
+
+    struct FreeBlock { FreeBlock* next; };
+    FreeBlock* freeLists [numClasses];
+
+    OwnedArray<HeapBlock<char>> chunks;
+    int currentChunk = -1;
+    size_t chunkOffset = 0;
+
+    size_t numBytesInUse = 0;
+    uint64 totalBytesAllocated = 0;
+    int numSystemAllocations = 0;
+
+    void* allocateBlock (size_t size);
+    void freeBlock (void* ptr, size_t size);
+    void* carve (int sizeClass);
+    bool addChunk();
+
+    static int getSizeClass (size_t size) noexcept;
+    static size_t getClassSize (int sizeClass) noexcept { return (size_t) 1 << (sizeClass + minClassBits); }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LuaAllocator)
+};
+
+}
@@ -232,6 +232,7 @@ static void openModel (sol::state& lua)
         {
             auto copy = self->getValueTree().createCopy();
             Node::sanitizeRuntimeProperties (copy, true);
+            Node::encodeStateProperties (copy);
             return copy.toXmlString().toStdString();
         },
         "resetports",           &Node::resetPorts,
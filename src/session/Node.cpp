@@ -282,6 +282,30 @@ void Node::sanitizeRuntimeProperties (ValueTree node, const bool recursive)
     Node::sanitizeProperties (node, recursive);
 }
 
+bool Node::readStateProperty (const ValueTree& data, const Identifier& property, MemoryBlock& state)
+{
+    state.reset();
+    const auto& value = data.getProperty (property);
+    if (const auto* block = value.getBinaryData())
+        state = *block;
+    else if (value.isString())
+        state.fromBase64Encoding (value.toString().trim());
+    return state.getSize() > 0;
+}
+
+void Node::encodeStateProperties (ValueTree data)
+{
+    if (data.hasType (Tags::node))
+    {
+        for (const auto& property : { Tags::state, Tags::programState })
+            if (const auto* block = data.getProperty (property).getBinaryData())
+                data.setProperty (property, block->toBase64Encoding(), nullptr);
+    }
+
+    for (int i = 0; i < data.getNumChildren(); ++i)
+        encodeStateProperties (data.getChild (i));
+}
+
 bool Node::writeToFile (const File& targetFile) const
 {
     ValueTree data = objectData.createCopy();
@@ -296,6 +320,7 @@ bool Node::writeToFile (const File& targetFile) const
         return tempFile.overwriteTargetFileWithTemporary();
     }
     #else
+    encodeStateProperties (data);
     if (auto e = data.createXml())
         return e->writeToFile (targetFile, String());
     #endif
@@ -328,6 +353,7 @@ bool Node::savePresetTo (const DataPath& path, const String& name) const
         return tempFile.overwriteTargetFileWithTemporary();
     }
     #else
+    encodeStateProperties (data);
     if (auto e = preset.createXml())
         return e->writeToFile (targetFile, String());
     #endif
@@ -643,26 +669,16 @@ void Node::restorePluginState()
             if (shouldSetProgram)
                 proc->setCurrentProgram (wantedProgram);
 
-            auto data = getProperty(Tags::state).toString().trim();
-            if (data.isNotEmpty())
+            MemoryBlock state;
+            if (readStateProperty (objectData, Tags::state, state))
             {
-                MemoryBlock state;
-                state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                {
-                    proc->setStateInformation (state.getData(), (int) state.getSize());
-                }
+                proc->setStateInformation (state.getData(), (int) state.getSize());
             }
             
-            data = getProperty(Tags::programState).toString().trim();
-            if (shouldSetProgram && data.isNotEmpty())
+            if (shouldSetProgram && readStateProperty (objectData, Tags::programState, state))
             {
-                MemoryBlock state; state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                {
-                    proc->setCurrentProgramStateInformation (state.getData(),
-                        (int) state.getSize());
-                }
+                proc->setCurrentProgramStateInformation (state.getData(),
+                    (int) state.getSize());
             }
         }
         else
@@ -673,14 +689,9 @@ void Node::restorePluginState()
             if (shouldSetProgram)
                 obj->setCurrentProgram (wantedProgram);
 
-            auto data = getProperty(Tags::state).toString().trim();
-            if (data.isNotEmpty())
-            {
-                MemoryBlock state;
-                state.fromBase64Encoding (data);
-                if (state.getSize() > 0)
-                    obj->setState (state.getData(), (int) state.getSize());
-            }
+            MemoryBlock state;
+            if (readStateProperty (objectData, Tags::state, state))
+                obj->setState (state.getData(), (int) state.getSize());
         }
 
         if (hasProperty (Tags::bypass))
@@ -729,6 +740,8 @@ void Node::restorePluginState()
             obj->setTransposeOffset (getProperty (Tags::transpose));
         
         obj->setOversamplingFactor (jmax (1, (int) getProperty (Tags::oversamplingFactor, 1)));
+        obj->setOversamplingFilter (static_cast<GraphNode::OversamplingFilter> (
+            jlimit (0, 1, (int) getProperty (Tags::oversamplingFilter, (int) GraphNode::iirFilter))));
     }
 
     // this was originally here to help reduce memory usage
@@ -757,7 +770,7 @@ void Node::savePluginState()
             proc->getStateInformation (state);
             if (state.getSize() > 0)
             {
-                objectData.setProperty (Tags::state, state.toBase64Encoding(), nullptr);
+                objectData.setProperty (Tags::state, var (state), nullptr);
             }
             else
             {
@@ -770,7 +783,7 @@ void Node::savePluginState()
             proc->getCurrentProgramStateInformation (state);
             if (state.getSize() > 0)
             {
-                objectData.setProperty (Tags::programState, state.toBase64Encoding(), 0);
+                objectData.setProperty (Tags::programState, var (state), 0);
             }
 
             setProperty (Tags::bypass, proc->isSuspended());
@@ -780,7 +793,7 @@ void Node::savePluginState()
         {
             obj->getState (state);
             if (state.getSize() > 0)
-                objectData.setProperty (Tags::state, state.toBase64Encoding(), nullptr);
+                objectData.setProperty (Tags::state, var (state), nullptr);
         }
 
         setProperty (Tags::midiProgram, obj->getMidiProgram());
@@ -791,6 +804,7 @@ void Node::savePluginState()
         String mps; obj->getMidiProgramsState (mps);
         setProperty (Tags::midiProgramsState, mps);
         setProperty (Tags::oversamplingFactor, obj->getOversamplingFactor());
+        setProperty (Tags::oversamplingFilter, static_cast<int> (obj->getOversamplingFilter()));
     }
 
     for (int i = 0; i < getNumNodes(); ++i)
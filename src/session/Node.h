@@ -119,6 +119,15 @@ public:
     /** This is just an alias right now */
     static void sanitizeRuntimeProperties (ValueTree node, const bool recursive = false);
 
+    /** Reads plugin state saved in a property, like Tags::state. State can be
+        binary or base64. Returns false if there wasn't any */
+    static bool readStateProperty (const ValueTree& data, const Identifier& property, MemoryBlock& state);
+
+    /** Replaces binary plugin state with the base64 strings XML sessions
+        have always held. The model keeps state binary, call this on a copy
+        before creating XML from it */
+    static void encodeStateProperties (ValueTree data);
+
     /** Create a value tree version of an arc */
     static ValueTree makeArc (const kv::Arc& arc);
 
@@ -0,0 +1,223 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "engine/nodes/BaseProcessor.h"
+#include "session/PluginInstantiator.h"
+#include "session/PluginManager.h"
+
+namespace Element {
+
+class PluginInstantiator::RestoreJob : public ThreadPoolJob
+{
+public:
+    RestoreJob (PluginInstantiator& o, Item& i)
+        : ThreadPoolJob (i.description.name), owner (o), item (i) { }
+
+    JobStatus runJob() override
+    {
+        if (! owner.wasCancelled())
+            restore (item);
+        ++owner.numRestored;
+        owner.triggerAsyncUpdate();
+        return jobHasFinished;
+    }
+
+private:
+    PluginInstantiator& owner;
+    Item& item;
+};
+
+//=============================================================================
+PluginInstantiator::PluginInstantiator (PluginManager& p)
+    : plugins (p) { }
+
+PluginInstantiator::~PluginInstantiator()
+{
+    // waits for running jobs, which may still trigger an update
+    cancel();
+    pool = nullptr;
+    cancelPendingUpdate();
+}
+
+PluginInstantiator::Item& PluginInstantiator::add (const PluginDescription& desc)
+{
+    auto* item = items.add (new Item());
+    item->description = desc;
+    return *item;
+}
+
+PluginInstantiator::Item* PluginInstantiator::findItem (uint32 nodeId) const noexcept
+{
+    for (auto* item : items)
+        if (item->nodeId == nodeId)
+            return item;
+    return nullptr;
+}
+
+bool PluginInstantiator::canRestoreOffMessageThread (const PluginDescription& desc)
+{
+    // Element's processors which only read their state into parameters.
+    // Third party formats often expect the message thread, and may take a
+    // MessageManagerLock, so they are never restored in the background
+    static const StringArray safe
+    {
+        EL_INTERNAL_ID_COMB_FILTER,
+        EL_INTERNAL_ID_COMPRESSOR,
+        EL_INTERNAL_ID_CHANNELIZE,
+        EL_INTERNAL_ID_EQ_FILTER,
+        EL_INTERNAL_ID_FREQ_SPLITTER,
+        EL_INTERNAL_ID_MIDI_CHANNEL_MAP,
+        EL_INTERNAL_ID_REVERB,
+        EL_INTERNAL_ID_WET_DRY
+    };
+
+    return desc.pluginFormatName == EL_INTERNAL_FORMAT_NAME &&
+           safe.contains (desc.fileOrIdentifier);
+}
+
+void PluginInstantiator::start (std::function<void()> onFinished, int numThreads)
+{
+    jassert (MessageManager::getInstance()->isThisTheMessageThread());
+    jassert (! running);
+
+    cancelled.store (false);
+    numRestored.store (0);
+    numCreated = numQueued = 0;
+    finished = onFinished;
+    pool.reset (new ThreadPool (numThreads > 0 ? numThreads : jmax (1, SystemStats::getNumCpus())));
+    running = true;
+    triggerAsyncUpdate();
+}
+
+void PluginInstantiator::runNow()
+{
+    cancelled.store (false);
+    numRestored.store (0);
+    numCreated = numQueued = 0;
+
+    for (auto* const item : items)
+    {
+        if (wasCancelled())
+            break;
+
+        create (*item);
+        ++numCreated;
+        if (shouldRestore (*item))
+            restore (*item);
+
+        reportProgress();
+    }
+}
+
+void PluginInstantiator::reportProgress()
+{
+    if (onProgress)
+        onProgress (numCreated - numQueued + numRestored.load(), items.size());
+}
+
+void PluginInstantiator::handleAsyncUpdate()
+{
+    if (! running)
+        return;
+
+    // one plugin per callback, so the message loop keeps running
+    if (! wasCancelled() && numCreated < items.size())
+    {
+        auto& item = *items.getUnchecked (numCreated);
+        create (item);
+        ++numCreated;
+
+        if (shouldRestore (item) && canRestoreOffMessageThread (item.description))
+        {
+            pool->addJob (new RestoreJob (*this, item), true);
+            ++numQueued;
+        }
+
+        reportProgress();
+        triggerAsyncUpdate();
+        return;
+    }
+
+    // cancelled jobs skip restoring but still count themselves, and every
+    // job triggers another update when it finishes
+    if (numRestored.load() < numQueued)
+    {
+        reportProgress();
+        return;
+    }
+
+    pool = nullptr;
+    running = false;
+    reportProgress();
+
+    // this may delete the instantiator, so nothing touches it after
+    auto callback = std::move (finished);
+    if (callback)
+        callback();
+}
+
+void PluginInstantiator::create (Item& item)
+{
+    const auto& desc = item.description;
+
+    if (desc.pluginFormatName == EL_INTERNAL_FORMAT_NAME)
+    {
+        String errorMessage;
+        item.node = plugins.createGraphNode (desc, errorMessage);
+        if (item.node != nullptr)
+            return;
+    }
+
+    item.instance.reset (plugins.createAudioPlugin (desc, item.errorMessage));
+    if (item.instance != nullptr)
+        item.instance->enableAllBuses();
+}
+
+bool PluginInstantiator::shouldRestore (const Item& item)
+{
+    if (item.instance == nullptr)
+        return false;
+    if (item.state.getSize() <= 0 && item.programState.getSize() <= 0 && item.program < 0)
+        return false;
+
+    const auto& proc = *item.instance;
+    return (item.numInputs < 0  || proc.getTotalNumInputChannels()  == item.numInputs) &&
+           (item.numOutputs < 0 || proc.getTotalNumOutputChannels() == item.numOutputs);
+}
+
+void PluginInstantiator::restore (Item& item)
+{
+    // same order as Node::restorePluginState
+    auto& proc = *item.instance;
+    const bool shouldSetProgram = proc.getNumPrograms() > 0 &&
+        isPositiveAndBelow (item.program, proc.getNumPrograms());
+    if (shouldSetProgram)
+        proc.setCurrentProgram (item.program);
+
+    if (item.state.getSize() > 0)
+        proc.setStateInformation (item.state.getData(), (int) item.state.getSize());
+
+    if (shouldSetProgram && item.programState.getSize() > 0)
+        proc.setCurrentProgramStateInformation (item.programState.getData(),
+                                                (int) item.programState.getSize());
+
+    item.stateRestored = true;
+}
+
+}
@@ -0,0 +1,127 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+#include "engine/GraphNode.h"
+
+namespace Element {
+
+class PluginManager;
+
+/** Creates a batch of plugins and restores their state.
+
+    JUCE hands every plugin creation to the message thread, so instances are
+    created one after another there, one per message loop callback so the UI
+    keeps running. Restoring state is the expensive part for a lot of
+    plugins. For the plugins listed by canRestoreOffMessageThread, that is
+    done on a pool of worker threads while the next plugins are being
+    created. Everything else, and instances which need a different channel
+    layout first, is left for the caller to restore on the message thread.
+ */
+class PluginInstantiator : private AsyncUpdater
+{
+public:
+    struct Item
+    {
+        PluginDescription description;
+
+        /** The id of the model node this item is created for */
+        uint32 nodeId = 0;
+
+        /** State to restore. This comes from the saved model */
+        int program = -1;
+        MemoryBlock state, programState;
+
+        /** If set, state is only restored here when the new instance has
+            this many audio channels. Otherwise the caller has to change the
+            layout and restore it */
+        int numInputs = -1, numOutputs = -1;
+
+        /** The results. At most one of these is set */
+        GraphNodePtr node;
+        std::unique_ptr<AudioPluginInstance> instance;
+        String errorMessage;
+        bool stateRestored = false;
+    };
+
+    explicit PluginInstantiator (PluginManager&);
+    ~PluginInstantiator();
+
+    /** Adds a plugin to create and returns its item to fill in */
+    Item& add (const PluginDescription&);
+
+    int getNumItems() const noexcept                { return items.size(); }
+    Item& getItem (int index) const noexcept        { return *items.getUnchecked (index); }
+
+    /** Returns the item added for a node id, or nullptr */
+    Item* findItem (uint32 nodeId) const noexcept;
+
+    /** Starts creating plugins and returns. onFinished is called on the
+        message thread once every item is done, or after cancel(). It may
+        delete the instantiator. Call this on the message thread.
+
+        @param numThreads   The number of threads used for restoring state,
+                            zero uses one per CPU
+      */
+    void start (std::function<void()> onFinished, int numThreads = 0);
+
+    /** Creates everything and restores state on the calling thread */
+    void runNow();
+
+    /** True between start() and the call to onFinished */
+    bool isRunning() const noexcept                 { return running; }
+
+    /** Stops creating plugins. Items not created yet are left empty. Can be
+        called from any thread, or from onProgress */
+    void cancel() noexcept                          { cancelled.store (true); }
+
+    /** True if cancel() was called while running */
+    bool wasCancelled() const noexcept              { return cancelled.load(); }
+
+    /** Called on the message thread as items finish */
+    std::function<void(int numFinished, int numItems)> onProgress;
+
+    /** Returns true if a plugin is known to restore state safely off of the
+        message thread. This is an allowlist, everything else is restored on
+        the message thread */
+    static bool canRestoreOffMessageThread (const PluginDescription&);
+
+private:
+    PluginManager& plugins;
+    OwnedArray<Item> items;
+    std::atomic<bool> cancelled { false };
+    std::atomic<int> numRestored { 0 };
+    std::unique_ptr<ThreadPool> pool;
+    std::function<void()> finished;
+    bool running = false;
+    int numCreated = 0, numQueued = 0;
+
+    class RestoreJob;
+    void handleAsyncUpdate() override;
+    void reportProgress();
+    void create (Item&);
+    static void restore (Item&);
+    static bool shouldRestore (const Item&);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginInstantiator)
+};
+
+}
@@ -41,6 +41,8 @@
 #define EL_PLUGIN_SCANNER_FINISHED_ID           "finished"
 
 #define EL_PLUGIN_SCANNER_DEFAULT_TIMEOUT       20000  // 20 Seconds
+#define EL_PLUGIN_SCANNER_FILE_TIMEOUT          60000  // 1 Minute per file
+#define EL_PLUGIN_SCANNER_CACHE_FILENAME        "PluginScanCache.xml"
 
 namespace Element {
 
@@ -48,196 +50,567 @@ static const char* pluginListKey() { return Settings::pluginListKey; }
 /* noop. prevent OS error dialogs from child process */ 
 static void pluginScannerSlaveCrashHandler (void*) { }
 
-class PluginScannerMaster : public kv::ChildProcessMaster,
-                            public AsyncUpdater
+// MARK: Plugin Scan Cache
+
+/** Scan results per plugin file, kept between scans. A file is only scanned
+    again when its size or modification time changes. Identifiers which
+    aren't files, like AudioUnit ids and LV2 URIs, are never cached */
+class PluginScanCache
 {
 public:
-    explicit PluginScannerMaster (PluginScanner& o) : owner(o) { }
-    ~PluginScannerMaster() { }
-    
-    bool startScanning (const StringArray& names = StringArray())
+    PluginScanCache() { }
+
+    struct Stamp
     {
-        if (isRunning())
+        int64 size = 0;
+        int64 modified = 0;
+        bool operator== (const Stamp& o) const noexcept { return size == o.size && modified == o.modified; }
+    };
+
+    /** Gets a file's stamp. Bundles are stamped by everything inside them */
+    static bool getStamp (const String& fileOrIdentifier, Stamp& stamp)
+    {
+        if (! File::isAbsolutePath (fileOrIdentifier))
+            return false;
+
+        const File file (fileOrIdentifier);
+        if (! file.exists())
+            return false;
+
+        stamp = Stamp();
+        stamp.modified = file.getLastModificationTime().toMilliseconds();
+        if (! file.isDirectory())
+        {
+            stamp.size = file.getSize();
             return true;
-        
+        }
+
+        DirectoryIterator iter (file, true, "*", File::findFiles);
+        bool isDirectory = false;
+        int64 size = 0;
+        Time modified;
+        while (iter.next (&isDirectory, nullptr, &size, &modified, nullptr, nullptr))
         {
-            ScopedLock sl (lock);
-            slaveState  = "waiting";
-            running     = false;
-            formatNames = names;
+            stamp.size += size;
+            stamp.modified = jmax (stamp.modified, modified.toMilliseconds());
         }
-        
-        const bool res = launchScanner();
-        
+
+        return true;
+    }
+
+    /** Returns the cached types for a file if it hasn't changed. failed is
+        set if the file didn't scan last time */
+    bool lookup (const String& format, const String& file, OwnedArray<PluginDescription>& types, bool& failed) const
+    {
+        Stamp stamp;
+        if (! getStamp (file, stamp))
+            return false;
+
+        auto* const entry = entries [getKey (format, file)];
+        if (entry == nullptr || ! (entry->stamp == stamp))
+            return false;
+
+        failed = entry->failed;
+        for (const auto& type : entry->types)
+            types.add (new PluginDescription (type));
+        return true;
+    }
+
+    void update (const String& format, const String& file, const OwnedArray<PluginDescription>& types, bool failed)
+    {
+        Stamp stamp;
+        if (! getStamp (file, stamp))
+            return;
+
+        const auto key = getKey (format, file);
+        auto* entry = entries [key];
+        if (entry == nullptr)
         {
-            ScopedLock sl (lock);
-            running = res;
+            entry = storage.add (new Entry());
+            entries.set (key, entry);
         }
-        
-        return res;
+
+        entry->format   = format;
+        entry->file     = file;
+        entry->stamp    = stamp;
+        entry->failed   = failed;
+        entry->types.clearQuick();
+        for (const auto* const type : types)
+            entry->types.add (*type);
     }
-    
-    void handleMessageFromSlave (const MemoryBlock& mb) override
+
+    void load (const File& source)
     {
-        const auto data (mb.toString());
-        const auto type (data.upToFirstOccurrenceOf (":", false, false));
-        const auto message (data.fromFirstOccurrenceOf (":", false, false));
-        
-        if (type == "state")
+        entries.clear();
+        storage.clear();
+
+        auto xml = XmlDocument::parse (source);
+        if (xml == nullptr || ! xml->hasTagName ("pluginScanCache"))
+            return;
+
+        forEachXmlChildElementWithTagName (*xml, e, "file")
         {
-            ScopedLock sl (lock);
-            const String lastState = slaveState;
-            slaveState = message;
-            if (lastState != slaveState)
+            auto* const entry = storage.add (new Entry());
+            entry->format           = e->getStringAttribute ("format");
+            entry->file             = e->getStringAttribute ("path");
+            entry->stamp.size       = e->getStringAttribute ("size").getLargeIntValue();
+            entry->stamp.modified   = e->getStringAttribute ("modified").getLargeIntValue();
+            entry->failed           = e->getBoolAttribute ("failed");
+
+            forEachXmlChildElement (*e, t)
             {
-                ScopedUnlock sul (lock);
-                triggerAsyncUpdate();
+                PluginDescription type;
+                if (type.loadFromXml (*t))
+                    entry->types.add (type);
             }
+
+            entries.set (getKey (entry->format, entry->file), entry);
         }
-        else if (type == "name")
+    }
+
+    bool save (const File& target) const
+    {
+        XmlElement xml ("pluginScanCache");
+        for (const auto* const entry : storage)
         {
-            owner.listeners.call (&PluginScanner::Listener::audioPluginScanStarted, message.trim());
-            ScopedLock sl (lock);
-            pluginBeingScanned = message.trim();
+            auto* const e = xml.createNewChildElement ("file");
+            e->setAttribute ("format",      entry->format);
+            e->setAttribute ("path",        entry->file);
+            e->setAttribute ("size",        String (entry->stamp.size));
+            e->setAttribute ("modified",    String (entry->stamp.modified));
+            e->setAttribute ("failed",      entry->failed);
+            for (const auto& type : entry->types)
+                e->addChildElement (type.createXml().release());
         }
-        else if (type == "progress")
+
+        return xml.writeToFile (target, String());
+    }
+
+private:
+    struct Entry
+    {
+        String format, file;
+        Stamp stamp;
+        bool failed = false;
+        Array<PluginDescription> types;
+    };
+
+    OwnedArray<Entry> storage;
+    HashMap<String, Entry*> entries;
+
+    static String getKey (const String& format, const String& file) { return format + "\n" + file; }
+};
+
+// MARK: Plugin Scanner Master
+
+class PluginScannerMaster;
+
+/** One scanner process. Messages arrive on the connection's thread and are
+    handed to the master, which does everything else on the message thread */
+class PluginScannerWorker : public kv::ChildProcessMaster
+{
+public:
+    PluginScannerWorker (PluginScannerMaster& m, int s) : master (m), serial (s) { }
+    ~PluginScannerWorker() { }
+
+    bool launch()
+    {
+        return launchSlaveProcess (File::getSpecialLocation (File::invokedExecutableFile),
+                                   EL_PLUGIN_SCANNER_PROCESS_ID, EL_PLUGIN_SCANNER_DEFAULT_TIMEOUT, 0);
+    }
+
+    bool sendString (const String& type, const String& message)
+    {
+        String data = type; data << ":" << message;
+        MemoryBlock mb (data.toRawUTF8(), data.getNumBytesAsUTF8());
+        return sendMessageToSlave (mb);
+    }
+
+    void handleMessageFromSlave (const MemoryBlock& mb) override;
+    void handleConnectionLost() override;
+
+    PluginScannerMaster& master;
+    const int serial;
+
+    /** The job being scanned, and when it was handed out. Message thread only */
+    int job = -1;
+    uint32 jobStarted = 0;
+
+    /** True once the process said it was ready. Message thread only */
+    bool ready = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginScannerWorker)
+};
+
+/** Scans plugins with several scanner processes.
+
+    A thread first lists the files of every format and takes what it can from
+    the scan cache. The files left are handed out one at a time to the
+    workers. A worker which crashes or takes too long on a file is replaced,
+    and that file is blacklisted. Results are merged here and written once
+    when the last file is done.
+ */
+class PluginScannerMaster : private Thread,
+                            private AsyncUpdater,
+                            private Timer
+{
+public:
+    explicit PluginScannerMaster (PluginScanner& o)
+        : Thread ("PluginScannerMaster"), owner (o) { }
+
+    ~PluginScannerMaster()
+    {
+        stopTimer();
+        stopThread (5000);
+        cancelPendingUpdate();
+        workers.clear();
+    }
+
+    bool startScanning (const StringArray& names = StringArray())
+    {
+        jassert (MessageManager::getInstance()->isThisTheMessageThread());
+        if (isRunning())
+            return true;
+
+        // the lister may still be returning from a scan that had nothing to do
+        stopThread (2000);
+        formatNames = names;
+        paths.clear();
+
+        Settings settings;
+        for (const auto& name : formatNames)
+            paths.set (name, FileSearchPath (settings.getUserSettings()->getValue (
+                String (Settings::lastPluginScanPathPrefix) + name)));
+        numWorkers = settings.getNumPluginScanners();
+
+        merged.clear();
+        for (const auto& type : owner.list.getTypes())
+            merged.addType (type);
+        for (const auto& file : owner.list.getBlacklistedFiles())
+            merged.addToBlacklist (file);
+
+        owner.failedIdentifiers.clearQuick();
+        owner.lastError = String();
+        jobs.clearQuick();
+        nextJob = numFinished = numStartupFailures = 0;
+        running = true;
+        listed = false;
+        startThread (4);
+        return true;
+    }
+
+    bool isRunning() const noexcept { return running; }
+
+    bool sendQuitMessage()
+    {
+        if (! isRunning())
+            return false;
+        for (auto* const worker : workers)
+            worker->sendString ("quit", String());
+        return true;
+    }
+
+    void postMessage (int serial, const String& message)
+    {
         {
-            float newProgress = (float) var (message);
-            owner.listeners.call (&PluginScanner::Listener::audioPluginScanProgress, newProgress);
             ScopedLock sl (lock);
-            progress = newProgress;
+            messages.add ({ serial, message });
         }
+        triggerAsyncUpdate();
     }
-    
-    void handleConnectionLost() override
+
+private:
+    /** Workers in a row which may quit before they are ready, before giving up */
+    enum { maxStartupFailures = 3 };
+
+    PluginScanner& owner;
+
+    struct Job
     {
-        // this probably will happen when a plugin crashes.
+        String format;
+        String file;
+    };
+
+    StringArray formatNames;
+    HashMap<String, FileSearchPath> paths;
+    int numWorkers = 1;
+
+    KnownPluginList merged;
+    PluginScanCache cache;
+    Array<Job> jobs;
+    int nextJob = 0, numFinished = 0, nextSerial = 0;
+    int numStartupFailures = 0;
+    bool running = false;
+    OwnedArray<PluginScannerWorker> workers;
+
+    CriticalSection lock;
+    Array<std::pair<int, String>> messages;
+    bool listed = false;
+
+    static File getCacheFile()
+    {
+        return DataPath::applicationDataDir().getChildFile (EL_PLUGIN_SCANNER_CACHE_FILENAME);
+    }
+
+    void run() override
+    {
+        cache.load (getCacheFile());
+
+        PluginManager plugins;
+        plugins.addDefaultFormats();
+
+        Array<Job> toScan;
+        for (const auto& name : formatNames)
         {
-            ScopedLock sl (lock);
-            running = false;
+            auto* const format = plugins.getAudioPluginFormat (name);
+            if (format == nullptr)
+                continue;
+
+            for (const auto& file : format->searchPathsForPlugins (paths [name], true, false))
+            {
+                if (threadShouldExit())
+                    return;
+                if (merged.getBlacklistedFiles().contains (file))
+                    continue;
+
+                OwnedArray<PluginDescription> types;
+                bool failed = false;
+                if (cache.lookup (name, file, types, failed))
+                {
+                    if (failed)
+                        merged.addToBlacklist (file);
+                    for (const auto* const type : types)
+                        merged.addType (*type);
+                    continue;
+                }
+
+                if (merged.isListingUpToDate (file, *format))
+                {
+                    // scanned before the cache existed
+                    for (const auto& type : merged.getTypes())
+                        if (type.fileOrIdentifier == file && type.pluginFormatName == name)
+                            types.add (new PluginDescription (type));
+                    cache.update (name, file, types, false);
+                    continue;
+                }
+
+                toScan.add ({ name, file });
+            }
         }
-        
+
+        ScopedLock sl (lock);
+        jobs.swapWith (toScan);
+        listed = true;
         triggerAsyncUpdate();
     }
-    
+
     void handleAsyncUpdate() override
     {
-        const auto state = getSlaveState();
-        if (state == "ready" && isRunning())
+        Array<std::pair<int, String>> received;
+        bool justListed = false;
+
         {
-            String msg = "scan:"; msg << formatNames.joinIntoString(",");
-            MemoryBlock mb (msg.toRawUTF8(), msg.length());
-            sendMessageToSlave (mb);
+            ScopedLock sl (lock);
+            received.swapWith (messages);
+            std::swap (justListed, listed);
         }
-        else if (state == "scanning")
+
+        if (justListed && running)
+            launchWorkers();
+
+        for (const auto& message : received)
+            if (auto* const worker = findWorker (message.first))
+                handleWorkerMessage (*worker, message.second);
+    }
+
+    void launchWorkers()
+    {
+        DBG("[EL] scanning " << jobs.size() << " plugin files");
+        if (jobs.isEmpty())
+            return finish();
+
+        const int numToLaunch = jlimit (1, jobs.size(), numWorkers);
+        for (int i = 0; i < numToLaunch; ++i)
+            launchWorker();
+
+        startTimer (1000);
+    }
+
+    void launchWorker()
+    {
+        std::unique_ptr<PluginScannerWorker> worker (new PluginScannerWorker (*this, nextSerial++));
+        if (worker->launch())
+            workers.add (worker.release());
+        else
+            DBG("[EL] could not launch plugin scanner");
+
+        if (workers.isEmpty())
+            finish ("The plugin scanner process could not be launched");
+    }
+
+    PluginScannerWorker* findWorker (int serial) const
+    {
+        for (auto* const worker : workers)
+            if (worker->serial == serial)
+                return worker;
+        return nullptr;
+    }
+
+    void handleWorkerMessage (PluginScannerWorker& worker, const String& data)
+    {
+        const auto type (data.upToFirstOccurrenceOf (":", false, false));
+        const auto message (data.fromFirstOccurrenceOf (":", false, false));
+
+        if (type == "state" && message == EL_PLUGIN_SCANNER_READY_ID)
         {
-            if (! isRunning())
-            {
-                DBG("[EL] a plugin crashed or timed out during scan");
-                updateListAndLaunchSlave();
-            }
-            else
-            {
-                DBG("[EL] scanning... and running....");
-            }
-        }
-		else if (state == "finished")
-		{
-			DBG("[EL] slave finished scanning");
-			{
-				ScopedLock sl(lock);
-				running = false;
-				slaveState = "idle";
-			}
-            owner.listeners.call (&PluginScanner::Listener::audioPluginScanFinished);
-			
+            worker.ready = true;
+            numStartupFailures = 0;
+            dispatch (worker);
         }
-        else if (state == "waiting")
+        else if (type == "result" || type == "failed")
         {
-            if (! isRunning())
+            if (! isPositiveAndBelow (worker.job, jobs.size()))
+                return;
+
+            OwnedArray<PluginDescription> types;
+            if (auto xml = XmlDocument::parse (message))
             {
-                DBG("[EL] waiting for plugin scanner");
-                updateListAndLaunchSlave();
+                forEachXmlChildElement (*xml, e)
+                {
+                    std::unique_ptr<PluginDescription> desc (new PluginDescription());
+                    if (desc->loadFromXml (*e))
+                        types.add (desc.release());
+                }
             }
+
+            finishJob (worker, types);
+            dispatch (worker);
         }
-		else if (slaveState == "quitting")
-		{
-			return;
-		}
-        else
+        else if (type == "lost")
         {
-            DBG("[EL] invalid slave state: " << state);
+            DBG("[EL] a plugin crashed during scan");
+            replace (worker);
         }
     }
-    
-    const String getSlaveState() const
-    {
-        ScopedLock sl (lock);
-        return slaveState;
-    }
-    
-    float getProgress() const
-    {
-        ScopedLock sl (lock);
-        return progress;
-    }
-    
-    bool isRunning() const
+
+    /** Hands the worker its next file, or retires it when there are none */
+    void dispatch (PluginScannerWorker& worker)
     {
-        ScopedLock sl (lock);
-        return running;
+        if (nextJob >= jobs.size())
+        {
+            worker.sendString ("quit", String());
+            workers.removeObject (&worker);
+            if (workers.isEmpty())
+                finish();
+            return;
+        }
+
+        const auto& job = jobs.getReference (nextJob);
+        worker.job = nextJob++;
+        worker.jobStarted = Time::getMillisecondCounter();
+        worker.sendString ("scan", job.format + "\n" + job.file);
+        owner.listeners.call (&PluginScanner::Listener::audioPluginScanStarted,
+                              File::createFileWithoutCheckingPath (job.file).getFileName());
     }
-    
-    bool sendQuitMessage()
+
+    void finishJob (PluginScannerWorker& worker, const OwnedArray<PluginDescription>& types)
     {
-        if (isRunning())
-            return sendMessageToSlave (MemoryBlock ("quit", 4));
-        return false;
-    }
-    
-private:
-    PluginScanner& owner;
+        const auto& job = jobs.getReference (worker.job);
+        worker.job = -1;
 
-    CriticalSection lock;
-    bool running    = false;
-    float progress  = 0.f;
-    String slaveState;
-    StringArray formatNames;
-    StringArray faileFiles;
-    
-    String pluginBeingScanned;
+        // same as PluginDirectoryScanner, a file without plugins is blacklisted
+        const bool failed = types.isEmpty();
+        if (failed)
+        {
+            merged.addToBlacklist (job.file);
+            owner.failedIdentifiers.addIfNotAlreadyThere (job.file);
+        }
+        for (const auto* const type : types)
+            merged.addType (*type);
+        cache.update (job.format, job.file, types, failed);
 
-    void updateListAndLaunchSlave()
+        ++numFinished;
+        owner.listeners.call (&PluginScanner::Listener::audioPluginScanProgress,
+                              (float) numFinished / (float) jmax (1, jobs.size()));
+    }
+
+    /** Blacklists the file a worker was on and starts another worker. Gives
+        up if workers keep quitting before they are ready, since that isn't
+        the fault of any file */
+    void replace (PluginScannerWorker& worker)
     {
-        if (auto xml = XmlDocument::parse (PluginScanner::getSlavePluginListFile()))
-            owner.list.recreateFromXml (*xml);
-        
-        const bool res = launchScanner();
-        ScopedLock sl (lock);
-        running = res;
+        if (isPositiveAndBelow (worker.job, jobs.size()))
+            finishJob (worker, OwnedArray<PluginDescription>());
+
+        const bool failedToStart = ! worker.ready;
+        workers.removeObject (&worker);
+
+        if (failedToStart && ++numStartupFailures >= maxStartupFailures)
+            finish ("The plugin scanner process could not be started");
+        else if (nextJob < jobs.size())
+            launchWorker();
+        else if (workers.isEmpty())
+            finish();
     }
-    
-    void resetScannerVariables()
+
+    void timerCallback() override
     {
-        ScopedLock sl (lock);
-        pluginBeingScanned = String();
-        progress = -1.f;
+        const auto now = Time::getMillisecondCounter();
+        for (int i = workers.size(); --i >= 0 && running;)
+        {
+            auto* const worker = workers.getUnchecked (i);
+            if (worker->job >= 0 && now - worker->jobStarted > EL_PLUGIN_SCANNER_FILE_TIMEOUT)
+            {
+                DBG("[EL] plugin scan timed out: " << jobs.getReference (worker->job).file);
+                replace (*worker);
+            }
+        }
     }
-    
-    bool launchScanner (const int timeout = EL_PLUGIN_SCANNER_DEFAULT_TIMEOUT, const int flags = 0)
+
+    /** Saves the results and tells listeners. A non-empty error means the
+        scan stopped before every file was done */
+    void finish (const String& error = String())
     {
-        resetScannerVariables();
-        return launchSlaveProcess (File::getSpecialLocation (File::invokedExecutableFile),
-                                   EL_PLUGIN_SCANNER_PROCESS_ID, timeout, flags);
+        if (! running)
+            return;
+
+        stopTimer();
+        running = false;
+        workers.clear();
+
+        if (error.isNotEmpty())
+        {
+            DBG("[EL] plugin scan stopped: " << error);
+            owner.lastError = error;
+        }
+
+        cache.save (getCacheFile());
+        if (auto xml = merged.createXml())
+            xml->writeToFile (PluginScanner::getSlavePluginListFile(), String());
+
+        DBG("[EL] plugin scan finished");
+        owner.listeners.call (&PluginScanner::Listener::audioPluginScanFinished);
     }
 };
 
+void PluginScannerWorker::handleMessageFromSlave (const MemoryBlock& mb)
+{
+    master.postMessage (serial, mb.toString());
+}
+
+void PluginScannerWorker::handleConnectionLost()
+{
+    master.postMessage (serial, "lost:");
+}
+
+// MARK: Plugin Scanner Slave
+
+/** Runs in a scanner process. Scans one file at a time for the master */
 class PluginScannerSlave : public kv::ChildProcessSlave, public AsyncUpdater
 {
 public:
     PluginScannerSlave()
     {
-        scanFile = PluginScanner::getSlavePluginListFile();
         SystemStats::setApplicationCrashHandler (pluginScannerSlaveCrashHandler);
     }
     
@@ -257,106 +630,51 @@ public:
         
         if (type == "scan")
         {
-            const auto formats (StringArray::fromTokens (message.trim(), ",", "'"));
-            formatsToScan = formats;
+            {
+                ScopedLock sl (lock);
+                formatToScan = message.upToFirstOccurrenceOf ("\n", false, false);
+                fileToScan   = message.fromFirstOccurrenceOf ("\n", false, false);
+            }
             triggerAsyncUpdate();
         }
     }
     
     void handleAsyncUpdate() override
     {
-        if (! scanFile.existsAsFile())
+        String formatName, file;
         {
-            sendState ("scanning");
-            sendState ("finished");
-            return;
+            ScopedLock sl (lock);
+            formatName = formatToScan;
+            file = fileToScan;
         }
-        
-        updateScanFileWithSettings();
-        
-        sendState ("scanning");
-        
-        for (const auto& format : formatsToScan)
-            scanFor (format);
-        
-        settings->saveIfNeeded();
-        sendState ("finished");
-    }
-    
-    void updateScanFileWithSettings()
-    {
-        if (! plugins)
-            return;
-        
-        auto& list = plugins->getKnownPlugins();
-        const auto types = list.getTypes();
-        for (const auto& type : types)
-            pluginList.addType (type);
-        
-        for (const auto& file : list.getBlacklistedFiles())
-            pluginList.addToBlacklist (file);
-        
-        writePluginListNow();
+
+        OwnedArray<PluginDescription> found;
+        if (auto* format = plugins != nullptr ? plugins->getAudioPluginFormat (formatName) : nullptr)
+            format->findAllTypesForFile (found, file);
+
+        XmlElement types ("types");
+        for (const auto* const desc : found)
+            types.addChildElement (desc->createXml().release());
+        sendString (found.isEmpty() ? "failed" : "result", types.createDocument (String(), true, false));
     }
     
     void handleConnectionMade() override
     {
-        settings    = new Settings();
-        plugins     = new PluginManager();
-        
-        if (! scanFile.existsAsFile())
-            scanFile.create();
-        
-        if (auto xml = XmlDocument::parse (scanFile))
-            pluginList.recreateFromXml (*xml);
-        
-        // This must happen before user settings, PluginManager will delete the deadman file
-        // when restoring user plugins
-        PluginDirectoryScanner::applyBlacklistingsFromDeadMansPedal (
-            pluginList, plugins->getDeadAudioPluginsFile());
-        
+        plugins = new PluginManager();
         plugins->addDefaultFormats();
-        plugins->restoreUserPlugins (*settings);
-        
-        sendState (EL_PLUGIN_SCANNER_READY_ID);
+        sendString ("state", EL_PLUGIN_SCANNER_READY_ID);
     }
     
     void handleConnectionLost() override
     {
-        settings    = nullptr;
-        plugins     = nullptr;
-        scanner     = nullptr;
+        plugins = nullptr;
         exit (0);
     }
 
 private:
-    ScopedPointer<Settings> settings;
     ScopedPointer<PluginManager> plugins;
-    ScopedPointer<PluginDirectoryScanner> scanner;
-    String fileOrIdentifier;
-    KnownPluginList pluginList;
-    StringArray filesToSkip;
-    File scanFile;
-    StringArray formatsToScan;
-    
-    void applyDeadPlugins()
-    {
-        PluginDirectoryScanner::applyBlacklistingsFromDeadMansPedal (
-            pluginList, plugins->getDeadAudioPluginsFile());
-    }
-    
-    bool writePluginListNow()
-    {
-        applyDeadPlugins();
-        if (auto xml = pluginList.createXml())
-            return xml->writeToFile (scanFile, String());
-        return false;
-    }
-    
-    bool sendState (const String& state)
-    {
-        return sendString ("state", state);
-    }
+    CriticalSection lock;
+    String formatToScan, fileToScan;
     
     bool sendString (const String& type, const String& message)
     {
@@ -364,47 +682,6 @@ private:
 		MemoryBlock mb (data.toRawUTF8(), data.getNumBytesAsUTF8());
         return sendMessageToMaster (mb);
     }
-    
-    bool doNextScan()
-    {
-        const auto nextFile = scanner->getNextPluginFileThatWillBeScanned();
-        sendString ("name", nextFile);
-        for (const auto& file : scanner->getFailedFiles())
-            pluginList.addToBlacklist (file);
-
-        if (scanner->scanNextFile (true, fileOrIdentifier))
-        {
-            writePluginListNow();
-            return true;
-        }
-        
-        return false;
-    }
-    
-    void scanFor (const String& formatName)
-    {
-        if (plugins == nullptr || settings == nullptr)
-            return;
-        if (auto* format = plugins->getAudioPluginFormat (formatName))
-            scanFor (*format);
-    }
-    
-    void scanFor (AudioPluginFormat& format)
-    {
-        if (plugins == nullptr || settings == nullptr)
-            return;
-        
-        const auto key = String(settings->lastPluginScanPathPrefix) + format.getName();
-        FileSearchPath path (settings->getUserSettings()->getValue (key));
-        scanner = new PluginDirectoryScanner (pluginList, format, path, true,
-                                              plugins->getDeadAudioPluginsFile(),
-                                              false);
-        
-        while (doNextScan())
-            sendString ("progress", String (scanner->getProgress()));
-        
-        writePluginListNow();
-    }
 };
 
 // MARK: Plugin Scanner
@@ -420,7 +697,6 @@ void PluginScanner::cancel()
 {
     if (master)
     {
-        master->cancelPendingUpdate();
         master->sendQuitMessage();
 		master = nullptr;
     }
@@ -175,12 +175,17 @@ public:
     /** Returns a list of plugins that failed to load */
     const StringArray& getFailedFiles() const { return failedIdentifiers; }
 
+    /** Returns why the last scan stopped before it was done, or an empty
+        string if it wasn't stopped early */
+    const String& getLastError() const { return lastError; }
+
 private:
     friend class PluginScannerMaster;
     friend class Timer;
     ScopedPointer<PluginScannerMaster> master;
     ListenerList<Listener> listeners;
     StringArray failedIdentifiers;
+    String lastError;
     KnownPluginList& list;
     void timerCallback() override;
 };
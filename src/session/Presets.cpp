@@ -0,0 +1,520 @@
+/*
+    This file is part of Element
+    Copyright (C) 2014-2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/Presets.h"
+#include "DataPath.h"
+
+namespace Element {
+
+static const int indexVersion = 1;
+
+static String getLookupKey (const String& format, const String& identifier)
+{
+    return format + "\n" + identifier;
+}
+
+//=============================================================================
+/** Reads the start of an XML file one tag at a time. Attribute values which
+    aren't wanted are skipped without being stored, so a huge state attribute
+    costs nothing but reading past it */
+class PresetHeaderReader
+{
+public:
+    PresetHeaderReader (InputStream& source) : input (source, 8192) { }
+
+    /** Moves to the next element's opening tag and returns its name, or an
+        empty string at the end of the file */
+    String nextTag()
+    {
+        for (;;)
+        {
+            if (! skipUntil ('<'))
+                return {};
+
+            const char c = read();
+            if (c == '?' || c == '!')
+            {
+                skipUntil ('>');
+                continue;
+            }
+            if (c == '/')
+            {
+                skipUntil ('>');
+                continue;
+            }
+
+            MemoryOutputStream name;
+            for (char n = c; n != 0 && n != '>' && n != '/' && ! CharacterFunctions::isWhitespace (n); n = read())
+                name.writeByte (n);
+            pushBack = last;
+            return name.toString();
+        }
+    }
+
+    /** Reads the attributes of the current tag, storing the ones asked for */
+    bool readAttributes (const StringArray& wanted, StringPairArray& values)
+    {
+        for (;;)
+        {
+            char c = skipWhitespace();
+            if (c == 0)
+                return false;
+            if (c == '>' || c == '/')
+                return true;
+
+            MemoryOutputStream name;
+            while (c != 0 && c != '=' && ! CharacterFunctions::isWhitespace (c))
+            {
+                name.writeByte (c);
+                c = read();
+            }
+
+            if (c != '=')
+                c = skipWhitespace();
+            if (c != '=')
+                return false;
+
+            const char quote = skipWhitespace();
+            if (quote != '"' && quote != '\'')
+                return false;
+
+            const auto attribute = name.toString();
+            if (wanted.contains (attribute))
+            {
+                MemoryOutputStream value;
+                for (c = read(); c != 0 && c != quote; c = read())
+                    value.writeByte (c);
+                values.set (attribute, unescape (value.toString()));
+            }
+            else if (! skipUntil (quote))
+            {
+                return false;
+            }
+        }
+    }
+
+private:
+    BufferedInputStream input;
+    char last = 0, pushBack = 0;
+
+    char read()
+    {
+        if (pushBack != 0)
+        {
+            last = pushBack;
+            pushBack = 0;
+            return last;
+        }
+
+        last = input.isExhausted() ? 0 : input.readByte();
+        return last;
+    }
+
+    bool skipUntil (char wanted)
+    {
+        for (char c = read(); c != 0; c = read())
+            if (c == wanted)
+                return true;
+        return false;
+    }
+
+    char skipWhitespace()
+    {
+        char c = read();
+        while (c != 0 && CharacterFunctions::isWhitespace (c))
+            c = read();
+        return c;
+    }
+
+    static String unescape (const String& text)
+    {
+        if (! text.containsChar ('&'))
+            return text;
+
+        String result;
+        auto t = text.getCharPointer();
+        while (! t.isEmpty())
+        {
+            const auto c = t.getAndAdvance();
+            if (c != '&')
+            {
+                result << String::charToString (c);
+                continue;
+            }
+
+            String entity;
+            while (! t.isEmpty() && *t != ';')
+                entity << String::charToString (t.getAndAdvance());
+            if (! t.isEmpty())
+                ++t;
+
+            if (entity == "amp")            result << '&';
+            else if (entity == "lt")        result << '<';
+            else if (entity == "gt")        result << '>';
+            else if (entity == "quot")      result << '"';
+            else if (entity == "apos")      result << '\'';
+            else if (entity.startsWith ("#x"))
+                result << String::charToString ((juce_wchar) entity.substring (2).getHexValue32());
+            else if (entity.startsWith ("#"))
+                result << String::charToString ((juce_wchar) entity.substring (1).getIntValue());
+        }
+
+        return result;
+    }
+};
+
+bool PresetCollection::readPresetHeader (const File& file, PresetDescription& preset)
+{
+    FileInputStream stream (file);
+    if (! stream.openedOk())
+        return false;
+
+    PresetHeaderReader reader (stream);
+    StringPairArray values;
+    String name;
+
+    auto tag = reader.nextTag();
+    const bool isWrapped = tag == Tags::preset.toString();
+    if (isWrapped)
+    {
+        if (! reader.readAttributes ({ "name" }, values))
+            return false;
+        name = values ["name"];
+        values.clear();
+        tag = reader.nextTag();
+    }
+
+    if (tag != Tags::node.toString() ||
+        ! reader.readAttributes ({ "name", "format", "identifier" }, values))
+        return false;
+
+    // same naming as Node::parse, a wrapped node is named after its preset
+    if (! isWrapped)
+        name = values ["name"];
+
+    preset.file         = file;
+    preset.name         = name.isNotEmpty() ? name : file.getFileNameWithoutExtension();
+    preset.format       = values ["format"];
+    preset.identifier   = values ["identifier"];
+    return true;
+}
+
+//=============================================================================
+struct PresetCollection::Entry
+{
+    PresetDescription description;
+    int64 size;
+    int64 modified;
+};
+
+struct PresetCollection::Index
+{
+    int generation = 0;
+    OwnedArray<Entry> entries;
+    HashMap<String, int> byPlugin;
+    OwnedArray<Array<Entry*>> buckets;
+
+    void add (Entry* entry)
+    {
+        entries.add (entry);
+        const auto key = getLookupKey (entry->description.format, entry->description.identifier);
+        if (! byPlugin.contains (key))
+        {
+            byPlugin.set (key, buckets.size());
+            buckets.add (new Array<Entry*>());
+        }
+
+        buckets.getUnchecked (byPlugin [key])->add (entry);
+    }
+
+    /** Sorts each plugin's presets by name. Call after adding everything */
+    void finish()
+    {
+        struct Sorter
+        {
+            static int compareElements (const Entry* a, const Entry* b)
+            {
+                return a->description.name.compare (b->description.name);
+            }
+        } sorter;
+
+        for (auto* const bucket : buckets)
+            bucket->sort (sorter, true);
+        entries.minimiseStorageOverheads();
+    }
+
+    const Array<Entry*>* find (const String& format, const String& identifier) const
+    {
+        const auto key = getLookupKey (format, identifier);
+        return byPlugin.contains (key) ? buckets.getUnchecked (byPlugin [key]) : nullptr;
+    }
+};
+
+//=============================================================================
+PresetCollection::PresetCollection()
+    : PresetCollection (DataPath().getRootDir().getChildFile ("Presets"),
+                        DataPath::applicationDataDir().getChildFile ("PresetIndex.dat")) { }
+
+PresetCollection::PresetCollection (const File& dir, const File& file)
+    : Thread ("PresetCollection"),
+      presetsDir (dir), indexFile (file),
+      index (std::make_shared<Index>()) { }
+
+PresetCollection::~PresetCollection()
+{
+    stopThread (5000);
+    cancelPendingUpdate();
+}
+
+void PresetCollection::clear()
+{
+    ScopedLock sl (lock);
+    auto empty = std::make_shared<Index>();
+    empty->generation = ++generation;
+    index = empty;
+}
+
+int PresetCollection::getNumPresets() const
+{
+    return index->entries.size();
+}
+
+void PresetCollection::getPresetsFor (const Node& node, OwnedArray<PresetDescription>& results) const
+{
+    getPresetsFor (node.getFormat().toString(), node.getIdentifier().toString(), results);
+}
+
+void PresetCollection::getPresetsFor (const String& format, const String& identifier,
+                                      OwnedArray<PresetDescription>& results) const
+{
+    if (const auto* const bucket = index->find (format, identifier))
+        for (const auto* const entry : *bucket)
+            results.add (new PresetDescription (entry->description));
+}
+
+void PresetCollection::refresh()
+{
+    jassert (MessageManager::getInstance()->isThisTheMessageThread());
+
+    // a running scan would only be replaced by this one
+    stopThread (-1);
+
+    int newGeneration;
+    {
+        ScopedLock sl (lock);
+        scanning = false;
+        newGeneration = ++generation;
+    }
+
+    auto updated = scan (index, newGeneration, false);
+    {
+        ScopedLock sl (lock);
+        index = updated;
+    }
+    sendChangeMessage();
+}
+
+void PresetCollection::refreshInBackground()
+{
+    jassert (MessageManager::getInstance()->isThisTheMessageThread());
+    {
+        ScopedLock sl (lock);
+        if (scanning)
+        {
+            rescanRequested.store (true);
+            return;
+        }
+        scanning = true;
+    }
+
+    // the last scan could still be returning from run()
+    waitForThreadToExit (-1);
+    startThread (3);
+}
+
+PresetCollection::IndexPtr PresetCollection::scan (IndexPtr previous, int newGeneration, bool canCancel)
+{
+    if (previous == nullptr || previous->entries.isEmpty())
+        previous = loadIndexFile();
+
+    HashMap<String, const Entry*> known;
+    for (const auto* const entry : previous->entries)
+        known.set (entry->description.file.getFullPathName(), entry);
+
+    auto updated = std::make_shared<Index>();
+    updated->generation = newGeneration;
+    bool changed = false;
+
+    if (presetsDir.isDirectory())
+    {
+        DirectoryIterator iter (presetsDir, true, EL_PRESET_FILE_EXTENSIONS);
+        int64 size = 0;
+        Time modTime;
+
+        while (iter.next (nullptr, nullptr, &size, &modTime, nullptr, nullptr))
+        {
+            if (canCancel && threadShouldExit())
+                return nullptr;
+
+            const auto file = iter.getFile();
+            const auto modified = modTime.toMilliseconds();
+
+            const auto* const old = known [file.getFullPathName()];
+            if (old != nullptr && old->size == size && old->modified == modified)
+            {
+                updated->add (new Entry (*old));
+                continue;
+            }
+
+            changed = true;
+            std::unique_ptr<Entry> entry (new Entry());
+            entry->size = size;
+            entry->modified = modified;
+
+            auto& desc = entry->description;
+            if (! readPresetHeader (file, desc))
+            {
+                // binary and older presets
+                const Node node (Node::parse (file), false);
+                if (! node.isValid())
+                    continue;
+                desc.file       = file;
+                desc.name       = node.getName();
+                desc.format     = node.getFormat();
+                desc.identifier = node.getIdentifier();
+                if (desc.name.isEmpty())
+                    desc.name = file.getFileNameWithoutExtension();
+            }
+
+            if (desc.format.isEmpty() || desc.identifier.isEmpty())
+                continue;
+
+            updated->add (entry.release());
+        }
+    }
+
+    updated->finish();
+    if (changed || updated->entries.size() != previous->entries.size())
+        saveIndexFile (*updated);
+
+    return updated;
+}
+
+PresetCollection::IndexPtr PresetCollection::loadIndexFile() const
+{
+    auto loaded = std::make_shared<Index>();
+    FileInputStream stream (indexFile);
+    if (! stream.openedOk())
+        return loaded;
+
+    const auto data = ValueTree::readFromStream (stream);
+    if (! data.hasType ("presetIndex") || (int) data.getProperty ("version") != indexVersion)
+        return loaded;
+
+    for (int i = 0; i < data.getNumChildren(); ++i)
+    {
+        const auto child = data.getChild (i);
+        auto* entry = new Entry();
+        entry->description.file         = File (child.getProperty ("file").toString());
+        entry->description.name         = child.getProperty (Tags::name).toString();
+        entry->description.format       = child.getProperty (Tags::format).toString();
+        entry->description.identifier   = child.getProperty (Tags::identifier).toString();
+        entry->size                     = (int64) child.getProperty ("size");
+        entry->modified                 = (int64) child.getProperty ("modified");
+        loaded->add (entry);
+    }
+
+    loaded->finish();
+    return loaded;
+}
+
+void PresetCollection::saveIndexFile (const Index& data)
+{
+    ValueTree tree ("presetIndex");
+    tree.setProperty ("version", indexVersion, nullptr);
+
+    for (const auto* const entry : data.entries)
+    {
+        ValueTree child (Tags::preset);
+        child.setProperty ("file",              entry->description.file.getFullPathName(), nullptr)
+             .setProperty (Tags::name,          entry->description.name, nullptr)
+             .setProperty (Tags::format,        entry->description.format, nullptr)
+             .setProperty (Tags::identifier,    entry->description.identifier, nullptr)
+             .setProperty ("size",              entry->size, nullptr)
+             .setProperty ("modified",          entry->modified, nullptr);
+        tree.appendChild (child, nullptr);
+    }
+
+    ScopedLock sl (saveLock);
+    TemporaryFile tempFile (indexFile);
+    if (auto out = std::unique_ptr<FileOutputStream> (tempFile.getFile().createOutputStream()))
+    {
+        tree.writeToStream (*out);
+        out.reset();
+        tempFile.overwriteTargetFileWithTemporary();
+    }
+}
+
+void PresetCollection::run()
+{
+    for (;;)
+    {
+        rescanRequested.store (false);
+
+        IndexPtr previous;
+        int newGeneration;
+        {
+            ScopedLock sl (lock);
+            previous = index;
+            newGeneration = ++generation;
+        }
+
+        auto updated = scan (previous, newGeneration, true);
+
+        ScopedLock sl (lock);
+        if (updated != nullptr)
+        {
+            pending = updated;
+            triggerAsyncUpdate();
+        }
+
+        if (updated == nullptr || ! rescanRequested.load() || threadShouldExit())
+        {
+            scanning = false;
+            break;
+        }
+    }
+}
+
+void PresetCollection::handleAsyncUpdate()
+{
+    IndexPtr updated;
+    {
+        ScopedLock sl (lock);
+        updated.swap (pending);
+        // a newer scan or clear() may have finished first
+        if (updated == nullptr || updated->generation <= index->generation)
+            return;
+        index = updated;
+    }
+
+    sendChangeMessage();
+}
+
+}
@@ -32,7 +32,21 @@ struct PresetDescription
     File file;
 };
 
-class PresetCollection
+/** An index of the user's presets.
+
+    The index is kept in a file between runs. Entries are keyed by path,
+    modification time and size, so a refresh only reads presets which were
+    added or changed. Only the start of a preset file is read, up to the end
+    of its node's opening tag, which is enough for name, format and
+    identifier. Presets are looked up by plugin through a hash table.
+
+    Lookups and refreshes are for the message thread. A background refresh
+    builds a new index on a worker thread and swaps it in when done, sending
+    a change message.
+ */
+class PresetCollection : public ChangeBroadcaster,
+                         private Thread,
+                         private AsyncUpdater
 {
 public:
     struct SortByName
@@ -49,59 +63,65 @@ public:
         }
     };
 
-    PresetCollection() { }
-    ~PresetCollection() { }
+    /** Indexes presets in the user's data path */
+    PresetCollection();
 
-    inline void clear()
-    {
-        presets.clear();
-    }
+    /** Indexes presets in a directory, keeping the index in indexFile */
+    PresetCollection (const File& presetsDir, const File& indexFile);
 
-    inline void getPresetsFor (const Node& node, OwnedArray<PresetDescription>& results) const
-    {
-        SortByName sorter;
-        for (const auto* const preset : presets)
-            if (preset->identifier == node.getIdentifier().toString() && preset->format == node.getFormat().toString())
-                results.addSorted (sorter, new PresetDescription (*preset));
-    }
+    ~PresetCollection();
+
+    /** Forgets every preset. The index file is kept */
+    void clear();
+
+    /** Adds copies of the presets for a node's plugin, in name order */
+    void getPresetsFor (const Node& node, OwnedArray<PresetDescription>& results) const;
+
+    /** Adds copies of the presets for a plugin, in name order */
+    void getPresetsFor (const String& format, const String& identifier,
+                        OwnedArray<PresetDescription>& results) const;
+
+    /** Number of presets indexed */
+    int getNumPresets() const;
 
     inline void addPresetFor (const Node& node, const String& name)
     {
         jassertfalse;
     }
 
-    inline void refresh()
-    {
-        clear();
-        
-        StringArray files; path.findPresetFiles (files);
-        for (const auto& filename : files)
-        {
-            const File file (filename);
-            const Node node (Node::parse (file), false);
-            if (node.isValid())
-            {
-                std::unique_ptr<PresetDescription> item;
-                item.reset (new PresetDescription());
-                item->file          = file;
-                item->name          = node.getName();
-                if (item->name.isEmpty())
-                    item->name = file.getFileNameWithoutExtension();
-                item->format        = node.getFormat();
-                item->identifier    = node.getIdentifier();
-                if (item->format.isEmpty() || item->identifier.isEmpty())
-                    continue;
-
-                presets.add (item.release());
-            }
-        }
+    /** Updates the index now, reading only new and changed presets */
+    void refresh();
 
-        presets.minimiseStorageOverheads();
-    }
+    /** Updates the index on a background thread */
+    void refreshInBackground();
+
+    /** Reads the name, format and identifier of an XML preset, stopping at
+        the end of the node's opening tag. Returns false if the file isn't
+        an XML preset */
+    static bool readPresetHeader (const File&, PresetDescription&);
 
 private:
-    DataPath path;
-    OwnedArray<PresetDescription> presets;
+    struct Entry;
+    struct Index;
+    using IndexPtr = std::shared_ptr<const Index>;
+
+    File presetsDir, indexFile;
+    IndexPtr index;
+    int generation = 0;
+
+    CriticalSection lock, saveLock;
+    IndexPtr pending;
+    bool scanning = false;
+    std::atomic<bool> rescanRequested { false };
+
+    IndexPtr scan (IndexPtr previous, int generation, bool canCancel);
+    IndexPtr loadIndexFile() const;
+    void saveIndexFile (const Index&);
+
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PresetCollection)
 };
 
 }
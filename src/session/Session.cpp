@@ -25,6 +25,7 @@
 #include "Globals.h"
 
 #include "session/Session.h"
+#include "session/SessionWriter.h"
 
 namespace Element {
 
@@ -120,6 +121,7 @@ namespace Element {
     {
         ValueTree saveData = objectData.createCopy();
         Node::sanitizeProperties (saveData, true);
+        Node::encodeStateProperties (saveData);
         return saveData.createXml();
     }
 
@@ -145,6 +147,7 @@ namespace Element {
         objectData.getOrCreateChildWithName (Tags::graphs, nullptr);
         objectData.getOrCreateChildWithName (Tags::controllers, nullptr);
         objectData.getOrCreateChildWithName (Tags::maps, nullptr);
+        objectData.getOrCreateChildWithName (Tags::tempoMap, nullptr);
     }
 
     Node Session::findNodeById (const Uuid& uuid)
@@ -305,23 +308,12 @@ namespace Element {
             .setProperty (Tags::active, index, nullptr);
     }
 
-    bool Session::writeToFile (const File& file) const
+    bool Session::writeToFile (const File& file, int compressionLevel) const
     {
         ValueTree saveData = objectData.createCopy();
         Node::sanitizeProperties (saveData, true);
-        TemporaryFile tempFile (file);
-
-        if (auto fos = std::unique_ptr<FileOutputStream> (tempFile.getFile().createOutputStream()))
-        {
-            {
-                GZIPCompressorOutputStream gzip (*fos, 9);
-                saveData.writeToStream (gzip);
-            }
-            fos.reset();
-            return tempFile.overwriteTargetFileWithTemporary();
-        }
-
-        return false;
+        return SessionWriter::writeSnapshot (saveData, file, SessionWriter::compressedFormat,
+                                             compressionLevel).wasOk();
     }
 
     ValueTree Session::readFromFile (const File& file)
@@ -21,6 +21,7 @@
 #include "ElementApp.h"
 #include "session/ControllerDevice.h"
 #include "session/Node.h"
+#include "session/TempoMap.h"
 #include "Signals.h"
 
 #define EL_TEMPO_MIN 20
@@ -104,6 +105,9 @@ namespace Element {
         inline ControllerMap getControllerMap (const int index) const { return ControllerMap (getControllerMapsValueTree().getChild (index)); }
         inline int indexOf (const ControllerMap& controllerMap) const { return getControllerMapsValueTree().indexOf (controllerMap.getValueTree()); }
         
+        /** The session's tempo and meter changes */
+        inline TempoMap getTempoMap() const { return TempoMap (objectData.getChildWithName (Tags::tempoMap)); }
+
         Node findNodeById (const Uuid&);
         ControllerDevice findControllerDeviceById (const Uuid&);
 
@@ -115,8 +119,9 @@ namespace Element {
         void setActiveGraph (int index);
         bool containsGraph (const Node& graph) const;
 
-        /** Writes an encoded file */
-        bool writeToFile (const File&) const;
+        /** Writes an encoded file on the calling thread. Use SessionWriter to
+            save without blocking the message thread */
+        bool writeToFile (const File&, int compressionLevel = 9) const;
         static ValueTree readFromFile (const File&);
         
         Value getActiveGraphIndexObject (bool syncUpdate = false) const
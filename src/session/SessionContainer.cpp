@@ -0,0 +1,377 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/SessionContainer.h"
+
+namespace Element {
+
+static const char magic[4]      = { 'E', 'L', 'S', 'C' };
+static const int formatVersion  = 1;
+static const int64 headerSize   = 8;
+static const int64 entrySize    = 24;
+static const int64 trailerSize  = 32;
+
+/** Deflate can't do better than about 1032:1, so a chunk claiming to
+    expand further is damaged. Checked before anything is allocated for it */
+static const int64 maxCompressionRatio = 1032;
+
+static const Identifier stateChunk        ("stateChunk");
+static const Identifier programStateChunk ("programStateChunk");
+
+/** Node properties which are moved to chunks, with the property referencing the chunk */
+static const std::pair<Identifier, Identifier> chunkedProperties[] = {
+    { Tags::state,          stateChunk },
+    { Tags::programState,   programStateChunk }
+};
+
+static ValueTree createModel (const ValueTree& data, Array<const var*>& states)
+{
+    ValueTree model (data.getType());
+
+    for (int i = 0; i < data.getNumProperties(); ++i)
+    {
+        const auto name = data.getPropertyName (i);
+        const auto& value = data.getProperty (name);
+
+        Identifier chunkName;
+        if (data.hasType (Tags::node))
+            for (const auto& chunked : chunkedProperties)
+                if (chunked.first == name)
+                    chunkName = chunked.second;
+
+        if (chunkName.isValid() && ! value.isVoid())
+        {
+            model.setProperty (chunkName, states.size(), nullptr);
+            states.add (&value);
+        }
+        else
+        {
+            model.setProperty (name, value, nullptr);
+        }
+    }
+
+    for (int i = 0; i < data.getNumChildren(); ++i)
+        model.appendChild (createModel (data.getChild (i), states), nullptr);
+
+    return model;
+}
+
+//=============================================================================
+struct SessionContainer::Target
+{
+    MemoryBlock* state;
+    ValueTree node;
+    Identifier property;
+    int chunk;
+    bool ok;
+};
+
+class SessionContainer::DecodeJob : public ThreadPoolJob
+{
+public:
+    DecodeJob (const SessionContainer& c, Array<Target>& t, std::atomic<int>& n)
+        : ThreadPoolJob ("SessionContainer"), container (c), targets (t), next (n) { }
+
+    JobStatus runJob() override
+    {
+        for (int i = next++; i < targets.size(); i = next++)
+        {
+            auto& target = targets.getReference (i);
+            target.ok = container.readChunk (target.chunk, *target.state);
+        }
+
+        return jobHasFinished;
+    }
+
+private:
+    const SessionContainer& container;
+    Array<Target>& targets;
+    std::atomic<int>& next;
+};
+
+//=============================================================================
+SessionContainer::SessionContainer() { }
+SessionContainer::~SessionContainer() { }
+
+bool SessionContainer::isContainer (const File& f)
+{
+    FileInputStream in (f);
+    char header [4] = { 0 };
+    return in.openedOk() && in.read (header, 4) == 4 && memcmp (header, magic, 4) == 0;
+}
+
+Result SessionContainer::write (const ValueTree& session, OutputStream& out, int compressionLevel)
+{
+    if (! session.isValid())
+        return Result::fail ("No session data to write");
+
+    compressionLevel = jlimit (0, 9, compressionLevel);
+    Array<const var*> states;
+    const auto model = createModel (session, states);
+
+    const int64 start = out.getPosition();
+    out.write (magic, 4);
+    out.writeInt (formatVersion);
+
+    Array<Entry> table;
+    MemoryBlock decoded;
+
+    for (const auto* value : states)
+    {
+        const MemoryBlock* data = value->getBinaryData();
+        if (data == nullptr)
+        {
+            // sessions loaded from XML still hold base64 until their plugins are saved
+            decoded.reset();
+            decoded.fromBase64Encoding (value->toString().trim());
+            data = &decoded;
+        }
+
+        MemoryOutputStream compressed;
+        if (compressionLevel > 0 && data->getSize() > 0)
+        {
+            GZIPCompressorOutputStream gzip (compressed, compressionLevel);
+            gzip.write (data->getData(), data->getSize());
+        }
+
+        // a lot of state, like samples, doesn't compress. store it as is
+        const bool useCompressed = compressed.getDataSize() > 0 && compressed.getDataSize() < data->getSize();
+
+        Entry entry;
+        entry.offset     = out.getPosition() - start;
+        entry.size       = (int64) data->getSize();
+        entry.storedSize = useCompressed ? (int64) compressed.getDataSize() : entry.size;
+        table.add (entry);
+
+        if (! out.write (useCompressed ? compressed.getData() : data->getData(), (size_t) entry.storedSize))
+            return Result::fail ("Could not write plugin state");
+    }
+
+    const int64 modelOffset = out.getPosition() - start;
+    {
+        GZIPCompressorOutputStream gzip (out, compressionLevel);
+        model.writeToStream (gzip);
+    }
+    const int64 modelSize = out.getPosition() - start - modelOffset;
+
+    const int64 tableOffset = out.getPosition() - start;
+    for (const auto& entry : table)
+    {
+        out.writeInt64 (entry.offset);
+        out.writeInt64 (entry.storedSize);
+        out.writeInt64 (entry.size);
+    }
+
+    out.writeInt64 (modelOffset);
+    out.writeInt64 (modelSize);
+    out.writeInt64 (tableOffset);
+    out.writeInt (table.size());
+    if (! out.write (magic, 4))
+        return Result::fail ("Could not write session data");
+
+    return Result::ok();
+}
+
+Result SessionContainer::open (const File& f)
+{
+    close();
+
+    std::unique_ptr<MemoryMappedFile> mapped (new MemoryMappedFile (f, MemoryMappedFile::readOnly));
+    const auto* data = static_cast<const char*> (mapped->getData());
+    const auto size  = (int64) mapped->getSize();
+
+    if (data == nullptr || size < headerSize + trailerSize || memcmp (data, magic, 4) != 0)
+        return Result::fail ("Not a session file: " + f.getFullPathName());
+    if ((int) ByteOrder::littleEndianInt (data + 4) > formatVersion)
+        return Result::fail ("The session was saved by a newer version");
+
+    const char* const trailer = data + size - trailerSize;
+    if (memcmp (trailer + 28, magic, 4) != 0)
+        return Result::fail ("The session file is incomplete");
+
+    const int64 modelOffset = (int64) ByteOrder::littleEndianInt64 (trailer);
+    const int64 modelSize   = (int64) ByteOrder::littleEndianInt64 (trailer + 8);
+    const int64 tableOffset = (int64) ByteOrder::littleEndianInt64 (trailer + 16);
+    const int numChunks     = (int) ByteOrder::littleEndianInt (trailer + 24);
+    const int64 dataEnd     = size - trailerSize;
+
+    auto isInFile = [dataEnd] (int64 offset, int64 length) {
+        return length >= 0 && offset >= headerSize && offset <= dataEnd - length;
+    };
+
+    if (numChunks < 0 || ! isInFile (modelOffset, modelSize) ||
+        ! isInFile (tableOffset, (int64) numChunks * entrySize) ||
+        tableOffset + (int64) numChunks * entrySize != dataEnd)
+    {
+        return Result::fail ("The session file is damaged");
+    }
+
+    Array<Entry> table;
+    table.ensureStorageAllocated (numChunks);
+    for (int i = 0; i < numChunks; ++i)
+    {
+        const char* const e = data + tableOffset + i * entrySize;
+        Entry entry;
+        entry.offset     = (int64) ByteOrder::littleEndianInt64 (e);
+        entry.storedSize = (int64) ByteOrder::littleEndianInt64 (e + 8);
+        entry.size       = (int64) ByteOrder::littleEndianInt64 (e + 16);
+        if (! isInFile (entry.offset, entry.storedSize) || entry.size < entry.storedSize ||
+            entry.size > entry.storedSize * maxCompressionRatio)
+            return Result::fail ("The session file is damaged");
+        table.add (entry);
+    }
+
+    ValueTree tree;
+    {
+        MemoryInputStream in (data + modelOffset, (size_t) modelSize, false);
+        GZIPDecompressorInputStream gzip (in);
+        tree = ValueTree::readFromStream (gzip);
+    }
+
+    if (! tree.isValid())
+        return Result::fail ("The session file is damaged");
+
+    file  = std::move (mapped);
+    model = tree;
+    entries.swapWith (table);
+    return Result::ok();
+}
+
+void SessionContainer::close()
+{
+    entries.clearQuick();
+    model = ValueTree();
+    file.reset();
+}
+
+ValueTree SessionContainer::getModel() const
+{
+    return model.createCopy();
+}
+
+const char* SessionContainer::getData (int64 offset) const noexcept
+{
+    return static_cast<const char*> (file->getData()) + offset;
+}
+
+bool SessionContainer::readChunk (int index, MemoryBlock& dest) const
+{
+    if (! isOpen() || ! isPositiveAndBelow (index, entries.size()))
+        return false;
+
+    const auto& entry = entries.getReference (index);
+    dest.setSize ((size_t) entry.size, false);
+
+    if (entry.storedSize == entry.size)
+    {
+        memcpy (dest.getData(), getData (entry.offset), (size_t) entry.size);
+        return true;
+    }
+
+    MemoryInputStream in (getData (entry.offset), (size_t) entry.storedSize, false);
+    GZIPDecompressorInputStream gzip (in);
+
+    int64 numRead = 0;
+    while (numRead < entry.size)
+    {
+        const int n = gzip.read (static_cast<char*> (dest.getData()) + numRead,
+                                 (int) jmin (entry.size - numRead, (int64) 1 << 30));
+        if (n <= 0)
+            break;
+        numRead += n;
+    }
+
+    return numRead == entry.size;
+}
+
+bool SessionContainer::restoreState (ValueTree tree, int numThreads) const
+{
+    if (! isOpen())
+        return false;
+
+    Array<Target> targets;
+    std::function<void(ValueTree)> collect = [&] (ValueTree data)
+    {
+        for (const auto& chunked : chunkedProperties)
+        {
+            if (! data.hasProperty (chunked.second))
+                continue;
+
+            const int chunk = data.getProperty (chunked.second);
+            data.removeProperty (chunked.second, nullptr);
+            data.setProperty (chunked.first, var (MemoryBlock()), nullptr);
+
+            // decoded straight into the block the tree owns
+            targets.add ({ data.getProperty (chunked.first).getBinaryData(),
+                           data, chunked.first, chunk, false });
+        }
+
+        for (int i = 0; i < data.getNumChildren(); ++i)
+            collect (data.getChild (i));
+    };
+
+    collect (tree);
+
+    std::atomic<int> next { 0 };
+    numThreads = numThreads > 0 ? numThreads : SystemStats::getNumCpus();
+    numThreads = jlimit (1, jmax (1, targets.size()), numThreads);
+
+    if (numThreads == 1)
+    {
+        DecodeJob (*this, targets, next).runJob();
+    }
+    else
+    {
+        OwnedArray<DecodeJob> jobs;
+        ThreadPool pool (numThreads);
+        for (int i = 0; i < numThreads; ++i)
+            pool.addJob (jobs.add (new DecodeJob (*this, targets, next)), false);
+        for (auto* const job : jobs)
+            pool.waitForJobToFinish (job, -1);
+    }
+
+    bool ok = true;
+    for (auto& target : targets)
+    {
+        if (target.ok)
+            continue;
+        DBG("[EL] could not read state chunk " << target.chunk);
+        target.node.removeProperty (target.property, nullptr);
+        ok = false;
+    }
+
+    return ok;
+}
+
+ValueTree SessionContainer::read (const File& f, int numThreads)
+{
+    SessionContainer container;
+    const auto result = container.open (f);
+    if (result.failed())
+    {
+        DBG("[EL] " << result.getErrorMessage());
+        return {};
+    }
+
+    auto tree = container.getModel();
+    container.restoreState (tree, numThreads);
+    return tree;
+}
+
+}
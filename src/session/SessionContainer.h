@@ -0,0 +1,117 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+/** A binary session file with plugin state kept out of the model.
+
+    The session model is stored as one small compressed tree. Every plugin
+    state and program state is stored as its own chunk, compressed unless
+    that doesn't make it smaller, and the model refers to chunks by index.
+    An offset table at the end of the file locates the model and chunks.
+
+    Files are memory mapped when opened, so only the chunks which get
+    decoded are ever read from disk. This lets a single graph be loaded
+    from a large session, and chunks to be decoded on several threads.
+
+    Layout, all integers little endian:
+    @code
+    "ELSC" version
+    chunk data...
+    model data
+    offset table    { int64 offset, int64 storedSize, int64 size } per chunk
+    trailer         int64 modelOffset, int64 modelSize, int64 tableOffset,
+                    int32 numChunks, "ELSC"
+    @endcode
+ */
+class SessionContainer
+{
+public:
+    SessionContainer();
+    ~SessionContainer();
+
+    /** Returns true if the file starts like a session container */
+    static bool isContainer (const File&);
+
+    /** Writes a session snapshot. Binary and base64 plugin state both end
+        up as raw chunks.
+
+        @param session          The session tree, usually from SessionWriter::createSnapshot
+        @param out              Where to write
+        @param compressionLevel 0 (none) to 9 (smallest) for chunks and the model
+     */
+    static Result write (const ValueTree& session, OutputStream& out, int compressionLevel = 6);
+
+    /** Opens and checks a file. Nothing but the model is read yet */
+    Result open (const File&);
+
+    /** Releases the file */
+    void close();
+
+    /** True if a file is open */
+    bool isOpen() const noexcept { return file != nullptr; }
+
+    /** Returns a new copy of the session model. Plugin state is left as
+        chunk references until restoreState() is used on the tree */
+    ValueTree getModel() const;
+
+    /** Number of state chunks in the file */
+    int getNumChunks() const noexcept { return entries.size(); }
+
+    /** Decodes one chunk. Can be called from any thread */
+    bool readChunk (int index, MemoryBlock& dest) const;
+
+    /** Decodes the state of every node in the tree, including the tree
+        itself, and replaces the chunk references with it. Use this on
+        trees from getModel() before they are handed to a session.
+
+        @param tree         A model tree, or part of one like a single graph
+        @param numThreads   Threads to decode with, zero uses one per CPU
+        @returns            False if any chunk could not be read
+      */
+    bool restoreState (ValueTree tree, int numThreads = 0) const;
+
+    /** Opens a file and returns the whole session with state restored, or
+        an invalid tree on failure */
+    static ValueTree read (const File&, int numThreads = 0);
+
+private:
+    struct Entry
+    {
+        int64 offset;
+        int64 storedSize;
+        int64 size;
+    };
+
+    std::unique_ptr<MemoryMappedFile> file;
+    Array<Entry> entries;
+    ValueTree model;
+
+    struct Target;
+    class DecodeJob;
+    const char* getData (int64 offset) const noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SessionContainer)
+};
+
+}
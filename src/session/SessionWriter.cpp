@@ -0,0 +1,208 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/Node.h"
+#include "session/Session.h"
+#include "session/SessionContainer.h"
+#include "session/SessionWriter.h"
+
+namespace Element {
+
+SessionWriter::SessionWriter()
+    : Thread ("SessionWriter") { }
+
+SessionWriter::~SessionWriter()
+{
+    // don't lose a save when quitting
+    waitUntilFinished();
+    signalThreadShouldExit();
+    jobAdded.signal();
+    stopThread (2000);
+    cancelPendingUpdate();
+}
+
+ValueTree SessionWriter::createSnapshot (Session& session)
+{
+    jassert (MessageManager::getInstance()->isThisTheMessageThread());
+    session.saveGraphState();
+
+    // Sanitizing here also drops the node objects before another thread
+    // could end up holding the last reference to one
+    ValueTree data = session.getValueTree().createCopy();
+    Node::sanitizeProperties (data, true);
+    return data;
+}
+
+void SessionWriter::write (const ValueTree& snapshot, const File& file, Format format,
+                           int compressionLevel, Callback callback)
+{
+    {
+        ScopedLock sl (lock);
+
+        Job* job = nullptr;
+        for (auto* const j : pending)
+            if (j->file == file)
+                job = j;
+
+        if (job != nullptr)
+        {
+            if (job->callback && callback)
+            {
+                auto previous = std::move (job->callback);
+                job->callback = [previous, callback] (const File& f, const Result& r)
+                {
+                    previous (f, r);
+                    callback (f, r);
+                };
+            }
+            else if (callback)
+            {
+                job->callback = std::move (callback);
+            }
+        }
+        else
+        {
+            job = pending.add (new Job());
+            job->file = file;
+            job->callback = std::move (callback);
+            ++numActive;
+        }
+
+        job->data               = snapshot;
+        job->format             = format;
+        job->compressionLevel   = compressionLevel;
+    }
+
+    if (! isThreadRunning())
+        startThread (3);
+    jobAdded.signal();
+}
+
+bool SessionWriter::waitUntilFinished (int timeoutMs)
+{
+    const auto start = Time::getMillisecondCounter();
+    while (isWriting())
+    {
+        if (timeoutMs >= 0 && Time::getMillisecondCounter() - start >= (uint32) timeoutMs)
+            return false;
+        jobDone.wait (50);
+    }
+
+    return true;
+}
+
+Result SessionWriter::writeSnapshot (const ValueTree& data, const File& file,
+                                     Format format, int compressionLevel)
+{
+    if (! data.isValid())
+        return Result::fail ("No session data to write");
+
+    TemporaryFile tempFile (file);
+
+    {
+        std::unique_ptr<FileOutputStream> out (tempFile.getFile().createOutputStream());
+        if (out == nullptr || out->failedToOpen())
+            return Result::fail ("Could not create " + tempFile.getFile().getFullPathName());
+
+        if (format == containerFormat)
+        {
+            const auto result = SessionContainer::write (data, *out, compressionLevel);
+            if (result.failed())
+                return result;
+        }
+        else if (format == compressedFormat)
+        {
+            GZIPCompressorOutputStream gzip (*out, jlimit (0, 9, compressionLevel));
+            data.writeToStream (gzip);
+        }
+        else if (format == xmlFormat)
+        {
+            // state loaded from a container is binary until the plugin saves again
+            ValueTree xmlData (data.createCopy());
+            Node::encodeStateProperties (xmlData);
+            auto xml = xmlData.createXml();
+            if (xml == nullptr)
+                return Result::fail ("Could not create session data");
+            xml->writeToStream (*out, String());
+        }
+        else
+        {
+            return Result::fail ("Could not create session data");
+        }
+
+        out->flush();
+        if (out->getStatus().failed())
+            return out->getStatus();
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary()
+        ? Result::ok() : Result::fail ("Could not replace " + file.getFullPathName());
+}
+
+void SessionWriter::run()
+{
+    while (! threadShouldExit())
+    {
+        std::unique_ptr<Job> job;
+
+        {
+            ScopedLock sl (lock);
+            job.reset (pending.removeAndReturn (0));
+        }
+
+        if (job == nullptr)
+        {
+            jobAdded.wait (500);
+            continue;
+        }
+
+        job->result = writeSnapshot (job->data, job->file, job->format, job->compressionLevel);
+        job->data = ValueTree();
+
+        if (job->result.failed())
+        {
+            DBG("[EL] session write failed: " << job->result.getErrorMessage());
+        }
+
+        if (job->callback)
+        {
+            ScopedLock sl (lock);
+            finished.add (job.release());
+            triggerAsyncUpdate();
+        }
+
+        --numActive;
+        jobDone.signal();
+    }
+}
+
+void SessionWriter::handleAsyncUpdate()
+{
+    OwnedArray<Job> jobs;
+
+    {
+        ScopedLock sl (lock);
+        jobs.swapWith (finished);
+    }
+
+    for (auto* const job : jobs)
+        job->callback (job->file, job->result);
+}
+
+}
@@ -0,0 +1,107 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#pragma once
+
+#include "ElementApp.h"
+
+namespace Element {
+
+class Session;
+
+/** Writes sessions to disk on a background thread.
+
+    The message thread only takes a snapshot: plugins are asked for their
+    state and the model is copied. Serializing, compressing and decoding
+    plugin state into container chunks all happen on the writer's thread.
+    XML files keep plugin state as base64 strings. Every file is written to
+    a temporary file first and then moved over the target, so a failed or
+    interrupted save never leaves a truncated session behind.
+ */
+class SessionWriter : private Thread,
+                      private AsyncUpdater
+{
+public:
+    enum Format
+    {
+        xmlFormat = 0,      ///< Plain XML, the normal .els format
+        compressedFormat,   ///< Binary ValueTree data, gzip compressed
+        containerFormat     ///< A SessionContainer, plugin state in separate chunks
+    };
+
+    /** Called on the message thread after a write with a callback finishes */
+    using Callback = std::function<void(const File&, const Result&)>;
+
+    SessionWriter();
+
+    /** Finishes any pending writes before returning */
+    ~SessionWriter();
+
+    /** Saves the session's plugin state and returns a sanitized copy of its
+        model which is safe to hand to another thread. Call this on the
+        message thread */
+    static ValueTree createSnapshot (Session&);
+
+    /** Queues a snapshot for writing. If a write to the same file is still
+        waiting, it is replaced by this one.
+
+        @param snapshot         A tree from createSnapshot. Nothing else may
+                                hold a reference to it
+        @param file             The file to replace
+        @param format           How to encode the file
+        @param compressionLevel 0 (none) to 9 (smallest), not used by xmlFormat
+        @param callback         Optional, called on the message thread when done
+     */
+    void write (const ValueTree& snapshot, const File& file, Format format,
+                int compressionLevel = 9, Callback callback = nullptr);
+
+    /** True if writes are waiting or in progress */
+    bool isWriting() const noexcept { return numActive.load() > 0; }
+
+    /** Blocks until all queued writes have finished. Returns false if the
+        timeout ran out first */
+    bool waitUntilFinished (int timeoutMs = -1);
+
+    /** Writes a snapshot on the calling thread */
+    static Result writeSnapshot (const ValueTree& snapshot, const File& file,
+                                 Format format, int compressionLevel = 9);
+
+private:
+    struct Job
+    {
+        ValueTree data;
+        File file;
+        Format format;
+        int compressionLevel;
+        Callback callback;
+        Result result { Result::ok() };
+    };
+
+    CriticalSection lock;
+    OwnedArray<Job> pending, finished;
+    std::atomic<int> numActive { 0 };
+    WaitableEvent jobAdded, jobDone;
+
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SessionWriter)
+};
+
+}
@@ -0,0 +1,182 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "session/TempoMap.h"
+
+namespace Element {
+
+static double getFramesPerBeat (double sampleRate, double bpm)
+{
+    return sampleRate * 60.0 / jlimit (1.0, 999.0, bpm);
+}
+
+//=============================================================================
+TempoTable::TempoTable (double rate, const Array<Segment>& s)
+    : sampleRate (rate), segments (s)
+{
+    jassert (segments.size() > 0);
+}
+
+TempoTable::~TempoTable() { }
+
+int TempoTable::indexOfFrame (double frame) const noexcept
+{
+    auto iter = std::upper_bound (segments.begin(), segments.end(), frame,
+        [] (double f, const Segment& s) { return f < s.frame; });
+    return jmax (0, (int) (iter - segments.begin()) - 1);
+}
+
+int TempoTable::indexOfBeat (double beat) const noexcept
+{
+    auto iter = std::upper_bound (segments.begin(), segments.end(), beat,
+        [] (double b, const Segment& s) { return b < s.beat; });
+    return jmax (0, (int) (iter - segments.begin()) - 1);
+}
+
+double TempoTable::frameToBeat (double frame) const noexcept
+{
+    const auto& s = segments.getReference (indexOfFrame (frame));
+    return s.beat + (frame - s.frame) / s.framesPerBeat;
+}
+
+double TempoTable::beatToFrame (double beat) const noexcept
+{
+    const auto& s = segments.getReference (indexOfBeat (beat));
+    return s.frame + (beat - s.beat) * s.framesPerBeat;
+}
+
+int64 TempoTable::getNextChange (int64 frame) const noexcept
+{
+    const int next = indexOfFrame ((double) frame) + 1;
+    return next < segments.size() ? (int64) std::ceil (segments.getReference (next).frame) : -1;
+}
+
+void TempoTable::getPosition (int64 frame, AudioPlayHead::CurrentPositionInfo& pos) const noexcept
+{
+    const auto& s = segments.getReference (indexOfFrame ((double) frame));
+    const double beat = s.beat + ((double) frame - s.frame) / s.framesPerBeat;
+    const double barLength = s.getBarLength();
+    const double bars = std::floor ((beat - s.barOrigin) / barLength + 1.0e-9);
+
+    pos.bpm                         = s.bpm;
+    pos.timeSigNumerator            = s.beatsPerBar;
+    pos.timeSigDenominator          = 1 << s.beatDivisor;
+    pos.ppqPosition                 = beat;
+    pos.ppqPositionOfLastBarStart   = s.barOrigin + bars * barLength;
+}
+
+//=============================================================================
+TempoMap::TempoMap (const ValueTree& data)
+    : ObjectModel (data.isValid() ? data : ValueTree (Tags::tempoMap))
+{
+    jassert (objectData.hasType (Tags::tempoMap));
+}
+
+void TempoMap::addChange (double beat, double bpm, int beatsPerBar, int beatDivisor)
+{
+    beat = jmax (0.0, beat);
+
+    int index = 0;
+    for (; index < getNumChanges(); ++index)
+    {
+        const auto other = getBeat (index);
+        if (other == beat)
+            objectData.removeChild (index, nullptr);
+        if (other >= beat)
+            break;
+    }
+
+    ValueTree change (Tags::tempo);
+    change.setProperty (Tags::beat, beat, nullptr)
+          .setProperty (Tags::tempo, bpm, nullptr)
+          .setProperty (Tags::beatsPerBar, jlimit (1, 99, beatsPerBar), nullptr)
+          .setProperty (Tags::beatDivisor, jlimit (0, (int) BeatType::SixteenthNote, beatDivisor), nullptr);
+    objectData.addChild (change, index, nullptr);
+}
+
+void TempoMap::addRamp (double startBeat, double endBeat, double startBpm, double endBpm,
+                        int beatsPerBar, int beatDivisor, double stepBeats)
+{
+    stepBeats = jmax (1.0 / 64.0, stepBeats);
+    for (double beat = startBeat; beat < endBeat; beat += stepBeats)
+    {
+        const double alpha = (beat - startBeat) / (endBeat - startBeat);
+        addChange (beat, startBpm + alpha * (endBpm - startBpm), beatsPerBar, beatDivisor);
+    }
+
+    addChange (endBeat, endBpm, beatsPerBar, beatDivisor);
+}
+
+void TempoMap::removeChange (int index)
+{
+    objectData.removeChild (index, nullptr);
+}
+
+void TempoMap::clear()
+{
+    objectData.removeAllChildren (nullptr);
+}
+
+TempoTable* TempoMap::createTable (double sampleRate, double defaultBpm,
+                                   int defaultBeatsPerBar, int defaultBeatDivisor) const
+{
+    jassert (sampleRate > 0.0);
+
+    TempoTable::Segment first;
+    first.frame         = 0.0;
+    first.beat          = 0.0;
+    first.bpm           = defaultBpm;
+    first.framesPerBeat = getFramesPerBeat (sampleRate, defaultBpm);
+    first.beatsPerBar   = defaultBeatsPerBar;
+    first.beatDivisor   = defaultBeatDivisor;
+    first.barOrigin     = 0.0;
+    first.barAtOrigin   = 0;
+
+    Array<TempoTable::Segment> segments;
+    segments.add (first);
+
+    for (int i = 0; i < getNumChanges(); ++i)
+    {
+        const auto prev = segments.getLast();
+        auto next = prev;
+        next.beat           = jmax (prev.beat, getBeat (i));
+        next.frame          = prev.frame + (next.beat - prev.beat) * prev.framesPerBeat;
+        next.bpm            = getTempo (i);
+        next.framesPerBeat  = getFramesPerBeat (sampleRate, next.bpm);
+        next.beatsPerBar    = getBeatsPerBar (i);
+        next.beatDivisor    = getBeatDivisor (i);
+
+        if (next.beatsPerBar != prev.beatsPerBar || next.beatDivisor != prev.beatDivisor)
+        {
+            // a new meter starts counting at the next bar line
+            const double bars = (next.beat - prev.barOrigin) / prev.getBarLength();
+            next.barAtOrigin = prev.barAtOrigin + (int) std::ceil (bars - 1.0e-9);
+            next.barOrigin   = next.beat;
+        }
+
+        if (next.beat == prev.beat)
+            segments.setUnchecked (segments.size() - 1, next);
+        else
+            segments.add (next);
+    }
+
+    return new TempoTable (sampleRate, segments);
+}
+
+}
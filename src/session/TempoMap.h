@@ -20,15 +20,98 @@
 #ifndef EL_TEMPO_MAP_H
 #define EL_TEMPO_MAP_H
 
+#include "ElementApp.h"
+
 namespace Element {
-class TempoMap :  public ObjectModel
+
+/** Frame and beat lookups for a tempo map at one sample rate.
+
+    A table holds one segment per change, with the frame each one starts
+    at worked out ahead of time. Tables never change once built, so the
+    audio thread can use one while the message thread builds the next.
+    Beats are quarter notes, like AudioPlayHead's ppq positions. Lookups
+    are binary searches over the segments.
+ */
+class TempoTable : public ReferenceCountedObject
 {
 public:
-    TempoMap ()
-        : ObjectModel ()
+    using Ptr = ReferenceCountedObjectPtr<TempoTable>;
+
+    struct Segment
     {
+        double frame;           // where the segment starts
+        double beat;
+        double bpm;
+        double framesPerBeat;
+        int beatsPerBar;
+        int beatDivisor;        // the denominator is 1 << beatDivisor
+        double barOrigin;       // beat of the first bar in this meter
+        int barAtOrigin;        // zero based bar number at barOrigin
+
+        /** Bar length in quarter notes */
+        double getBarLength() const noexcept { return (double) beatsPerBar * 4.0 / (double) (1 << beatDivisor); }
+    };
+
+    TempoTable (double sampleRate, const Array<Segment>& segments);
+    ~TempoTable();
+
+    double getSampleRate() const noexcept               { return sampleRate; }
+    int getNumSegments() const noexcept                 { return segments.size(); }
+    const Segment& getSegment (int index) const noexcept { return segments.getReference (index); }
+
+    /** Returns the segment playing at a frame */
+    int indexOfFrame (double frame) const noexcept;
+
+    /** Returns the segment playing at a beat */
+    int indexOfBeat (double beat) const noexcept;
+
+    double frameToBeat (double frame) const noexcept;
+    double beatToFrame (double beat) const noexcept;
+
+    /** Returns the first frame after this one where the tempo or meter
+        changes, or -1 if it doesn't change again */
+    int64 getNextChange (int64 frame) const noexcept;
+
+    /** Fills in the tempo, time signature and ppq positions for a frame */
+    void getPosition (int64 frame, AudioPlayHead::CurrentPositionInfo& pos) const noexcept;
+
+private:
+    const double sampleRate;
+    const Array<Segment> segments;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TempoTable)
+};
+
+/** A session's tempo and meter changes, placed in beats */
+class TempoMap :  public ObjectModel
+{
+public:
+    explicit TempoMap (const ValueTree& data = ValueTree());
+    ~TempoMap() { }
+
+    int getNumChanges() const                   { return objectData.getNumChildren(); }
+    double getBeat (int index) const            { return objectData.getChild (index).getProperty (Tags::beat, 0.0); }
+    double getTempo (int index) const           { return objectData.getChild (index).getProperty (Tags::tempo, 120.0); }
+    int getBeatsPerBar (int index) const        { return objectData.getChild (index).getProperty (Tags::beatsPerBar, 4); }
+    int getBeatDivisor (int index) const        { return objectData.getChild (index).getProperty (Tags::beatDivisor, 2); }
+
+    /** Adds a change, replacing any other at the same beat. Changes to the
+        meter should land on bar lines */
+    void addChange (double beat, double bpm, int beatsPerBar, int beatDivisor);
+
+    /** Adds changes stepping the tempo from one value to another between
+        two beats. The map holds steps, so make them small enough to not
+        be heard */
+    void addRamp (double startBeat, double endBeat, double startBpm, double endBpm,
+                  int beatsPerBar, int beatDivisor, double stepBeats = 0.25);
+
+    void removeChange (int index);
+    void clear();
 
-    }
+    /** Builds a lookup table for a sample rate. The defaults apply before
+        the first change */
+    TempoTable* createTable (double sampleRate, double defaultBpm = 120.0,
+                             int defaultBeatsPerBar = 4, int defaultBeatDivisor = 2) const;
 };
 
 }
@@ -21,6 +21,7 @@
 #if 1
 
 #include "engine/nodes/LuaNode.h"
+#include "scripting/LuaAllocator.h"
 #include "scripting/LuaBindings.h"
 #include "sol/sol.hpp"
 
@@ -282,6 +283,51 @@ private:
 
 static LuaNodeValidateTest sLuaNodeValidateTest;
 
+//=============================================================================
+class LuaAllocatorTest : public UnitTestBase
+{
+public:
+    LuaAllocatorTest() : UnitTestBase ("Lua Allocator", "Lua", "allocator") { }
+    virtual ~LuaAllocatorTest() { }
+
+    void runTest() override
+    {
+        LuaAllocator arena;
+
+        beginTest ("blocks are reused");
+        void* block = LuaAllocator::allocate (&arena, nullptr, LUA_TTABLE, 40);
+        expect (block != nullptr);
+        expect (arena.getNumBytesInUse() == 40);
+        LuaAllocator::allocate (&arena, block, 40, 0);
+        expect (arena.getNumBytesInUse() == 0);
+        expect (LuaAllocator::allocate (&arena, nullptr, LUA_TTABLE, 64) == block);
+        LuaAllocator::allocate (&arena, block, 64, 0);
+
+        beginTest ("resize keeps contents");
+        auto* data = static_cast<char*> (LuaAllocator::allocate (&arena, nullptr, 0, 10));
+        for (int i = 0; i < 10; ++i)
+            data[i] = static_cast<char> (i);
+        data = static_cast<char*> (LuaAllocator::allocate (&arena, data, 10, 1000));
+        for (int i = 0; i < 10; ++i)
+            expect (data[i] == static_cast<char> (i));
+        LuaAllocator::allocate (&arena, data, 1000, 0);
+        expect (arena.getNumBytesInUse() == 0);
+
+        beginTest ("lua state");
+        {
+            const auto allocs = arena.getNumSystemAllocations();
+            sol::state lua (sol::default_at_panic, LuaAllocator::allocate, &arena);
+            lua.open_libraries (sol::lib::base);
+            lua.script ("local t = {} for i = 1, 1000 do t[i] = tostring (i) end");
+            expect (arena.getNumBytesInUse() > 0);
+            expect (arena.getNumSystemAllocations() <= allocs + 2);
+        }
+        expect (arena.getNumBytesInUse() == 0);
+    }
+};
+
+static LuaAllocatorTest sLuaAllocatorTest;
+
 class StaticMethodTest : public UnitTestBase
 {
 public:
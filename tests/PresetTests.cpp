@@ -17,6 +17,7 @@
 */
 
 #include "Tests.h"
+#include "session/Presets.h"
 
 namespace Element {
 
@@ -59,4 +60,90 @@ private:
 
 static PresetScanTest sPresetScanTest;
 
+class PresetIndexTest : public UnitTestBase
+{
+public:
+    PresetIndexTest() : UnitTestBase ("Preset Index", "presets", "index") { }
+
+    void initialise() override
+    {
+        dir = File::createTempFile ("presets");
+        dir.createDirectory();
+        indexFile = dir.getSiblingFile (dir.getFileName() + ".dat");
+    }
+
+    void shutdown() override
+    {
+        dir.deleteRecursively();
+        indexFile.deleteFile();
+    }
+
+    void runTest() override
+    {
+        beginTest ("header");
+        const auto wrapped = writePreset ("Wrapped.elpreset",
+            "<?xml version=\"1.0\"?>\n<preset name=\"Lead &amp; Pad\">\n"
+            "  <node name=\"Synth\" state=\"" + String::repeatedString ("A", 100000) + "\" "
+            "format=\"VST\" identifier=\"/plugins/Synth.so\"/>\n</preset>\n");
+        PresetDescription desc;
+        expect (PresetCollection::readPresetHeader (wrapped, desc));
+        expectEquals (desc.name, String ("Lead & Pad"));
+        expectEquals (desc.format, String ("VST"));
+        expectEquals (desc.identifier, String ("/plugins/Synth.so"));
+
+        writePreset ("Bare.elpreset",
+            "<node name='Bass' format='VST' identifier='/plugins/Synth.so'></node>");
+        writePreset ("Other.elpreset",
+            "<preset><node format=\"AudioUnit\" identifier=\"AudioUnit:Synths/aumu,samp,appl\"/></preset>");
+        writePreset ("Broken.elpreset", "not a preset");
+
+        beginTest ("lookup");
+        PresetCollection presets (dir, indexFile);
+        presets.refresh();
+        expectEquals (presets.getNumPresets(), 3);
+        expect (indexFile.existsAsFile());
+
+        OwnedArray<PresetDescription> results;
+        presets.getPresetsFor ("VST", "/plugins/Synth.so", results);
+        expectEquals (results.size(), 2);
+        if (results.size() == 2)
+        {
+            expectEquals (results[0]->name, String ("Bass"));
+            expectEquals (results[1]->name, String ("Lead & Pad"));
+        }
+
+        results.clearQuick (true);
+        presets.getPresetsFor ("AudioUnit", "AudioUnit:Synths/aumu,samp,appl", results);
+        expectEquals (results.size(), 1);
+        if (results.size() == 1)
+            expectEquals (results[0]->name, String ("Other"));
+
+        beginTest ("incremental");
+        dir.getChildFile ("Bare.elpreset").deleteFile();
+        writePreset ("New.elpreset",
+            "<preset name=\"New\"><node format=\"VST\" identifier=\"/plugins/Synth.so\"/></preset>");
+
+        PresetCollection reloaded (dir, indexFile);
+        reloaded.refresh();
+        expectEquals (reloaded.getNumPresets(), 3);
+        results.clearQuick (true);
+        reloaded.getPresetsFor ("VST", "/plugins/Synth.so", results);
+        expectEquals (results.size(), 2);
+        if (results.size() == 2)
+            expectEquals (results[1]->name, String ("New"));
+    }
+
+private:
+    File dir, indexFile;
+
+    File writePreset (const String& name, const String& text)
+    {
+        const auto file = dir.getChildFile (name);
+        file.replaceWithText (text);
+        return file;
+    }
+};
+
+static PresetIndexTest sPresetIndexTest;
+
 }
@@ -0,0 +1,168 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "Tests.h"
+#include "session/SessionContainer.h"
+
+namespace Element {
+
+class SessionContainerTest : public UnitTestBase
+{
+public:
+    SessionContainerTest() : UnitTestBase ("Session Container", "sessionSave", "container") { }
+
+    void runTest() override
+    {
+        testRoundTrip();
+        testSingleGraph();
+        testDamagedFile();
+    }
+
+private:
+    static MemoryBlock createState (Random& random, int size, bool compressible)
+    {
+        MemoryBlock block ((size_t) size, true);
+        if (! compressible)
+            random.fillBitsRandomly (block.getData(), block.getSize());
+        return block;
+    }
+
+    /** Two graphs with two nodes each. Node states alternate between binary
+        and base64, compressible and random */
+    static ValueTree createSession (Array<MemoryBlock>& states)
+    {
+        Random random (1234);
+        ValueTree session (Tags::session);
+        ValueTree graphs (Tags::graphs);
+        session.appendChild (graphs, nullptr);
+
+        for (int g = 0; g < 2; ++g)
+        {
+            ValueTree graph (Tags::node);
+            ValueTree nodes (Tags::nodes);
+            graph.appendChild (nodes, nullptr);
+            graphs.appendChild (graph, nullptr);
+
+            for (int n = 0; n < 2; ++n)
+            {
+                const auto state = createState (random, 4096 + n * 1000, n == 0);
+                ValueTree node (Tags::node);
+                node.setProperty (Tags::name, String ("Node ") + String (states.size()), nullptr);
+                if (g == 0)
+                    node.setProperty (Tags::state, var (state), nullptr);
+                else
+                    node.setProperty (Tags::state, state.toBase64Encoding(), nullptr);
+                nodes.appendChild (node, nullptr);
+                states.add (state);
+            }
+        }
+
+        return session;
+    }
+
+    static File writeSession (const ValueTree& session, const TemporaryFile& file)
+    {
+        FileOutputStream out (file.getFile());
+        out.setPosition (0);
+        out.truncate();
+        SessionContainer::write (session, out, 6);
+        return file.getFile();
+    }
+
+    static MemoryBlock getState (const ValueTree& session, int graph, int node)
+    {
+        MemoryBlock state;
+        const auto data = session.getChildWithName (Tags::graphs).getChild (graph)
+            .getChildWithName (Tags::nodes).getChild (node);
+        Node::readStateProperty (data, Tags::state, state);
+        return state;
+    }
+
+    void testRoundTrip()
+    {
+        beginTest ("round trip");
+        Array<MemoryBlock> states;
+        const auto session = createSession (states);
+        TemporaryFile file (".els");
+        writeSession (session, file);
+
+        expect (SessionContainer::isContainer (file.getFile()));
+        const auto loaded = SessionContainer::read (file.getFile(), 2);
+        expect (loaded.hasType (Tags::session));
+
+        for (int i = 0; i < states.size(); ++i)
+        {
+            expect (getState (loaded, i / 2, i % 2) == states.getReference (i));
+            expect (getState (loaded, i / 2, i % 2).getSize() > 0);
+        }
+
+        // zeroed states compress to almost nothing, random ones are stored as they are
+        expect (file.getFile().getSize() < 2 * 5096 + 1024);
+    }
+
+    void testSingleGraph()
+    {
+        beginTest ("single graph");
+        Array<MemoryBlock> states;
+        TemporaryFile file (".els");
+        writeSession (createSession (states), file);
+
+        SessionContainer container;
+        expect (container.open (file.getFile()).wasOk());
+        expectEquals (container.getNumChunks(), states.size());
+
+        auto model = container.getModel();
+        auto graph = model.getChildWithName (Tags::graphs).getChild (1);
+        expect (container.restoreState (graph, 1));
+        expect (getState (model, 0, 0).getSize() == 0);
+        expect (getState (model, 1, 0) == states.getReference (2));
+        expect (getState (model, 1, 1) == states.getReference (3));
+    }
+
+    void testDamagedFile()
+    {
+        beginTest ("damaged file");
+        Array<MemoryBlock> states;
+        TemporaryFile file (".els");
+        writeSession (createSession (states), file);
+
+        MemoryBlock data;
+        file.getFile().loadFileAsData (data);
+        data.setSize (data.getSize() - 10);
+        file.getFile().replaceWithData (data.getData(), data.getSize());
+
+        SessionContainer container;
+        expect (container.open (file.getFile()).failed());
+        expect (! SessionContainer::read (file.getFile()).isValid());
+
+        beginTest ("impossible chunk size");
+        writeSession (createSession (states), file);
+        file.getFile().loadFileAsData (data);
+        auto* const bytes = static_cast<char*> (data.getData());
+        const auto tableOffset = ByteOrder::littleEndianInt64 (bytes + data.getSize() - 16);
+        const auto hugeSize = ByteOrder::swapIfBigEndian ((uint64) 1 << 50);
+        memcpy (bytes + tableOffset + 16, &hugeSize, sizeof (hugeSize));
+        file.getFile().replaceWithData (data.getData(), data.getSize());
+        expect (container.open (file.getFile()).failed());
+    }
+};
+
+static SessionContainerTest sSessionContainerTest;
+
+}
@@ -0,0 +1,129 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "Tests.h"
+#include "session/SessionWriter.h"
+
+namespace Element {
+
+class SessionWriterTest : public UnitTestBase
+{
+public:
+    SessionWriterTest() : UnitTestBase ("Session Writer", "sessionSave", "writer") { }
+
+    void initialise() override
+    {
+        initializeWorld();
+        session = getWorld().getSession();
+        session->clear();
+        session->addGraph (Node::createDefaultGraph ("Graph"), true);
+    }
+
+    void shutdown() override
+    {
+        session = nullptr;
+        shutdownWorld();
+    }
+
+    void runTest() override
+    {
+        testFormats();
+        testBackgroundWrite();
+    }
+
+private:
+    SessionPtr session;
+
+    void testFormats()
+    {
+        beginTest ("snapshot round trip");
+        const auto snapshot = SessionWriter::createSnapshot (*session);
+        expect (snapshot.hasType (Tags::session));
+
+        TemporaryFile xmlFile (".els");
+        expect (SessionWriter::writeSnapshot (snapshot, xmlFile.getFile(), SessionWriter::xmlFormat).wasOk());
+        auto xml = XmlDocument::parse (xmlFile.getFile());
+        expect (xml != nullptr);
+        if (xml != nullptr)
+        {
+            // XML brings properties back as strings, so only compare the structure
+            const auto data = ValueTree::fromXml (*xml);
+            expect (data.hasType (Tags::session));
+            expectEquals (data.getChildWithName (Tags::graphs).getNumChildren(),
+                          snapshot.getChildWithName (Tags::graphs).getNumChildren());
+        }
+
+        beginTest ("xml state is base64");
+        {
+            MemoryBlock state ("plugin state", 12);
+            ValueTree data (Tags::session), graph (Tags::node), node (Tags::node);
+            node.setProperty (Tags::state, var (state), nullptr);
+            graph.appendChild (node, nullptr);
+            data.appendChild (graph, nullptr);
+
+            TemporaryFile stateFile (".els");
+            expect (SessionWriter::writeSnapshot (data, stateFile.getFile(), SessionWriter::xmlFormat).wasOk());
+            auto stateXml = XmlDocument::parse (stateFile.getFile());
+            expect (stateXml != nullptr);
+            if (stateXml != nullptr)
+            {
+                const auto* const element = stateXml->getChildElement (0)->getChildElement (0);
+                expectEquals (element->getStringAttribute (Tags::state.toString()), state.toBase64Encoding());
+            }
+        }
+
+        for (int level : { 0, 6, 9 })
+        {
+            TemporaryFile gzFile (".els");
+            expect (SessionWriter::writeSnapshot (snapshot, gzFile.getFile(),
+                SessionWriter::compressedFormat, level).wasOk());
+            expect (Session::readFromFile (gzFile.getFile()).isEquivalentTo (snapshot));
+        }
+    }
+
+    void testBackgroundWrite()
+    {
+        beginTest ("background write");
+        TemporaryFile file (".els");
+        SessionWriter writer;
+
+        // a second write to the same file replaces the first if it's still waiting
+        int numCallbacks = 0;
+        for (int i = 0; i < 2; ++i)
+        {
+            writer.write (SessionWriter::createSnapshot (*session), file.getFile(),
+                SessionWriter::compressedFormat, 1,
+                [&numCallbacks] (const File&, const Result& result)
+                {
+                    if (result.wasOk())
+                        ++numCallbacks;
+                });
+        }
+
+        expect (writer.waitUntilFinished (5000));
+        expect (! writer.isWriting());
+        runDispatchLoop (40);
+        expectEquals (numCallbacks, 2);
+        expect (Session::readFromFile (file.getFile()).hasType (Tags::session));
+    }
+};
+
+static SessionWriterTest sSessionWriterTest;
+
+}
@@ -0,0 +1,86 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "Tests.h"
+#include "session/TempoMap.h"
+
+namespace Element {
+
+class TempoMapTest : public UnitTestBase
+{
+public:
+    TempoMapTest() : UnitTestBase ("Tempo Map", "session", "tempoMap") { }
+
+    void runTest() override
+    {
+        // 120 bpm in 4/4, 60 bpm from beat 4, 3/4 from beat 8
+        TempoMap map;
+        map.addChange (8.0, 60.0, 3, 2);
+        map.addChange (4.0, 60.0, 4, 2);
+        map.addChange (0.0, 120.0, 4, 2);
+
+        beginTest ("changes are sorted");
+        expectEquals (map.getNumChanges(), 3);
+        expectEquals (map.getBeat (0), 0.0);
+        expectEquals (map.getBeat (2), 8.0);
+        map.addChange (4.0, 60.0, 4, 2);
+        expectEquals (map.getNumChanges(), 3);
+
+        TempoTable::Ptr table = map.createTable (48000.0);
+
+        beginTest ("frames to beats");
+        expectEquals (table->getNumSegments(), 3);
+        expectEquals (table->frameToBeat (96000.0), 4.0);
+        expectEquals (table->frameToBeat (144000.0), 5.0);
+        expectEquals (table->beatToFrame (6.0), 192000.0);
+        expectEquals (table->beatToFrame (table->frameToBeat (300000.0)), 300000.0);
+
+        beginTest ("next change");
+        expectEquals (table->getNextChange (0), (int64) 96000);
+        expectEquals (table->getNextChange (96000), (int64) 288000);
+        expectEquals (table->getNextChange (288000), (int64) -1);
+
+        beginTest ("position");
+        AudioPlayHead::CurrentPositionInfo pos;
+        pos.resetToDefault();
+        table->getPosition (100000, pos);
+        expectEquals (pos.bpm, 60.0);
+        expectEquals (pos.timeSigNumerator, 4);
+        expectEquals (pos.ppqPositionOfLastBarStart, 4.0);
+
+        table->getPosition ((int64) table->beatToFrame (12.5), pos);
+        expectEquals (pos.timeSigNumerator, 3);
+        expectEquals (pos.timeSigDenominator, 4);
+        expectEquals (pos.ppqPosition, 12.5);
+        expectEquals (pos.ppqPositionOfLastBarStart, 11.0);
+
+        beginTest ("ramp");
+        map.clear();
+        map.addRamp (0.0, 4.0, 100.0, 140.0, 4, 2, 1.0);
+        expectEquals (map.getNumChanges(), 5);
+        expectEquals (map.getTempo (2), 120.0);
+        table = map.createTable (44100.0);
+        expectEquals (table->indexOfBeat (2.5), 2);
+        expectEquals (table->indexOfFrame (table->beatToFrame (2.5)), 2);
+    }
+};
+
+static TempoMapTest sTempoMapTest;
+
+}
@@ -0,0 +1,123 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "Tests.h"
+#include "engine/DiskStreamer.h"
+
+namespace Element {
+
+class DiskStreamerTest : public UnitTestBase
+{
+public:
+    DiskStreamerTest() : UnitTestBase ("Disk Streamer", "engine", "diskStreamer") { }
+
+    void initialise() override
+    {
+        file = File::createTempFile ("wav");
+        writeRamp (file, 44100 * 3);
+    }
+
+    void shutdown() override
+    {
+        file.deleteFile();
+    }
+
+    void runTest() override
+    {
+        DiskStreamer streamer;
+        streamer.setHeadLength (1.0);
+
+        beginTest ("memory mapped reader");
+        std::unique_ptr<AudioFormatReader> reader (streamer.createReaderFor (file));
+        expect (dynamic_cast<MemoryMappedAudioFormatReader*> (reader.get()) != nullptr);
+        reader = nullptr;
+
+        beginTest ("head");
+        std::unique_ptr<AudioFileStream> stream (streamer.createStream (file, 4096));
+        expect (stream != nullptr);
+        expectEquals (stream->getTotalLength(), (int64) 44100 * 3);
+        expect (waitForHead (*stream));
+        expectEquals (stream->getHead().getNumSamples(), 44100);
+
+        beginTest ("reads from the head");
+        stream->prepareToPlay (512, 44100.0);
+        AudioSampleBuffer buffer (2, 512);
+        stream->getNextAudioBlock (AudioSourceChannelInfo (buffer));
+        expect (isRamp (buffer, 0));
+        expectEquals (stream->getNextReadPosition(), (int64) 512);
+
+        beginTest ("seeks into the head");
+        stream->setNextReadPosition (1000);
+        stream->getNextAudioBlock (AudioSourceChannelInfo (buffer));
+        expect (isRamp (buffer, 1000));
+
+        beginTest ("looping");
+        stream->setLooping (true);
+        stream->setNextReadPosition (44100 * 3 + 10);
+        expectEquals (stream->getNextReadPosition(), (int64) 10);
+        stream->releaseResources();
+        stream = nullptr;
+
+        beginTest ("shared heads");
+        std::unique_ptr<AudioFileStream> a (streamer.createStream (file)), b (streamer.createStream (file));
+        expect (&a->getHead() == &b->getHead());
+        a = nullptr;
+        b = nullptr;
+
+        beginTest ("cache limit");
+        expect (streamer.getCacheSize() > 0);
+        streamer.setCacheLimit (0);
+        expectEquals (streamer.getCacheSize(), (int64) 0);
+    }
+
+private:
+    File file;
+
+    static void writeRamp (const File& f, int numSamples)
+    {
+        AudioSampleBuffer buffer (1, numSamples);
+        for (int i = 0; i < numSamples; ++i)
+            buffer.setSample (0, i, (float) (i % 1000) / 1000.f);
+
+        WavAudioFormat wav;
+        std::unique_ptr<AudioFormatWriter> writer (wav.createWriterFor (
+            new FileOutputStream (f), 44100.0, 1, 32, {}, 0));
+        writer->writeFromAudioSampleBuffer (buffer, 0, numSamples);
+    }
+
+    static bool isRamp (const AudioSampleBuffer& buffer, int start)
+    {
+        for (int c = 0; c < buffer.getNumChannels(); ++c)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                if (std::abs (buffer.getSample (c, i) - (float) ((start + i) % 1000) / 1000.f) > 0.0001f)
+                    return false;
+        return true;
+    }
+
+    static bool waitForHead (const AudioFileStream& stream)
+    {
+        for (int i = 0; i < 200 && ! stream.getHead().isReady(); ++i)
+            Thread::sleep (10);
+        return stream.getHead().isReady();
+    }
+};
+
+static DiskStreamerTest sDiskStreamerTest;
+
+}
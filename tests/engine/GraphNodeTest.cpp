@@ -118,7 +118,23 @@ public:
             
             for (int ch = 0; ch < 16; ++ch)
                 expect (graph.connectChannels (PortType::Midi, filter->nodeId, ch, midiOut->nodeId, 0));
-            
+
+            beginTest ("render order");
+            runDispatchLoop (15);
+            ReferenceCountedArray<GraphNode> ordered;
+            graph.getOrderedNodes (ordered);
+            expect (ordered.size() == 3);
+            expect (ordered.indexOf (midiIn) < ordered.indexOf (filter));
+            expect (ordered.indexOf (filter) < ordered.indexOf (midiOut));
+
+            beginTest ("render order after edits");
+            graph.disconnectNode (midiIn->nodeId);
+            runDispatchLoop (15);
+            ordered.clearQuick();
+            graph.getOrderedNodes (ordered);
+            expect (ordered.size() == 3);
+            expect (ordered.indexOf (filter) < ordered.indexOf (midiOut));
+
             graph.releaseResources();
             graph.clear();
         }
@@ -240,6 +256,50 @@ public:
 
 static GetTypeStringTest sGetTypeStringTest;
 
+/** Test oversampling factors, filters and the latency they add */
+class OversamplingTest : public GraphNodeTest
+{
+public:
+    OversamplingTest() : GraphNodeTest ("Node Oversampling", "oversampling") { }
+    void runTest() override
+    {
+        GraphNodePtr node = graph->addNode (new PlaceholderProcessor (2, 2, false, false));
+
+        beginTest ("factors");
+        expect (node->getOversamplingFactor() == 1);
+        node->setOversamplingFactor (3);
+        expect (node->getOversamplingFactor() == 2);
+        node->setOversamplingFactor (100);
+        expect (node->getOversamplingFactor() == 8);
+        node->setOversamplingFactor (0);
+        expect (node->getOversamplingFactor() == 1);
+
+        beginTest ("latency");
+        expect (node->getLatencySamples() == 0);
+        node->setOversamplingFactor (4);
+        expect (node->getLatencySamples() == 0, "applied before the node was prepared");
+        reprepare();
+        const int iirLatency = node->getLatencySamples();
+        expect (iirLatency > 0);
+
+        node->setOversamplingFilter (GraphNode::linearPhaseFilter);
+        reprepare();
+        expect (node->getLatencySamples() > iirLatency);
+
+        node->setOversamplingFactor (1);
+        reprepare();
+        expect (node->getLatencySamples() == 0);
+    }
+
+    void reprepare()
+    {
+        graph->releaseResources();
+        graph->prepareToPlay (44100.f, 1024);
+    }
+};
+
+static OversamplingTest sOversamplingTest;
+
 }
 
 }
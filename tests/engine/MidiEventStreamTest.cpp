@@ -0,0 +1,146 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "Tests.h"
+#include "engine/MidiEventStream.h"
+
+namespace Element {
+
+class MidiEventStreamTest : public UnitTestBase
+{
+public:
+    MidiEventStreamTest() : UnitTestBase ("MIDI Event Stream", "engine", "midiEventStream") { }
+
+    void runTest() override
+    {
+        testRoundTrip();
+        testFilterAndTransform();
+        testSplit();
+        testCapacity();
+    }
+
+private:
+    static MidiBuffer createInput()
+    {
+        const uint8 sysex[] = { 0xf0, 0x7e, 0x7f, 0x06, 0x01, 0xf7 };
+        MidiBuffer midi;
+        midi.addEvent (MidiMessage::noteOn (1, 60, (uint8) 100), 0);
+        midi.addEvent (MidiMessage (sysex, (int) sizeof (sysex)), 4);
+        midi.addEvent (MidiMessage::controllerEvent (2, 7, 64), 8);
+        midi.addEvent (MidiMessage::noteOff (1, 60), 16);
+        midi.addEvent (MidiMessage::midiClock(), 20);
+        midi.addEvent (MidiMessage::noteOn (16, 72, (uint8) 90), 32);
+        return midi;
+    }
+
+    static bool equal (const MidiBuffer& a, const MidiBuffer& b)
+    {
+        MidiBuffer::Iterator ia (a), ib (b);
+        const uint8 *da, *db; int sa, sb, fa, fb;
+        while (ia.getNextEvent (da, sa, fa))
+        {
+            if (! ib.getNextEvent (db, sb, fb) || sa != sb || fa != fb || memcmp (da, db, (size_t) sa) != 0)
+                return false;
+        }
+        return ! ib.getNextEvent (db, sb, fb);
+    }
+
+    void testRoundTrip()
+    {
+        beginTest ("round trip");
+        const auto input = createInput();
+        MidiEventStream stream;
+        expect (stream.readFrom (input));
+        expectEquals (stream.getNumEvents(), 6);
+        MidiBuffer output;
+        stream.writeTo (output);
+        expect (equal (input, output));
+
+        expect (stream.readFrom (input, 16));
+        expectEquals (stream.getNumEvents(), 3);
+    }
+
+    void testFilterAndTransform()
+    {
+        beginTest ("filter and transform");
+        MidiEventStream stream;
+        stream.readFrom (createInput());
+        stream.removeIf ([] (const MidiEventStream::Event& e) { return e.getChannel() == 2; });
+        stream.transform ([] (MidiEventStream::Event& e) {
+            if (e.isNoteOnOrOff())
+                e.bytes[1] += 12;
+        });
+
+        MidiBuffer output;
+        stream.writeTo (output);
+        expectEquals (output.getNumEvents(), 5);
+
+        MidiBuffer::Iterator iter (output);
+        MidiMessage msg; int frame = 0;
+        iter.getNextEvent (msg, frame);
+        expect (msg.isNoteOn() && msg.getNoteNumber() == 72);
+        iter.getNextEvent (msg, frame);
+        expect (msg.isSysEx() && msg.getSysExDataSize() == 4);
+        iter.getNextEvent (msg, frame);
+        expect (msg.isNoteOff() && msg.getNoteNumber() == 72 && frame == 16);
+    }
+
+    void testSplit()
+    {
+        beginTest ("split by channel");
+        MidiEventStream stream;
+        stream.readFrom (createInput());
+
+        OwnedArray<MidiBuffer> channels;
+        MidiBuffer* buffers [16];
+        for (int i = 0; i < 16; ++i)
+            buffers[i] = channels.add (new MidiBuffer());
+        MidiBuffer other;
+        stream.splitByChannel (buffers, &other);
+
+        expectEquals (channels[0]->getNumEvents(), 2);
+        expectEquals (channels[1]->getNumEvents(), 1);
+        expectEquals (channels[15]->getNumEvents(), 1);
+        expectEquals (other.getNumEvents(), 2);
+    }
+
+    void testCapacity()
+    {
+        beginTest ("capacity");
+        MidiEventStream stream (4, 2);
+        expect (! stream.readFrom (createInput()));
+        expectEquals (stream.getNumEvents(), 4);
+        for (const auto& e : stream)
+            expect (e.isInline());
+
+        beginTest ("swap");
+        MidiEventStream other (16, 64);
+        expect (other.readFrom (createInput()));
+        stream.swapWith (other);
+        expectEquals (stream.getNumEvents(), 6);
+        expectEquals (other.getNumEvents(), 4);
+        MidiBuffer midi;
+        stream.writeTo (midi);
+        expect (equal (midi, createInput()));
+    }
+};
+
+static MidiEventStreamTest sMidiEventStreamTest;
+
+}
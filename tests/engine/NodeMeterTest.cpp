@@ -0,0 +1,79 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "Tests.h"
+#include "engine/NodeMeter.h"
+
+namespace Element {
+
+class NodeMeterTest : public UnitTestBase
+{
+public:
+    NodeMeterTest() : UnitTestBase ("Node Meter", "engine", "nodeMeter") { }
+
+    void runTest() override
+    {
+        AudioSampleBuffer buffer (2, 100);
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+        {
+            buffer.setSample (0, i, (i % 2) == 0 ? 0.5f : -0.5f);
+            buffer.setSample (1, i, 0.f);
+        }
+        buffer.setSample (1, 37, -0.75f);
+
+        beginTest ("unsubscribed channels");
+        NodeMeter meter (2, 2);
+        expect (! meter.isActive());
+        meter.measure (true, buffer, buffer.getNumSamples());
+        expectEquals (meter.read (true, 0).rms, 0.f);
+
+        beginTest ("peak and rms");
+        meter.subscribe (true, 0);
+        meter.subscribe (true, 1);
+        expect (meter.isActive());
+        for (int i = 0; i < 3; ++i)
+            meter.measure (true, buffer, buffer.getNumSamples());
+        auto levels = meter.read (true, 0);
+        expectWithinAbsoluteError (levels.peak, 0.5f, 0.0001f);
+        expectWithinAbsoluteError (levels.rms, 0.5f, 0.0001f);
+        levels = meter.read (true, 1);
+        expectWithinAbsoluteError (levels.peak, 0.75f, 0.0001f);
+        expectWithinAbsoluteError (levels.rms, std::sqrt (0.75f * 0.75f / 100.f), 0.0001f);
+        expectEquals (meter.read (false, 0).peak, 0.f);
+
+        beginTest ("holds the last reading");
+        expectWithinAbsoluteError (meter.read (true, 0).rms, 0.5f, 0.0001f);
+
+        beginTest ("full ring");
+        for (int i = 0; i < 1000; ++i)
+            meter.measure (true, buffer, buffer.getNumSamples());
+        expectWithinAbsoluteError (meter.read (true, 0).rms, 0.5f, 0.0001f);
+
+        beginTest ("unsubscribe");
+        meter.unsubscribe (true, 0);
+        meter.unsubscribe (true, 1);
+        meter.unsubscribe (true, 1);
+        expect (! meter.isActive());
+        expectEquals (meter.getNumSubscribers (true, 1), 0);
+    }
+};
+
+static NodeMeterTest sNodeMeterTest;
+
+}
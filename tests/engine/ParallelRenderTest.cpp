@@ -0,0 +1,114 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "Tests.h"
+#include "engine/RenderThreadPool.h"
+
+namespace Element {
+
+class ParallelRenderTest : public UnitTestBase
+{
+public:
+    ParallelRenderTest() : UnitTestBase ("Parallel Graph Render", "engine", "parallelRender") { }
+
+    void runTest() override
+    {
+        beginTest ("independent branches overlap");
+        RenderThreadPool pool (3);
+        Counter counter;
+
+        GraphProcessor graph;
+        graph.setPlayConfigDetails (2, 2, 44100.0, 512);
+        graph.setRenderThreadPool (&pool);
+        graph.prepareToPlay (44100.0, 512);
+
+        const auto audioIn  = graph.addNode (new IOProcessor (IOProcessor::audioInputNode))->nodeId;
+        const auto audioOut = graph.addNode (new IOProcessor (IOProcessor::audioOutputNode))->nodeId;
+        for (int i = 0; i < numBranches; ++i)
+        {
+            const auto branch = graph.addNode (new BranchProcessor (counter))->nodeId;
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                graph.connectChannels (PortType::Audio, audioIn, ch, branch, ch);
+                graph.connectChannels (PortType::Audio, branch, ch, audioOut, ch);
+            }
+        }
+
+        graph.handleUpdateNowIfNeeded();
+        runDispatchLoop (20);
+
+        AudioSampleBuffer buffer (2, 512);
+        MidiBuffer midi;
+        bool correct = true;
+
+        for (int block = 0; block < 50; ++block)
+        {
+            for (int ch = 0; ch < 2; ++ch)
+                FloatVectorOperations::fill (buffer.getWritePointer (ch), 0.25f, buffer.getNumSamples());
+            midi.clear();
+            graph.processBlock (buffer, midi);
+
+            // every branch halves the input, and they are summed at the output
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < buffer.getNumSamples(); ++i)
+                    correct &= std::abs (buffer.getSample (ch, i) - numBranches * 0.125f) < 1.0e-6f;
+        }
+
+        expect (correct, "branches didn't sum to the expected output");
+        expect (counter.maxRunning.load() > 1, "branches never rendered at the same time");
+
+        graph.setRenderThreadPool (nullptr);
+        graph.releaseResources();
+        graph.clear();
+    }
+
+private:
+    enum { numBranches = 4 };
+
+    struct Counter
+    {
+        std::atomic<int> running { 0 };
+        std::atomic<int> maxRunning { 0 };
+    };
+
+    /** Halves its input, staying busy long enough for others to overlap */
+    class BranchProcessor : public VolumeProcessor
+    {
+    public:
+        BranchProcessor (Counter& c) : VolumeProcessor (-60.0, 12.0, true), counter (c) { }
+
+        void processBlock (AudioBuffer<float>& buffer, MidiBuffer&) override
+        {
+            const int running = ++counter.running;
+            int highest = counter.maxRunning.load();
+            while (running > highest && ! counter.maxRunning.compare_exchange_weak (highest, running)) { }
+
+            Thread::sleep (1);
+            buffer.applyGain (0.5f);
+            --counter.running;
+        }
+
+    private:
+        Counter& counter;
+    };
+};
+
+static ParallelRenderTest sParallelRenderTest;
+
+}
@@ -0,0 +1,69 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/RenderBufferPool.h"
+
+namespace Element {
+
+class RenderBufferPoolTest : public UnitTestBase
+{
+public:
+    RenderBufferPoolTest() : UnitTestBase ("Render Buffer Pool", "engine", "renderBufferPool") { }
+    virtual ~RenderBufferPoolTest() { }
+
+    void runTest() override
+    {
+        RenderBufferPool::Ptr pool = new RenderBufferPool();
+
+        beginTest ("alignment");
+        {
+            auto buffer = pool->allocate (3, 61);
+            expect (buffer->getNumChannels() == 3);
+            expect (buffer->getNumSamples() == 61);
+            for (int i = 0; i < buffer->getNumChannels(); ++i)
+            {
+                const auto address = reinterpret_cast<pointer_sized_uint> (buffer->getChannels()[i]);
+                expect (address % RenderBufferPool::alignment == 0);
+                for (int s = 0; s < buffer->getNumSamples(); ++s)
+                    expect (buffer->getChannels()[i][s] == 0.f);
+            }
+
+            buffer->getChannels()[0][0] = 1.f;
+            expect (pool->getNumBytesInUse() > 0);
+        }
+
+        beginTest ("re-use");
+        expect (pool->getNumBytesInUse() == 0);
+        const size_t pooled = pool->getNumBytesPooled();
+        expect (pooled > 0);
+        {
+            auto buffer = pool->allocate (2, 64);
+            expect (pool->getNumBytesPooled() == 0);
+            expect (buffer->getChannels()[0][0] == 0.f, "re-used memory should be cleared");
+        }
+        expect (pool->getNumBytesPooled() == pooled);
+
+        pool->releaseUnused();
+        expect (pool->getNumBytesPooled() == 0);
+    }
+};
+
+static RenderBufferPoolTest sRenderBufferPoolTest;
+
+}
@@ -0,0 +1,111 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Tests.h"
+#include "engine/RenderThreadPool.h"
+
+namespace Element {
+
+class RenderThreadPoolTest : public UnitTestBase
+{
+public:
+    RenderThreadPoolTest() : UnitTestBase ("Render Thread Pool", "engine", "renderThreadPool") { }
+    virtual ~RenderThreadPoolTest() { }
+
+    void runTest() override
+    {
+        testTaskGraph();
+        testRunOrder();
+    }
+
+private:
+    struct RecordingJob : public RenderThreadPool::Job
+    {
+        RecordingJob (int numTasks)
+        {
+            order.insertMultiple (0, -1, numTasks);
+        }
+
+        void runTask (int task) override
+        {
+            const int position = ++counter;
+            order.set (task, position);
+        }
+
+        Atomic<int> counter { 0 };
+        Array<int, CriticalSection> order;
+    };
+
+    void testTaskGraph()
+    {
+        beginTest ("task graph concurrency");
+        RenderThreadPool::TaskGraph graph;
+        graph.reset (4);
+        graph.addDependency (1, 0);
+        graph.addDependency (2, 0);
+        graph.addDependency (3, 1);
+        graph.addDependency (3, 2);
+        graph.addDependency (3, 2);
+        graph.finalize();
+        expect (graph.getNumTasks() == 4);
+        expect (graph.getMaxConcurrency() == 2);
+        expect (graph.isWorthRunningInParallel());
+
+        graph.reset (3);
+        graph.addDependency (1, 0);
+        graph.addDependency (2, 1);
+        graph.finalize();
+        expect (graph.getMaxConcurrency() == 1);
+        expect (! graph.isWorthRunningInParallel());
+    }
+
+    void testRunOrder()
+    {
+        beginTest ("run order");
+        RenderThreadPool pool (0);
+        RenderThreadPool::TaskGraph graph;
+        const int numBranches = 16;
+        graph.reset (numBranches + 2);
+        for (int i = 1; i <= numBranches; ++i)
+        {
+            graph.addDependency (i, 0);
+            graph.addDependency (numBranches + 1, i);
+        }
+        graph.finalize();
+
+        RecordingJob idle (graph.getNumTasks());
+        expect (! pool.run (idle, graph), "pool without threads shouldn't run");
+
+        pool.setNumThreads (3);
+        for (int block = 0; block < 100; ++block)
+        {
+            RecordingJob job (graph.getNumTasks());
+            expect (pool.run (job, graph));
+            expect (job.counter.get() == graph.getNumTasks());
+            for (int i = 1; i <= numBranches; ++i)
+            {
+                expect (job.order[0] < job.order[i]);
+                expect (job.order[i] < job.order[numBranches + 1]);
+            }
+        }
+    }
+};
+
+static RenderThreadPoolTest sRenderThreadPoolTest;
+
+}
@@ -0,0 +1,408 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/** bench-element: times the graph engine on synthetic topologies.
+
+    bench-element [--blocks N] [--block size] [--rate hz] [--threads N]
+                  [--filter serial|fanout|nested|router|lua] [--output results.json]
+ */
+
+#include "ElementApp.h"
+#include "engine/GraphProcessor.h"
+#include "engine/RenderThreadPool.h"
+#include "engine/nodes/AudioRouterNode.h"
+#include "engine/nodes/SubGraphProcessor.h"
+#include "engine/nodes/VolumeProcessor.h"
+#if EL_USE_LUA
+ #include "engine/nodes/LuaNode.h"
+#endif
+
+//=============================================================================
+// Allocations made while a block renders are counted twice: once for the
+// thread calling processBlock, which stands in for the audio thread, and
+// once for every thread. Pool workers and timers only show up in the second
+
+static std::atomic<bool> countAllocations { false };
+static std::atomic<juce::int64> numAllocations { 0 };
+static std::atomic<juce::int64> numRenderThreadAllocations { 0 };
+static thread_local bool isRenderThread = false;
+
+static void* benchAllocate (std::size_t size)
+{
+    if (countAllocations.load (std::memory_order_relaxed))
+    {
+        numAllocations.fetch_add (1, std::memory_order_relaxed);
+        if (isRenderThread)
+            numRenderThreadAllocations.fetch_add (1, std::memory_order_relaxed);
+    }
+    if (void* block = std::malloc (size > 0 ? size : 1))
+        return block;
+    throw std::bad_alloc();
+}
+
+void* operator new (std::size_t size)                       { return benchAllocate (size); }
+void* operator new[] (std::size_t size)                     { return benchAllocate (size); }
+void operator delete (void* block) noexcept                 { std::free (block); }
+void operator delete[] (void* block) noexcept               { std::free (block); }
+void operator delete (void* block, std::size_t) noexcept    { std::free (block); }
+void operator delete[] (void* block, std::size_t) noexcept  { std::free (block); }
+
+namespace Element {
+
+struct BenchOptions
+{
+    int numBlocks       = 2000;
+    int blockSize       = 256;
+    double sampleRate   = 48000.0;
+    int numThreads      = 0;
+    String filter;
+    File output;
+};
+
+struct BenchResult
+{
+    String name;
+    int numNodes = 0;
+    double meanNanos = 0.0, p99Nanos = 0.0, worstNanos = 0.0;
+    int64 allocations = 0, allAllocations = 0;
+    double rebuildMicros = 0.0;
+
+    var toVar() const
+    {
+        DynamicObject::Ptr obj = new DynamicObject();
+        obj->setProperty ("name", name);
+        obj->setProperty ("nodes", numNodes);
+        obj->setProperty ("nsPerBlock", meanNanos);
+        obj->setProperty ("p99Ns", p99Nanos);
+        obj->setProperty ("worstNs", worstNanos);
+        obj->setProperty ("audioThreadAllocations", allocations);
+        obj->setProperty ("allocationsDuringRender", allAllocations);
+        obj->setProperty ("rebuildUs", rebuildMicros);
+        return var (obj.get());
+    }
+};
+
+/** A stereo graph with audio and MIDI inputs and an audio output */
+class BenchGraph
+{
+public:
+    BenchGraph (const BenchOptions& o, RenderThreadPool& pool)
+        : opts (o)
+    {
+        graph.setPlayConfigDetails (2, 2, opts.sampleRate, opts.blockSize);
+        graph.setRenderThreadPool (&pool);
+        graph.prepareToPlay (opts.sampleRate, opts.blockSize);
+        addIONodes (graph, audioIn, audioOut, midiIn);
+    }
+
+    ~BenchGraph()
+    {
+        graph.setRenderThreadPool (nullptr);
+        graph.releaseResources();
+        graph.clear();
+    }
+
+    static void addIONodes (GraphProcessor& g, uint32& audioInId, uint32& audioOutId, uint32& midiInId)
+    {
+        audioInId  = g.addNode (new IOProcessor (IOProcessor::audioInputNode))->nodeId;
+        audioOutId = g.addNode (new IOProcessor (IOProcessor::audioOutputNode))->nodeId;
+        midiInId   = g.addNode (new IOProcessor (IOProcessor::midiInputNode))->nodeId;
+    }
+
+    static void connectStereo (GraphProcessor& g, uint32 source, uint32 dest)
+    {
+        for (int ch = 0; ch < 2; ++ch)
+            g.connectChannels (PortType::Audio, source, ch, dest, ch);
+    }
+
+    GraphProcessor graph;
+    uint32 audioIn = 0, audioOut = 0, midiIn = 0;
+
+    BenchResult measure (const String& name)
+    {
+        BenchResult result;
+        result.name = name;
+        result.numNodes = countNodes (graph);
+
+        // nested graphs rebuild on their own async updates
+        MessageManager::getInstance()->runDispatchLoopUntil (50);
+        graph.handleUpdateNowIfNeeded();
+
+        const int numRebuilds = 20;
+        double rebuildTicks = 0.0;
+        for (int i = 0; i < numRebuilds; ++i)
+        {
+            graph.triggerAsyncUpdate();
+            const auto start = Time::getHighResolutionTicks();
+            graph.handleUpdateNowIfNeeded();
+            rebuildTicks += (double) (Time::getHighResolutionTicks() - start);
+        }
+
+        // let the retired programs go before rendering
+        MessageManager::getInstance()->runDispatchLoopUntil (20);
+        result.rebuildMicros = 1.0e6 * Time::highResolutionTicksToSeconds ((int64) (rebuildTicks / numRebuilds));
+
+        AudioSampleBuffer buffer (2, opts.blockSize);
+        MidiBuffer midi;
+        midi.ensureSize (1024);
+        Random random (1234);
+
+        std::vector<double> times;
+        times.reserve ((size_t) opts.numBlocks);
+
+        const int numWarmupBlocks = jmin (100, opts.numBlocks);
+        for (int block = -numWarmupBlocks; block < opts.numBlocks; ++block)
+        {
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                for (int i = 0; i < buffer.getNumSamples(); ++i)
+                    buffer.setSample (ch, i, random.nextFloat() * 0.5f - 0.25f);
+            midi.clear();
+            if (block % 8 == 0)
+                midi.addEvent (MidiMessage::noteOn (1, 60, (uint8) 100), 0);
+
+            if (block >= 0)
+                countAllocations.store (true);
+            isRenderThread = true;
+            const auto start = Time::getHighResolutionTicks();
+            graph.processBlock (buffer, midi);
+            const auto elapsed = Time::getHighResolutionTicks() - start;
+            isRenderThread = false;
+            countAllocations.store (false);
+
+            if (block >= 0)
+                times.push_back (1.0e9 * Time::highResolutionTicksToSeconds (elapsed));
+        }
+
+        result.allocations = numRenderThreadAllocations.exchange (0);
+        result.allAllocations = numAllocations.exchange (0);
+        if (times.empty())
+            return result;
+
+        double total = 0.0;
+        for (auto t : times)
+            total += t;
+        result.meanNanos = total / (double) times.size();
+
+        std::sort (times.begin(), times.end());
+        result.p99Nanos = times [jmin (times.size() - 1, (size_t) (0.99 * (double) times.size()))];
+        result.worstNanos = times.back();
+        return result;
+    }
+
+private:
+    const BenchOptions& opts;
+
+    static int countNodes (GraphProcessor& g)
+    {
+        int total = g.getNumNodes();
+        for (int i = 0; i < g.getNumNodes(); ++i)
+            if (auto* const sub = g.getNode (i)->processor<GraphProcessor>())
+                total += countNodes (*sub);
+        return total;
+    }
+};
+
+//=============================================================================
+// Topologies
+
+static BenchResult benchSerialChain (const BenchOptions& opts, RenderThreadPool& pool, int length)
+{
+    BenchGraph bench (opts, pool);
+    auto& g = bench.graph;
+    uint32 previous = bench.audioIn;
+    for (int i = 0; i < length; ++i)
+    {
+        const auto node = g.addNode (new VolumeProcessor (-60.0, 12.0, true))->nodeId;
+        BenchGraph::connectStereo (g, previous, node);
+        previous = node;
+    }
+    BenchGraph::connectStereo (g, previous, bench.audioOut);
+    return bench.measure ("serial chain x" + String (length));
+}
+
+static BenchResult benchFanOutFanIn (const BenchOptions& opts, RenderThreadPool& pool, int width)
+{
+    BenchGraph bench (opts, pool);
+    auto& g = bench.graph;
+    for (int i = 0; i < width; ++i)
+    {
+        const auto node = g.addNode (new VolumeProcessor (-60.0, 12.0, true))->nodeId;
+        BenchGraph::connectStereo (g, bench.audioIn, node);
+        BenchGraph::connectStereo (g, node, bench.audioOut);
+    }
+    return bench.measure ("fan out/in x" + String (width));
+}
+
+static BenchResult benchNestedGraphs (const BenchOptions& opts, RenderThreadPool& pool, int depth)
+{
+    BenchGraph bench (opts, pool);
+    GraphProcessor* parent = &bench.graph;
+    uint32 parentIn = bench.audioIn, parentOut = bench.audioOut;
+
+    for (int level = 0; level < depth; ++level)
+    {
+        auto* const sub = new SubGraphProcessor();
+        sub->setPlayConfigDetails (2, 2, opts.sampleRate, opts.blockSize);
+        const auto subId = parent->addNode (sub)->nodeId;
+        BenchGraph::connectStereo (*parent, parentIn, subId);
+        BenchGraph::connectStereo (*parent, subId, parentOut);
+
+        uint32 midiIn = 0;
+        BenchGraph::addIONodes (*sub, parentIn, parentOut, midiIn);
+        const auto volume = sub->addNode (new VolumeProcessor (-60.0, 12.0, true))->nodeId;
+        BenchGraph::connectStereo (*sub, parentIn, volume);
+        BenchGraph::connectStereo (*sub, volume, parentOut);
+        parent = sub;
+    }
+
+    return bench.measure ("nested graphs x" + String (depth));
+}
+
+static BenchResult benchRouterMatrix (const BenchOptions& opts, RenderThreadPool& pool, int size)
+{
+    BenchGraph bench (opts, pool);
+    auto& g = bench.graph;
+    auto* const router = new AudioRouterNode (size, size);
+    const auto routerId = g.addNode (router)->nodeId;
+
+    for (int src = 0; src < size; ++src)
+        for (int dst = 0; dst < size; ++dst)
+            router->set (src, dst, true);
+
+    for (int ch = 0; ch < size; ++ch)
+    {
+        g.connectChannels (PortType::Audio, bench.audioIn, ch % 2, routerId, ch);
+        g.connectChannels (PortType::Audio, routerId, ch, bench.audioOut, ch % 2);
+    }
+
+    return bench.measure ("router matrix " + String (size) + "x" + String (size));
+}
+
+#if EL_USE_LUA
+static BenchResult benchLuaChain (const BenchOptions& opts, RenderThreadPool& pool, int length)
+{
+    BenchGraph bench (opts, pool);
+    auto& g = bench.graph;
+    uint32 previous = bench.audioIn;
+    for (int i = 0; i < length; ++i)
+    {
+        // the default script is a stereo amp
+        const auto node = g.addNode (new LuaNode())->nodeId;
+        BenchGraph::connectStereo (g, previous, node);
+        previous = node;
+    }
+    BenchGraph::connectStereo (g, previous, bench.audioOut);
+    return bench.measure ("lua chain x" + String (length));
+}
+#endif
+
+//=============================================================================
+static bool parseOptions (const StringArray& args, BenchOptions& opts)
+{
+    for (int i = 0; i < args.size(); ++i)
+    {
+        const auto& arg = args [i];
+        if (i + 1 >= args.size())
+            return false;
+
+        if (arg == "--blocks")          opts.numBlocks  = jmax (1, args [++i].getIntValue());
+        else if (arg == "--block")      opts.blockSize  = jmax (1, args [++i].getIntValue());
+        else if (arg == "--rate")       opts.sampleRate = jmax (1.0, args [++i].getDoubleValue());
+        else if (arg == "--threads")    opts.numThreads = jmax (0, args [++i].getIntValue());
+        else if (arg == "--filter")     opts.filter     = args [++i];
+        else if (arg == "--output")     opts.output     = File::getCurrentWorkingDirectory().getChildFile (args [++i]);
+        else return false;
+    }
+
+    return true;
+}
+
+static int runBenchmarks (const BenchOptions& opts)
+{
+    RenderThreadPool pool (opts.numThreads);
+    std::vector<std::pair<String, std::function<BenchResult()>>> benches =
+    {
+        { "serial", [&]() { return benchSerialChain (opts, pool, 64); } },
+        { "fanout", [&]() { return benchFanOutFanIn (opts, pool, 64); } },
+        { "nested", [&]() { return benchNestedGraphs (opts, pool, 8); } },
+        { "router", [&]() { return benchRouterMatrix (opts, pool, 16); } },
+       #if EL_USE_LUA
+        { "lua",    [&]() { return benchLuaChain (opts, pool, 16); } },
+       #endif
+    };
+
+    Array<var> results;
+    for (auto& bench : benches)
+    {
+        if (opts.filter.isNotEmpty() && ! bench.first.containsIgnoreCase (opts.filter))
+            continue;
+
+        const auto result = bench.second();
+        std::cout << result.name.paddedRight (' ', 24)
+                  << String (result.meanNanos, 0).paddedLeft (' ', 10) << " ns/block"
+                  << String (result.p99Nanos, 0).paddedLeft (' ', 10) << " p99"
+                  << String (result.worstNanos, 0).paddedLeft (' ', 10) << " worst"
+                  << String (result.allocations).paddedLeft (' ', 8) << " allocs"
+                  << String (result.rebuildMicros, 1).paddedLeft (' ', 10) << " us rebuild"
+                  << std::endl;
+        results.add (result.toVar());
+    }
+
+    if (opts.output != File())
+    {
+        DynamicObject::Ptr report = new DynamicObject();
+        report->setProperty ("version", EL_VERSION_STRING);
+        report->setProperty ("date", Time::getCurrentTime().toISO8601 (true));
+        report->setProperty ("sampleRate", opts.sampleRate);
+        report->setProperty ("blockSize", opts.blockSize);
+        report->setProperty ("blocks", opts.numBlocks);
+        report->setProperty ("threads", opts.numThreads);
+        report->setProperty ("results", results);
+
+        if (! opts.output.replaceWithText (JSON::toString (var (report.get()))))
+        {
+            std::cerr << "bench-element: could not write " << opts.output.getFullPathName() << std::endl;
+            return 2;
+        }
+    }
+
+    return 0;
+}
+
+}
+
+int main (int argc, char** argv)
+{
+    using namespace Element;
+
+    StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add (String::fromUTF8 (argv[i]));
+
+    BenchOptions opts;
+    if (! parseOptions (args, opts))
+    {
+        std::cout << "Usage: bench-element [--blocks N] [--block size] [--rate hz] "
+                     "[--threads N] [--filter name] [--output results.json]" << std::endl;
+        return 1;
+    }
+
+    ScopedJuceInitialiser_GUI juce;
+    return runBenchmarks (opts);
+}
@@ -0,0 +1,451 @@
+/*
+    This file is part of Element
+    Copyright (C) 2019  Kushview, LLC.  All rights reserved.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/** element-render: renders a session or graph to an audio file without an
+    audio device, as fast as the graph can be processed.
+
+    element-render [options] <session.els|graph.elg> <output.wav|output.flac>
+ */
+
+#include "ElementApp.h"
+#include "controllers/GraphManager.h"
+#include "engine/AudioEngine.h"
+#include "engine/InternalFormat.h"
+#include "session/Node.h"
+#include "session/PluginManager.h"
+#include "session/Session.h"
+#include "session/SessionContainer.h"
+#include "Globals.h"
+#include "Settings.h"
+
+namespace Element {
+
+struct RenderOptions
+{
+    File source, target, midiFile;
+    double sampleRate   = 44100.0;
+    int blockSize       = 512;
+    int numChannels     = 2;
+    int bitDepth        = 24;
+    int numThreads      = 0;
+    int graph           = -1;       // the session's active graph
+    double length       = 0.0;      // seconds, zero renders to the end of the MIDI file
+    double tail         = 2.0;      // seconds rendered after the MIDI file ends
+    bool compensate     = true;     // trim the graph's latency from the start
+};
+
+static void printUsage()
+{
+    std::cout
+        << "Usage: element-render [options] <session.els|graph.elg> <output.wav|output.flac>" << std::endl << std::endl
+        << "Options:" << std::endl
+        << "  --midi <file.mid>     Feed a standard MIDI file to the graph's MIDI input" << std::endl
+        << "  --length <seconds>    Length to render, defaults to the MIDI file's length plus the tail" << std::endl
+        << "  --tail <seconds>      Time rendered after the MIDI file ends (default 2)" << std::endl
+        << "  --rate <hz>           Sample rate (default 44100)" << std::endl
+        << "  --block <samples>     Block size (default 512)" << std::endl
+        << "  --channels <count>    Output channels (default 2)" << std::endl
+        << "  --bits <depth>        Bit depth of the output file (default 24)" << std::endl
+        << "  --threads <count>     Render threads for parallel graphs (default 0)" << std::endl
+        << "  --graph <index>       Graph in the session to render (default active)" << std::endl
+        << "  --no-compensation     Keep the graph's latency at the start of the file" << std::endl;
+}
+
+static bool parseOptions (const StringArray& args, RenderOptions& opts)
+{
+    StringArray files;
+
+    for (int i = 0; i < args.size(); ++i)
+    {
+        const auto& arg = args [i];
+        const bool hasValue = i + 1 < args.size();
+
+        if (arg == "--midi" && hasValue)
+            opts.midiFile = File::getCurrentWorkingDirectory().getChildFile (args [++i]);
+        else if (arg == "--length" && hasValue)
+            opts.length = args [++i].getDoubleValue();
+        else if (arg == "--tail" && hasValue)
+            opts.tail = jmax (0.0, args [++i].getDoubleValue());
+        else if (arg == "--rate" && hasValue)
+            opts.sampleRate = args [++i].getDoubleValue();
+        else if (arg == "--block" && hasValue)
+            opts.blockSize = args [++i].getIntValue();
+        else if (arg == "--channels" && hasValue)
+            opts.numChannels = args [++i].getIntValue();
+        else if (arg == "--bits" && hasValue)
+            opts.bitDepth = args [++i].getIntValue();
+        else if (arg == "--threads" && hasValue)
+            opts.numThreads = jmax (0, args [++i].getIntValue());
+        else if (arg == "--graph" && hasValue)
+            opts.graph = args [++i].getIntValue();
+        else if (arg == "--no-compensation")
+            opts.compensate = false;
+        else if (arg.startsWith ("--"))
+            return false;
+        else
+            files.add (arg);
+    }
+
+    if (files.size() != 2)
+        return false;
+
+    opts.source = File::getCurrentWorkingDirectory().getChildFile (files [0]);
+    opts.target = File::getCurrentWorkingDirectory().getChildFile (files [1]);
+    return opts.sampleRate > 0.0 && opts.blockSize > 0 && opts.numChannels > 0;
+}
+
+/** How long to wait for a loaded graph to be ready to render */
+static const uint32 graphReadyTimeoutMs = 10000;
+
+/** Plugins may use cheaper, non-realtime code paths when asked */
+static void setNonRealtime (GraphProcessor& graph)
+{
+    graph.setNonRealtime (true);
+    for (int i = 0; i < graph.getNumNodes(); ++i)
+    {
+        auto* const node = graph.getNode (i);
+        if (auto* const sub = node->processor<GraphProcessor>())
+            setNonRealtime (*sub);
+        else if (auto* const proc = node->getAudioProcessor())
+            proc->setNonRealtime (true);
+    }
+}
+
+class OfflineRenderer
+{
+public:
+    OfflineRenderer (const RenderOptions& o)
+        : opts (o) { }
+
+    ~OfflineRenderer()
+    {
+        unload();
+    }
+
+    Result run()
+    {
+        initializeWorld();
+
+        auto result = loadSession();
+        if (result.failed())
+            return result;
+
+        result = loadMidi();
+        if (result.failed())
+            return result;
+
+        result = attachGraph();
+        if (result.failed())
+            return result;
+
+        return render();
+    }
+
+private:
+    const RenderOptions& opts;
+    std::unique_ptr<Globals> world;
+    AudioEnginePtr engine;
+    GraphNodePtr rootNode;
+    std::unique_ptr<RootGraphManager> manager;
+    MidiMessageSequence midi;
+
+    void initializeWorld()
+    {
+        world.reset (new Globals());
+        auto& settings = world->getSettings();
+        auto& plugins = world->getPluginManager();
+
+        // sessions refer to plugins the application has scanned
+        plugins.restoreUserPlugins (settings);
+
+        // but keep our own settings out of the application's preferences
+        PropertiesFile::Options storage = settings.getStorageParameters();
+        storage.applicationName = "ElementRender";
+        settings.setStorageParameters (storage);
+        settings.setNumRenderThreads (opts.numThreads);
+
+        engine = new AudioEngine (*world);
+        world->setEngine (engine);
+        engine->applySettings (settings);
+
+        plugins.addDefaultFormats();
+        plugins.addFormat (new ElementAudioPluginFormat (*world));
+        plugins.addFormat (new InternalFormat (*engine, world->getMidiEngine()));
+    }
+
+    Result loadSession()
+    {
+        auto session = world->getSession();
+
+        if (opts.source.hasFileExtension ("els"))
+        {
+            // sessions are saved as XML or binary containers, older ones may be
+            // compressed trees. Only the rendered graph's state is decoded from
+            // a container
+            ValueTree data;
+            SessionContainer container;
+            if (container.open (opts.source).wasOk())
+            {
+                data = container.getModel();
+                const auto graphs = data.getChildWithName (Tags::graphs);
+                const int index = isPositiveAndBelow (opts.graph, graphs.getNumChildren())
+                    ? opts.graph : (int) graphs.getProperty (Tags::active, 0);
+                container.restoreState (graphs.getChild (index));
+            }
+            else if (auto xml = XmlDocument::parse (opts.source))
+            {
+                data = ValueTree::fromXml (*xml);
+            }
+            else
+            {
+                data = Session::readFromFile (opts.source);
+            }
+
+            if (! data.hasType (Tags::session) || ! session->loadData (data))
+                return Result::fail ("could not load session: " + opts.source.getFullPathName());
+            if (isPositiveAndBelow (opts.graph, session->getNumGraphs()))
+                session->setActiveGraph (opts.graph);
+        }
+        else if (opts.source.hasFileExtension ("elg"))
+        {
+            const auto data = Node::parse (opts.source);
+            if (! Node::isProbablyGraphNode (data))
+                return Result::fail ("not a graph: " + opts.source.getFullPathName());
+            session->clear();
+            session->addGraph (Node (data, true), true);
+        }
+        else
+        {
+            return Result::fail ("unknown file type: " + opts.source.getFullPathName());
+        }
+
+        engine->setSession (session);
+        return Result::ok();
+    }
+
+    Result loadMidi()
+    {
+        if (opts.midiFile == File())
+            return Result::ok();
+
+        FileInputStream stream (opts.midiFile);
+        MidiFile file;
+        if (! stream.openedOk() || ! file.readFrom (stream))
+            return Result::fail ("could not read MIDI file: " + opts.midiFile.getFullPathName());
+
+        file.convertTimestampTicksToSeconds();
+        for (int i = 0; i < file.getNumTracks(); ++i)
+            midi.addSequence (*file.getTrack (i), 0.0);
+        midi.sort();
+        return Result::ok();
+    }
+
+    Result attachGraph()
+    {
+        const auto model = world->getSession()->getActiveGraph();
+        if (! model.isValid())
+            return Result::fail ("the session has no graph to render");
+
+        rootNode = GraphNode::createForRoot (new RootGraph());
+        auto* const root = rootNode->processor<RootGraph>();
+
+        DeviceManager::AudioDeviceSetup setup;
+        setup.sampleRate = opts.sampleRate;
+        setup.bufferSize = opts.blockSize;
+        setup.outputChannels.setRange (0, opts.numChannels, true);
+
+        root->setLocked (false);
+        root->setPlayConfigFor (setup);
+        root->setRenderMode (RootGraph::SingleGraph);
+        root->setMidiChannels (model.getMidiChannels());
+        root->setMidiProgram ((int) model.getProperty ("midiProgram", -1));
+
+        engine->prepareExternalPlayback (opts.sampleRate, opts.blockSize, 0, opts.numChannels);
+        engine->addGraph (root);
+
+        manager.reset (new RootGraphManager (*root, world->getPluginManager()));
+        model.getValueTree().setProperty (Tags::object, rootNode.get(), nullptr);
+        manager->setNodeModel (model);
+        setNonRealtime (*root);
+
+        // graph rebuilds and plugin setup are delivered as messages, pump
+        // them until the graph can render
+        const uint32 deadline = Time::getMillisecondCounter() + graphReadyTimeoutMs;
+        while (! root->isReadyToRender())
+        {
+            if (Time::getMillisecondCounter() >= deadline)
+                return Result::fail ("timed out waiting for the graph to be ready");
+            MessageManager::getInstance()->runDispatchLoopUntil (10);
+        }
+
+        return Result::ok();
+    }
+
+    Result render()
+    {
+        AudioFormatManager formats;
+        formats.registerBasicFormats();
+        auto* const format = formats.findFormatForFileExtension (opts.target.getFileExtension());
+        if (format == nullptr)
+            return Result::fail ("unsupported output format: " + opts.target.getFileExtension());
+
+        opts.target.deleteFile();
+        std::unique_ptr<FileOutputStream> stream (opts.target.createOutputStream());
+        if (stream == nullptr || stream->failedToOpen())
+            return Result::fail ("could not write to " + opts.target.getFullPathName());
+
+        std::unique_ptr<AudioFormatWriter> writer (format->createWriterFor (
+            stream.get(), opts.sampleRate, (unsigned int) opts.numChannels, opts.bitDepth, {}, 0));
+        if (writer == nullptr)
+            return Result::fail ("the output format doesn't support these settings");
+        stream.release(); // now owned by the writer
+
+        const double length = opts.length > 0.0 ? opts.length
+                                                : midi.getEndTime() + opts.tail;
+        if (length <= 0.0)
+            return Result::fail ("nothing to render, use --length or --midi");
+
+        const int latency   = opts.compensate ? engine->getExternalLatencySamples() : 0;
+        const int64 total   = (int64) std::ceil (length * opts.sampleRate);
+        int64 toSkip        = latency;
+        int64 written       = 0;
+        int64 position      = 0;
+        int nextEvent       = 0;
+
+        AudioSampleBuffer buffer (opts.numChannels, opts.blockSize);
+        MidiBuffer events;
+
+        engine->setPlaying (true);
+        const double started = Time::getMillisecondCounterHiRes();
+
+        while (written < total)
+        {
+            const int numSamples = opts.blockSize;
+            const double blockEnd = (double) (position + numSamples) / opts.sampleRate;
+
+            buffer.clear();
+            events.clear();
+
+            for (; nextEvent < midi.getNumEvents(); ++nextEvent)
+            {
+                const auto& message = midi.getEventPointer (nextEvent)->message;
+                if (message.getTimeStamp() >= blockEnd)
+                    break;
+                if (message.isMetaEvent())
+                    continue;
+                const int frame = jlimit (0, numSamples - 1,
+                    roundToInt (message.getTimeStamp() * opts.sampleRate) - (int) position);
+                events.addEvent (message, frame);
+            }
+
+            engine->processExternalBuffers (buffer, events);
+            position += numSamples;
+
+            int start = 0;
+            if (toSkip > 0)
+            {
+                start = (int) jmin (toSkip, (int64) numSamples);
+                toSkip -= start;
+            }
+
+            const int numToWrite = (int) jmin ((int64) (numSamples - start), total - written);
+            if (numToWrite > 0)
+            {
+                const float* channels [32];
+                const int numChans = jmin (opts.numChannels, 32);
+                for (int c = 0; c < numChans; ++c)
+                    channels [c] = buffer.getReadPointer (c, start);
+                if (! writer->writeFromFloatArrays (channels, numChans, numToWrite))
+                    return Result::fail ("could not write to " + opts.target.getFullPathName());
+                written += numToWrite;
+            }
+
+            // let plugins and the graph handle messages between blocks
+            MessageManager::getInstance()->runDispatchLoopUntil (0);
+        }
+
+        engine->setPlaying (false);
+        writer.reset();
+
+        const double seconds = (Time::getMillisecondCounterHiRes() - started) * 0.001;
+        std::cout << "rendered " << String (length, 2) << "s in " << String (seconds, 2) << "s ("
+                  << String (seconds > 0.0 ? length / seconds : 0.0, 1) << "x realtime) to "
+                  << opts.target.getFullPathName() << std::endl;
+
+        return Result::ok();
+    }
+
+    void unload()
+    {
+        if (manager != nullptr)
+        {
+            manager->unloadGraph();
+            manager.reset();
+        }
+
+        if (engine != nullptr)
+        {
+            if (auto* const root = rootNode != nullptr ? rootNode->processor<RootGraph>() : nullptr)
+                engine->removeGraph (root);
+            engine->releaseExternalResources();
+        }
+
+        rootNode = nullptr;
+
+        if (world != nullptr)
+            world->setEngine (nullptr);
+
+        engine = nullptr;
+        world.reset();
+    }
+};
+
+}
+
+int main (int argc, char** argv)
+{
+    using namespace Element;
+
+    StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add (String::fromUTF8 (argv[i]));
+
+    RenderOptions opts;
+    if (! parseOptions (args, opts))
+    {
+        printUsage();
+        return 1;
+    }
+
+    ScopedJuceInitialiser_GUI juce;
+    Result result = Result::ok();
+
+    {
+        OfflineRenderer renderer (opts);
+        result = renderer.run();
+    }
+
+    if (result.failed())
+    {
+        std::cerr << "element-render: " << result.getErrorMessage() << std::endl;
+        return 2;
+    }
+
+    return 0;
+}
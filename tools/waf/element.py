@@ -26,6 +26,11 @@ def check_common (self):
     # LUA
     self.env.LUA = not bool(self.options.no_lua)
     self.define ('EL_USE_LUA', self.env.LUA)
+    # Lua nodes render in place on the graph's float buffers unless double
+    # precision is asked for
+    self.env.LUA_DOUBLE = bool(self.options.lua_double)
+    if not self.env.LUA_DOUBLE:
+        self.define ('LRT_FORCE_FLOAT32', 1)
 
     # JACK
     self.check_cfg(package='jack', uselib_store="JACK", args='--cflags --libs', mandatory=False)